@@ -0,0 +1,175 @@
+#!/bin/sh
+# Runs the benchmarks in a suite file and compares them against a
+# baseline, or with -u writes the baseline instead. Each benchmark is run
+# BENCH_RUNS times and the fastest run is kept. A benchmark regresses when
+# it takes more steps or nodes than its baseline, or more than
+# BENCH_TOLERANCE percent more time or peak memory.
+#
+# usage: bench.sh [-u] lclex suite baseline
+
+runs=${BENCH_RUNS:-5}
+tolerance=${BENCH_TOLERANCE:-20}
+
+update=false
+if [ "$1" = "-u" ]; then
+    update=true
+    shift
+fi
+
+if [ $# -ne 3 ]; then
+    echo "usage: $0 [-u] lclex suite baseline" >&2
+    exit 1
+fi
+
+lclex=$1
+suite=$2
+baseline=$3
+
+if ! $update && [ ! -f "$baseline" ]; then
+    echo "Error: no baseline '$baseline', create one with -u" >&2
+    exit 1
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+generate() {
+    case $1 in
+        @*)
+            set -- $1 ;;
+    esac
+
+    case $1 in
+        @deep)
+            awk -v n="$2" 'BEGIN {
+                s = "z"
+                for (i = 0; i < n; i++) s = "\\a.(\\x.x a) (" s ")"
+                print s
+            }' ;;
+        @spine)
+            awk -v n="$2" 'BEGIN {
+                printf "\\z.(\\x.\\w.x x) (z"
+                for (i = 1; i < n; i++) printf " z"
+                print ")"
+            }' ;;
+        @wide)
+            awk -v n="$2" 'BEGIN {
+                s = "z"
+                for (i = 0; i < n; i++) s = s " ((\\x.\\y.y x) " i ")"
+                print s
+            }' ;;
+        *)
+            printf '%s\n' "$1" ;;
+    esac
+}
+
+# Prints name, milliseconds, steps, nodes and peak KiB for one benchmark.
+# The engine may be followed by options for lclex, as in rewrite,-m.
+measure() {
+    engine=${2%%,*}
+    options=
+    case $2 in
+        *,*)
+            options=$(printf '%s' "${2#*,}" | tr ',' ' ') ;;
+    esac
+
+    best=
+    i=0
+    while [ $i -lt "$runs" ]; do
+        start=$(date +%s%N)
+        if ! "$lclex" -h -s -e "$engine" $options -b "$tmp/input.lc" \
+            > "$tmp/stats.txt"
+        then
+            echo "Error: benchmark '$1' failed" >&2
+            return 1
+        fi
+        end=$(date +%s%N)
+        ms=$(( (end - start) / 1000000 ))
+        if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then
+            best=$ms
+        fi
+        i=$((i + 1))
+    done
+
+    # Engines that keep their own store report nodes on their own line.
+    awk -v name="$1" -v ms="$best" -v engine="$engine" '
+        /^> nodes:/ { nodes = $3 }
+        /^> memory:/ { rss = $3 }
+        $2 == engine ":" {
+            for (i = 3; i <= NF; i++) {
+                if ($(i + 1) ~ /^(steps|betas),?$/ && steps == "") {
+                    steps = $i
+                }
+                if ($(i + 1) ~ /^(allocated|agents),?$/) {
+                    nodes = $i
+                }
+            }
+        }
+        END { print name, ms, steps, nodes, rss }
+    ' "$tmp/stats.txt"
+}
+
+grep -v '^#' "$suite" | grep -v '^[[:space:]]*$' | \
+while read -r name engine expr; do
+    generate "$expr" > "$tmp/input.lc"
+    measure "$name" "$engine" || exit 1
+done > "$tmp/results.txt" || exit 1
+
+if $update; then
+    cp "$tmp/results.txt" "$baseline"
+    echo "Wrote $(wc -l < "$baseline") benchmarks to $baseline"
+    exit 0
+fi
+
+awk -v tolerance="$tolerance" '
+    function change(new, old) {
+        return old > 0 ? sprintf("%+.0f%%", 100 * (new - old) / old) : "-"
+    }
+
+    NR == FNR { base[$1] = $0; next }
+
+    FNR == 1 {
+        printf "%-14s %8s %8s %12s %10s %10s %9s\n", "benchmark", "ms",
+               "vs base", "steps/s", "steps", "nodes", "peak KiB"
+    }
+
+    {
+        name = $1; ms = $2; steps = $3; nodes = $4; rss = $5
+        rate = ms > 0 ? sprintf("%.0f", steps * 1000 / ms) : "-"
+        status = ""
+
+        if (!(name in base)) {
+            status = "new"
+        } else {
+            split(base[name], b, " ")
+            if (steps > b[3]) {
+                status = status " steps " change(steps, b[3])
+            }
+            if (nodes > b[4]) {
+                status = status " nodes " change(nodes, b[4])
+            }
+            # A few milliseconds of slack for process startup noise.
+            if (ms > b[2] * (1 + tolerance / 100) && ms > b[2] + 10) {
+                status = status " time"
+            }
+            if (rss > b[5] * (1 + tolerance / 100)) {
+                status = status " memory " change(rss, b[5])
+            }
+            if (status != "") {
+                status = "REGRESSION" status
+                failed++
+            }
+        }
+
+        printf "%-14s %8d %8s %12s %10d %10d %9d %s\n", name, ms,
+               name in base ? change(ms, b[2]) : "-", rate, steps, nodes,
+               rss, status
+    }
+
+    END {
+        if (failed > 0) {
+            printf "%d of %d benchmarks regressed\n", failed, FNR
+            exit 1
+        }
+    }
+' "$baseline" "$tmp/results.txt"
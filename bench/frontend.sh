@@ -0,0 +1,177 @@
+#!/bin/sh
+# Measures the front end. Parsing is measured on generated statements
+# that are already in normal form, so that reducing them is a single
+# pass: FRONTEND_TERMS terms applied to a free variable, and deeply
+# nested operators under many binders. Definitions are measured by
+# loading FRONTEND_DEFS generated def lines, over the whole run, and by
+# an expression that looks up as many of them. Printing is measured on large
+# normal forms and on a trace of reductions. Each run is repeated
+# BENCH_RUNS times and the fastest is kept. Parsing is reported in tokens
+# and megabytes per second, printing in megabytes per second.
+#
+# usage: frontend.sh lclex
+
+runs=${BENCH_RUNS:-5}
+terms=${FRONTEND_TERMS:-200000}
+operators=${FRONTEND_OPERATORS:-48}
+binders=${FRONTEND_BINDERS:-1000}
+blocks=${FRONTEND_BLOCKS:-100}
+depth=${FRONTEND_DEPTH:-500}
+numeral=${FRONTEND_NUMERAL:-1000000}
+trace=${FRONTEND_TRACE:-100}
+defs=${FRONTEND_DEFS:-100000}
+
+if [ $# -ne 1 ]; then
+    echo "usage: $0 lclex" >&2
+    exit 1
+fi
+
+lclex=$1
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# Every term is the 11 tokens ( \ a . \ bc . bc a 12 ).
+awk -v n="$terms" 'BEGIN {
+    printf "z"
+    for (i = 0; i < n; i++) printf " (\\a.\\bc.bc a 12)"
+    printf "\n"
+}' > "$tmp/terms.lc"
+
+echo $((1 + 11 * terms)) > "$tmp/terms.tokens"
+
+# FRONTEND_OPERATORS infix operators over the levels 2 to 7, defined as
+# free variables, then FRONTEND_BINDERS binders around FRONTEND_BLOCKS
+# blocks of FRONTEND_DEPTH nested brackets, each holding two operators.
+# Only the last statement is measured, so the count of its tokens is
+# written separately.
+awk -v ops="$operators" -v binders="$binders" -v blocks="$blocks" \
+    -v depth="$depth" -v out="$tmp/operators.tokens" 'BEGIN {
+    srand(1)
+    for (i = 0; i < ops; i++) {
+        printf "opdef <%d> %d = op%d\n", i, 2 + i % 6, i
+    }
+
+    tokens = 0
+    for (i = 0; i < binders; i++) {
+        printf "\\x%d.", i
+        tokens += 3
+    }
+
+    for (b = 0; b < blocks; b++) {
+        if (b > 0) {
+            printf " <%d> ", int(rand() * ops)
+            tokens++
+        }
+        for (i = 0; i < depth; i++) printf "("
+        printf "x%d", int(rand() * binders)
+        for (i = 0; i < depth; i++) {
+            printf " <%d> x%d <%d> x%d)", int(rand() * ops),
+                   int(rand() * binders), int(rand() * ops),
+                   int(rand() * binders)
+        }
+        tokens += 1 + 6 * depth
+    }
+    printf "\n"
+    print tokens > out
+}' > "$tmp/operators.lc"
+
+# FRONTEND_DEFS definitions of 8 tokens, each referring to a random
+# earlier one, then an expression of as many references to random
+# definitions.
+awk -v n="$defs" 'BEGIN {
+    srand(1)
+    print "def d0 = \\y.y"
+    for (i = 1; i < n; i++) {
+        printf "def d%d = \\y.y d%d\n", i, int(rand() * i)
+    }
+    printf "z"
+    for (i = 0; i < n; i++) printf " d%d", int(rand() * n)
+    printf "\n"
+}' > "$tmp/defs.lc"
+
+echo $((1 + defs)) > "$tmp/defs.tokens"
+echo $((5 + 8 * (defs - 1) + 1 + defs)) > "$tmp/defs.load.tokens"
+
+# A numeral applied so that it is expanded, for a normal form that is
+# FRONTEND_NUMERAL applications deep, and a product traced with -r.
+printf '(\\n.\\f.\\x.n f (f x)) %d\n' "$numeral" > "$tmp/numeral.lc"
+printf '(\\m.\\n.\\f.\\x.m (n f) x) %d %d\n' "$trace" "$trace" \
+    > "$tmp/trace.lc"
+
+# Runs lclex with flags on input, and prints the nanoseconds spent in
+# phase by the fastest run and the bytes it wrote besides statistics.
+measure() {
+    best=
+    i=0
+    while [ $i -lt "$runs" ]; do
+        if ! "$lclex" $3 -J -b "$tmp/$2.lc" > "$tmp/output.txt"; then
+            echo "Error: '$lclex' failed on $2" >&2
+            return 1
+        fi
+        ns=$(sed -n "s/.*\"$1_ns\": \([0-9]*\).*/\1/p" "$tmp/output.txt")
+        if [ -z "$best" ] || [ "$ns" -lt "$best" ]; then
+            best=$ns
+        fi
+        i=$((i + 1))
+    done
+    echo "$best $(grep -v '^{' "$tmp/output.txt" | wc -c)"
+}
+
+# As measure, but prints the nanoseconds of the whole fastest run.
+measure_run() {
+    best=
+    i=0
+    while [ $i -lt "$runs" ]; do
+        start=$(date +%s%N)
+        if ! "$lclex" $2 -b "$tmp/$1.lc" > /dev/null; then
+            echo "Error: '$lclex' failed on $1" >&2
+            return 1
+        fi
+        ns=$(($(date +%s%N) - start))
+        if [ -z "$best" ] || [ "$ns" -lt "$best" ]; then
+            best=$ns
+        fi
+        i=$((i + 1))
+    done
+    echo "$best"
+}
+
+# Prints a row for input, phase, tokens or 0, bytes and nanoseconds.
+report() {
+    awk -v input="$1" -v phase="$2" -v tokens="$3" -v bytes="$4" \
+        -v ns="$5" 'BEGIN {
+        rate = tokens > 0 ? sprintf("%.0f", tokens * 1e9 / ns) : "-"
+        printf "%-10s %-8s %10s %10d %10.3f %14s %10.1f\n", input, phase,
+               (tokens > 0 ? tokens : "-"), bytes / 1024, ns / 1e6, rate,
+               bytes * 1e3 / ns
+    }'
+}
+
+printf "%-10s %-8s %10s %10s %10s %14s %10s\n" "input" "phase" "tokens" \
+       "KiB" "ms" "tokens/s" "MB/s"
+
+for input in terms operators defs; do
+    result=$(measure parse "$input" -h) || exit 1
+    set -- $result
+    report "$input" parse "$(cat "$tmp/$input.tokens")" \
+           "$(tail -n 1 "$tmp/$input.lc" | wc -c)" "$1"
+done
+
+# Loading is timed over the whole run, as definitions are not statements
+# with statistics of their own.
+ns=$(measure_run defs -h) || exit 1
+report defs load "$(cat "$tmp/defs.load.tokens")" \
+       "$(wc -c < "$tmp/defs.lc")" "$ns"
+
+# Printed bytes are those of the normal forms, and of every step when
+# traced, which is written while reducing.
+for input in terms numeral; do
+    result=$(measure print "$input") || exit 1
+    set -- $result
+    report "$input" print 0 "$2" "$1"
+done
+
+result=$(measure reduce trace -r) || exit 1
+set -- $result
+report trace reduce 0 "$2" "$1"
@@ -0,0 +1,55 @@
+#ifndef LCLEX_ARENA_H
+#define LCLEX_ARENA_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#define LCLEX_ARENA_SLAB_SIZE 4096
+
+struct lclex_node_t;
+
+typedef struct lclex_arena_slab_t {
+    struct lclex_arena_slab_t *next;
+    struct lclex_node_t *nodes;
+    size_t used;
+} lclex_arena_slab_t;
+
+typedef struct {
+    uint64_t allocated;
+    uint64_t reused;
+    uint64_t freed;
+    uint64_t live;
+    uint64_t peak;
+    uint64_t slabs;
+} lclex_arena_stats_t;
+
+/* Node storage owned by one lifetime, such as a single REPL statement or
+   the definitions. Freed nodes are kept on a free list, and the whole 
+   arena is released at once by lclex_reset_arena. Names are not stored
+   here but interned, see symbol.h. */
+typedef struct {
+    lclex_arena_slab_t *slabs;
+    lclex_arena_slab_t *current;
+    struct lclex_node_t *free_list;
+    lclex_arena_stats_t stats;
+} lclex_arena_t;
+
+/* Each thread allocates from its own arena. */
+extern __thread lclex_arena_t *lclex_current_arena;
+
+void lclex_init_arena(lclex_arena_t *arena);
+
+void lclex_destruct_arena(lclex_arena_t *arena);
+
+void lclex_reset_arena(lclex_arena_t *arena);
+
+lclex_arena_t *lclex_use_arena(lclex_arena_t *arena);
+
+struct lclex_node_t *lclex_arena_alloc_node(lclex_arena_t *arena);
+
+void lclex_arena_free_node(lclex_arena_t *arena, struct lclex_node_t *node);
+
+void lclex_write_arena_stats(lclex_arena_t *arena, FILE *stream);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef LCLEX_CACHE_H
+#define LCLEX_CACHE_H
+
+#include "tree.h"
+#include "arena.h"
+#include "hashmap.h"
+#include "symbol.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Must be a power of two, the table is indexed by masking the hash. */
+#define LCLEX_CACHE_INIT_SIZE 64
+
+/* Steps a definition may take to normalize before it is kept as it was,
+   as definitions such as div have no normal form. */
+#define LCLEX_CACHE_DEFINE_MAX_STEPS 1000
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t entries;
+    uint64_t evicted;
+    uint64_t normalized;
+} lclex_cache_stats_t;
+
+/* A reduced expression as it was parsed, with its normal form and the
+   symbols of the definitions it used. */
+typedef struct lclex_cache_entry_t {
+    lclex_hash_t hash;
+    lclex_node_t *term;
+    lclex_node_t *normal;
+    lclex_stack_t deps;
+    struct lclex_cache_entry_t *next;
+} lclex_cache_entry_t;
+
+/* Normal forms of expressions, keyed by a structural hash of their de
+   Bruijn terms, with binder names included so that a hit prints the
+   same. Terms and normal forms are copied into the arena of the cache,
+   but the bodies of definitions they contain are shared: roots maps the
+   body of every current definition to its symbol, and these are hashed
+   by address. Keys are whole terms, so an entry never goes stale, but
+   the entries built from a definition are dropped when it is replaced,
+   with those of the definitions that use it, through dependents, which
+   maps the name of a definition to the symbols of the definitions made
+   with it. */
+typedef struct {
+    lclex_cache_entry_t **data;
+    size_t size;
+    size_t cap;
+    lclex_hashmap_t roots;
+    lclex_hashmap_t dependents;
+    lclex_arena_t arena;
+    pthread_mutex_t lock;
+    bool normalize_defs;
+    lclex_cache_stats_t stats;
+} lclex_cache_t;
+
+void lclex_init_cache(lclex_cache_t *cache, bool normalize_defs);
+
+void lclex_destruct_cache(lclex_cache_t *cache);
+
+void lclex_cache_add_roots(lclex_cache_t *cache, lclex_hashmap_t *defs);
+
+void lclex_cache_define(lclex_cache_t *cache, lclex_hashmap_t *defs,
+                        char *name, lclex_node_t **pnode);
+
+lclex_node_t *lclex_cache_lookup(lclex_cache_t *cache, lclex_node_t *term,
+                                 lclex_cache_entry_t **pentry);
+
+void lclex_cache_insert(lclex_cache_t *cache, lclex_cache_entry_t *entry,
+                        lclex_node_t *normal);
+
+void lclex_cache_stats(lclex_cache_t *cache, lclex_cache_stats_t *stats);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef LCLEX_ENGINE_H
+#define LCLEX_ENGINE_H
+
+#include "tree.h"
+#include "hashcons.h"
+#include "krivine.h"
+#include "nbe.h"
+#include "inet.h"
+#include "need.h"
+#include "pool.h"
+#include "subst.h"
+#include "parallel.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    LCLEX_ENGINE_REWRITE,
+    LCLEX_ENGINE_HASHCONS,
+    LCLEX_ENGINE_KRIVINE,
+    LCLEX_ENGINE_NBE,
+    LCLEX_ENGINE_OPTIMAL,
+    LCLEX_ENGINE_NEED,
+    LCLEX_ENGINE_POOL,
+    LCLEX_ENGINE_SUBST,
+    LCLEX_N_ENGINES
+} lclex_engine_type_t;
+
+/* Per-statement state of the selected reduction engine. The rewrite 
+   engine runs in parallel when given workers, which are kept for the 
+   whole session by the caller. Steps are those of the rewrite engine, 
+   summed over the workers. */
+typedef struct {
+    lclex_engine_type_t type;
+    lclex_parallel_t *parallel;
+    uint64_t steps;
+    union {
+        lclex_hashcons_t hashcons;
+        lclex_krivine_t krivine;
+        lclex_nbe_t nbe;
+        lclex_inet_t optimal;
+        lclex_need_t need;
+        lclex_pool_t pool;
+        lclex_subst_t subst;
+    } data;
+} lclex_engine_t;
+
+char *lclex_engine_name(lclex_engine_type_t type);
+
+bool lclex_parse_engine(char *name, lclex_engine_type_t *type);
+
+/* Whether the engine can show its reductions with -r, the others only
+   give the normal form. */
+bool lclex_engine_shows_reductions(lclex_engine_type_t type);
+
+void lclex_init_engine(lclex_engine_t *engine, lclex_engine_type_t type,
+                       lclex_parallel_t *parallel);
+
+void lclex_destruct_engine(lclex_engine_t *engine);
+
+void lclex_engine_reduce(lclex_engine_t *engine, lclex_node_t **pexpr, 
+                         uint64_t max, bool show_reductions);
+
+/* Beta steps taken by the last reduction, or contractions for the 
+   engines that count those instead. */
+uint64_t lclex_engine_steps(lclex_engine_t *engine);
+
+void lclex_write_engine_stats(lclex_engine_t *engine, lclex_node_t *expr, 
+                              FILE *stream);
+
+#endif
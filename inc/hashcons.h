@@ -0,0 +1,115 @@
+#ifndef LCLEX_HASHCONS_H
+#define LCLEX_HASHCONS_H
+
+#include "tree.h"
+#include "hashmap.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LCLEX_HASHCONS_INIT_SIZE 1024
+
+#define LCLEX_HASHCONS_GC_MIN 65536
+
+typedef struct {
+    lclex_node_t *key;
+    uint64_t a;
+    uint64_t b;
+    uint64_t gen;
+    lclex_node_t *value;
+} lclex_memo_entry_t;
+
+/* Open-addressing map from (node, a, b) to a node. Clearing bumps the
+   generation, so entries of older generations count as empty. */
+typedef struct {
+    lclex_memo_entry_t *data;
+    size_t size;
+    size_t cap;
+    uint64_t gen;
+} lclex_memo_t;
+
+typedef enum {
+    LCLEX_MEMO_STEP,
+    LCLEX_MEMO_WHNF,
+    LCLEX_MEMO_NORMAL
+} lclex_memo_kind_t;
+
+typedef struct {
+    uint64_t betas;
+    uint64_t requested;
+    uint64_t unique;
+    uint64_t collected;
+    uint64_t collections;
+} lclex_hashcons_stats_t;
+
+/* Table of unique nodes: structurally equal terms are represented by the
+   same node, so equality is a pointer compare. Binder names are compared
+   by identity, since copies share their arena strings.
+   Consed nodes are immutable and are reduced by the functional reducer
+   below instead of lclex_reduce_expression. */
+typedef struct {
+    lclex_node_t **data;
+    size_t size;
+    size_t cap;
+    size_t gc_threshold;
+    lclex_memo_t steps;
+    lclex_memo_t subst;
+    lclex_memo_t shift;
+    lclex_hashcons_stats_t stats;
+} lclex_hashcons_t;
+
+void lclex_init_memo(lclex_memo_t *memo);
+
+void lclex_destruct_memo(lclex_memo_t *memo);
+
+void lclex_clear_memo(lclex_memo_t *memo);
+
+lclex_node_t *lclex_lookup_memo(lclex_memo_t *memo, lclex_node_t *key,
+                                uint64_t a, uint64_t b);
+
+void lclex_insert_memo(lclex_memo_t *memo, lclex_node_t *key,
+                       uint64_t a, uint64_t b, lclex_node_t *value);
+
+void lclex_init_hashcons(lclex_hashcons_t *table);
+
+void lclex_destruct_hashcons(lclex_hashcons_t *table);
+
+lclex_hash_t lclex_hash_node_fields(lclex_type_t type, uint64_t data,
+                                    lclex_node_t *left, lclex_node_t *right);
+
+lclex_node_t *lclex_cons_node(lclex_hashcons_t *table, lclex_type_t type,
+                              uint64_t data, lclex_node_t *left,
+                              lclex_node_t *right);
+
+lclex_node_t *lclex_hashcons_node(lclex_hashcons_t *table,
+                                  lclex_node_t *node);
+
+lclex_node_t *lclex_hashcons_subst(lclex_hashcons_t *table,
+                                   lclex_node_t *node, lclex_node_t *arg,
+                                   lclex_bruijn_index_t index);
+
+lclex_node_t *lclex_hashcons_shift(lclex_hashcons_t *table,
+                                   lclex_node_t *node, uint64_t shift,
+                                   lclex_bruijn_index_t index);
+
+lclex_node_t *lclex_hashcons_step(lclex_hashcons_t *table,
+                                  lclex_node_t *node);
+
+lclex_node_t *lclex_hashcons_whnf(lclex_hashcons_t *table,
+                                  lclex_node_t *node);
+
+lclex_node_t *lclex_hashcons_normalize(lclex_hashcons_t *table,
+                                       lclex_node_t *node);
+
+void lclex_collect_hashcons(lclex_hashcons_t *table, lclex_node_t *root);
+
+void lclex_hashcons_reduce_expression(lclex_hashcons_t *table,
+                                      lclex_node_t **pexpr, uint64_t max,
+                                      bool show_reductions);
+
+uint64_t lclex_tree_size(lclex_memo_t *memo, lclex_node_t *node);
+
+void lclex_write_hashcons_stats(lclex_hashcons_t *table, lclex_node_t *expr,
+                                FILE *stream);
+
+#endif
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/* Must be a power of two, the table is indexed by masking the hash. */
 #define LCLEX_HASHMAP_INIT_SIZE 32
 
 #define LCLEX_HASHMAP_LOAD_FACTOR 0.75
@@ -29,25 +30,39 @@ typedef struct {
     lclex_equal_function_t equal_func;
     lclex_free_function_t key_free_func;
     lclex_free_function_t value_free_func;
+    size_t size;
     size_t cap;
     lclex_hashmap_entry_t **data;
 } lclex_hashmap_t;
 
 lclex_hash_t lclex_hash_string(void *data);
 
+lclex_hash_t lclex_hash_bytes(void *data, size_t len);
+
 bool lclex_equal_string(void *left, void *right);
 
+lclex_hash_t lclex_hash_pointer(void *data);
+
+bool lclex_equal_pointer(void *left, void *right);
+
 void lclex_init_string_hashmap(lclex_hashmap_t *map, 
                                lclex_free_function_t value_free_func);
 
+void lclex_init_pointer_hashmap(lclex_hashmap_t *map,
+                                lclex_free_function_t value_free_func);
+
 lclex_hashmap_entry_t *lclex_new_hashmap_entry(void *key, void *value, 
                                                lclex_hash_t hash, 
                                                lclex_hashmap_entry_t *next);
 
 void lclex_destruct_hashmap(lclex_hashmap_t *map);
 
+void lclex_resize_hashmap(lclex_hashmap_t *map, size_t cap);
+
 void *lclex_lookup_hashmap(lclex_hashmap_t *map, void *key);
 
 void lclex_insert_hashmap(lclex_hashmap_t *map, void *key, void *value);
 
+void lclex_remove_hashmap(lclex_hashmap_t *map, void *key);
+
 #endif
@@ -0,0 +1,65 @@
+#ifndef LCLEX_IMAGE_H
+#define LCLEX_IMAGE_H
+
+#include "tree.h"
+#include "hashmap.h"
+#include "parser.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#define LCLEX_IMAGE_MAGIC "lclex\0im"
+
+#define LCLEX_IMAGE_VERSION 1
+
+/* Start of an image of the definitions, followed by the nodes, the
+   offsets of the symbol names, the entries and the strings, each part
+   aligned to 8 bytes. Nodes are stored as they are in memory, with the
+   children as one more than their index and symbols as the index of
+   their name, so an image is only read by a build with the same node
+   layout. */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_size;
+    uint64_t n_nodes;
+    uint64_t n_names;
+    uint64_t n_entries;
+    uint64_t strings_size;
+} lclex_image_header_t;
+
+typedef enum {
+    LCLEX_IMAGE_DEFINITION,
+    LCLEX_IMAGE_OPERATOR,
+    LCLEX_IMAGE_PRIMITIVE
+} lclex_image_entry_type_t;
+
+/* A definition, an operator at level or the definition of primitive
+   number level, with name an offset into the strings. */
+typedef struct {
+    uint32_t type;
+    uint32_t level;
+    uint64_t name;
+    uint64_t node;
+} lclex_image_entry_t;
+
+/* A loaded image. Its nodes are used in place from a private mapping:
+   they are relocated once when loaded, and closed nodes hold one extra
+   reference so that they are never freed into an arena. Nodes are only
+   copied out of the image when a statement uses their definition. */
+typedef struct {
+    void *data;
+    size_t size;
+} lclex_image_t;
+
+bool lclex_write_image(FILE *file, lclex_hashmap_t *defs,
+                       lclex_operator_table_t *opdefs);
+
+bool lclex_load_image(lclex_image_t *image, char *path,
+                      lclex_hashmap_t *defs,
+                      lclex_operator_table_t *opdefs);
+
+void lclex_unload_image(lclex_image_t *image);
+
+#endif
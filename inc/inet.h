@@ -0,0 +1,175 @@
+#ifndef LCLEX_INET_H
+#define LCLEX_INET_H
+
+#include "tree.h"
+#include "utils.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LCLEX_INET_INIT_SIZE 1024
+
+#define LCLEX_INET_BLOCK_SIZE 65536
+
+#define LCLEX_CONTEXT_INIT_SIZE 16
+
+#define LCLEX_TRAIL_INIT_SIZE 64
+
+#define LCLEX_INET_NONE UINT32_MAX
+
+typedef enum {
+    LCLEX_AGENT_ROOT,
+    LCLEX_AGENT_LAMBDA,
+    LCLEX_AGENT_APPLY,
+    LCLEX_AGENT_FAN,
+    LCLEX_AGENT_CROISSANT,
+    LCLEX_AGENT_BRACKET,
+    LCLEX_AGENT_ERASER,
+    LCLEX_AGENT_FREE
+} lclex_agent_type_t;
+
+/* A port is an agent index shifted left by two, or'ed with the port
+   number. Port 0 is the principal port. Lambdas use port 1 for the body
+   and port 2 for the binder, applications use port 0 for the function,
+   port 1 for the result and port 2 for the argument. */
+typedef uint32_t lclex_port_t;
+
+#define LCLEX_PORT(agent, slot) (((agent) << 2) | (slot))
+
+#define LCLEX_PORT_AGENT(port) ((port) >> 2)
+
+#define LCLEX_PORT_SLOT(port) ((port) & 3)
+
+typedef struct {
+    lclex_agent_type_t type;
+    uint32_t level;
+    lclex_symbol_t name;
+    lclex_port_t ports[3];
+} lclex_agent_t;
+
+typedef enum {
+    LCLEX_CONTEXT_PUSH,
+    LCLEX_CONTEXT_STAR,
+    LCLEX_CONTEXT_PAIR
+} lclex_context_type_t;
+
+/* Values of the context semantics used by read back. A level is a stack
+   of fan choices, a star inserted by a croissant, or a pair of levels
+   joined by a bracket, with NULL standing for the empty stack. */
+typedef struct lclex_level_t {
+    lclex_context_type_t type;
+    uint32_t choice;
+    struct lclex_level_t *first;
+    struct lclex_level_t *second;
+} lclex_level_t;
+
+/* The levels of a context from level 0 up, levels past size are empty. */
+typedef struct {
+    lclex_level_t **levels;
+    size_t size;
+    size_t cap;
+} lclex_context_t;
+
+/* Dangling wire of a variable bound outside the term being translated, 
+   lists are sorted with the innermost binder first. */
+typedef struct lclex_inet_var_t {
+    size_t binder;
+    lclex_port_t port;
+    struct lclex_inet_var_t *next;
+} lclex_inet_var_t;
+
+/* A control agent passed by read back, kept so that the walk can step
+   back over it when the agent takes part in a rule. */
+typedef struct {
+    lclex_port_t port;
+    lclex_agent_t agent;
+    uint32_t slot;
+    bool up;
+} lclex_inet_step_t;
+
+typedef struct lclex_inet_block_t {
+    struct lclex_inet_block_t *next;
+    size_t used;
+    char data[];
+} lclex_inet_block_t;
+
+/* An application read back is reading the function of, into left, with
+   what is needed to go on once it is read: where the application goes,
+   the wire read from, the application agent, the size of the path, and
+   where the context and the context at the start of the walk are saved,
+   start first, and how far the net had allocated. Frames are linked to
+   the enclosing one, so that left stays where it is while they are
+   pushed. */
+typedef struct lclex_inet_frame_t {
+    lclex_node_t *left;
+    lclex_node_t **slot;
+    lclex_port_t from;
+    uint32_t apply;
+    size_t base;
+    size_t saved;
+    size_t start_size;
+    size_t context_size;
+    lclex_inet_block_t *block;
+    size_t used;
+    struct lclex_inet_frame_t *next;
+} lclex_inet_frame_t;
+
+typedef struct {
+    uint64_t betas;
+    uint64_t annihilations;
+    uint64_t duplications;
+    uint64_t propagations;
+    uint64_t erasures;
+    uint64_t agents;
+    uint64_t peak;
+    bool fallback;
+} lclex_inet_stats_t;
+
+/* Sharing graph for Lamping's optimal reduction. Fans, croissants and
+   brackets carry levels, the net is only reduced where read back needs
+   it, and read back follows paths using the context semantics. */
+typedef struct {
+    lclex_agent_t *agents;
+    size_t size;
+    size_t cap;
+    uint32_t free_list;
+    uint64_t live;
+    lclex_stack_t path;
+    lclex_inet_step_t *trail;
+    size_t trail_size;
+    size_t trail_cap;
+    lclex_inet_block_t *blocks;
+    lclex_inet_stats_t stats;
+} lclex_inet_t;
+
+void lclex_init_inet(lclex_inet_t *net);
+
+void lclex_destruct_inet(lclex_inet_t *net);
+
+uint32_t lclex_new_agent(lclex_inet_t *net, lclex_agent_type_t type,
+                         uint32_t level, lclex_symbol_t name);
+
+void lclex_free_agent(lclex_inet_t *net, uint32_t agent);
+
+void *lclex_inet_alloc(lclex_inet_t *net, size_t size);
+
+void lclex_link_ports(lclex_inet_t *net, lclex_port_t a, lclex_port_t b);
+
+void lclex_init_context(lclex_context_t *context);
+
+void lclex_destruct_context(lclex_context_t *context);
+
+void lclex_copy_context(lclex_context_t *dest, lclex_context_t *src);
+
+lclex_port_t lclex_inet_translate(lclex_inet_t *net, lclex_node_t *node);
+
+bool lclex_inet_interact(lclex_inet_t *net, uint32_t a, uint32_t b);
+
+lclex_node_t *lclex_inet_read_back(lclex_inet_t *net, lclex_port_t from,
+                                   lclex_context_t *context, bool *ok);
+
+void lclex_inet_reduce_expression(lclex_inet_t *net, lclex_node_t **pexpr);
+
+void lclex_write_inet_stats(lclex_inet_t *net, FILE *stream);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef LCLEX_KRIVINE_H
+#define LCLEX_KRIVINE_H
+
+#include "tree.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LCLEX_KRIVINE_BLOCK_SIZE 4096
+
+#define LCLEX_KRIVINE_STACK_INIT_SIZE 64
+
+/* An environment cell binds a closure to the innermost variable. A cell
+   with a NULL term stands for a variable bound during read back, and its
+   env field then holds the depth at which it was bound. */
+typedef struct lclex_env_t {
+    lclex_node_t *term;
+    struct lclex_env_t *env;
+    struct lclex_env_t *next;
+} lclex_env_t;
+
+typedef struct {
+    lclex_node_t *term;
+    lclex_env_t *env;
+} lclex_closure_t;
+
+typedef struct lclex_krivine_block_t {
+    struct lclex_krivine_block_t *next;
+    lclex_env_t *cells;
+    size_t used;
+} lclex_krivine_block_t;
+
+typedef struct {
+    uint64_t steps;
+    uint64_t lookups;
+    uint64_t cells;
+    uint64_t max_stack;
+} lclex_krivine_stats_t;
+
+/* Krivine machine: call-by-name evaluation to weak head normal form over
+   closures, with no substitution or shifting. Full normal forms are read
+   back by evaluating under binders and in the arguments of neutral
+   terms, which yields the same normal form as normal-order reduction. */
+typedef struct {
+    lclex_closure_t *stack;
+    size_t size;
+    size_t cap;
+    lclex_krivine_block_t *blocks;
+    lclex_krivine_stats_t stats;
+} lclex_krivine_t;
+
+void lclex_init_krivine(lclex_krivine_t *machine);
+
+void lclex_destruct_krivine(lclex_krivine_t *machine);
+
+lclex_env_t *lclex_new_env(lclex_krivine_t *machine, lclex_node_t *term,
+                           lclex_env_t *env, lclex_env_t *next);
+
+void lclex_push_closure(lclex_krivine_t *machine, lclex_node_t *term,
+                        lclex_env_t *env);
+
+void lclex_krivine_whnf(lclex_krivine_t *machine, lclex_closure_t *closure,
+                        size_t base);
+
+lclex_node_t *lclex_krivine_read_back(lclex_krivine_t *machine,
+                                      lclex_node_t *term, lclex_env_t *env,
+                                      size_t depth);
+
+void lclex_krivine_reduce_expression(lclex_krivine_t *machine,
+                                     lclex_node_t **pexpr);
+
+void lclex_write_krivine_stats(lclex_krivine_t *machine, FILE *stream);
+
+#endif
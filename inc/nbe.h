@@ -0,0 +1,98 @@
+#ifndef LCLEX_NBE_H
+#define LCLEX_NBE_H
+
+#include "tree.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LCLEX_NBE_BLOCK_SIZE 65536
+
+#define LCLEX_NBE_STACK_INIT_SIZE 64
+
+typedef enum {
+    LCLEX_VALUE_CLOSURE,
+    LCLEX_VALUE_BOUND,
+    LCLEX_VALUE_FREE
+} lclex_value_type_t;
+
+struct lclex_thunk_t;
+
+typedef struct lclex_nbe_list_t {
+    struct lclex_thunk_t *thunk;
+    struct lclex_nbe_list_t *next;
+} lclex_nbe_list_t;
+
+/* Semantic values: a closure of an abstraction over an environment, or a
+   neutral term, a variable applied to the spine of its arguments (last
+   argument first). Bound variables of neutral terms carry the depth at
+   which read back introduced them. */
+typedef struct lclex_value_t {
+    lclex_value_type_t type;
+    lclex_node_t *term;
+    union {
+        lclex_nbe_list_t *env;
+        size_t level;
+    } data;
+    lclex_nbe_list_t *spine;
+} lclex_value_t;
+
+/* An argument that is evaluated at most once, when first needed. */
+typedef struct lclex_thunk_t {
+    lclex_node_t *term;
+    lclex_nbe_list_t *env;
+    lclex_value_t *value;
+} lclex_thunk_t;
+
+typedef struct lclex_nbe_block_t {
+    struct lclex_nbe_block_t *next;
+    size_t used;
+    char data[];
+} lclex_nbe_block_t;
+
+typedef struct {
+    uint64_t betas;
+    uint64_t thunks;
+    uint64_t forced;
+    uint64_t shared;
+    uint64_t values;
+    uint64_t bytes;
+} lclex_nbe_stats_t;
+
+/* Normalization by evaluation: terms are evaluated into values, with
+   arguments passed as memoized thunks, and values are quoted back into
+   normal-form terms. There is no substitution or shifting. */
+typedef struct {
+    lclex_thunk_t **stack;
+    size_t size;
+    size_t cap;
+    lclex_nbe_block_t *blocks;
+    lclex_nbe_stats_t stats;
+} lclex_nbe_t;
+
+void lclex_init_nbe(lclex_nbe_t *nbe);
+
+void lclex_destruct_nbe(lclex_nbe_t *nbe);
+
+void *lclex_nbe_alloc(lclex_nbe_t *nbe, size_t size);
+
+lclex_thunk_t *lclex_new_thunk(lclex_nbe_t *nbe, lclex_node_t *term,
+                               lclex_nbe_list_t *env, lclex_value_t *value);
+
+lclex_value_t *lclex_new_value(lclex_nbe_t *nbe, lclex_value_type_t type,
+                               lclex_node_t *term, lclex_nbe_list_t *env,
+                               lclex_nbe_list_t *spine);
+
+lclex_value_t *lclex_nbe_force(lclex_nbe_t *nbe, lclex_thunk_t *thunk);
+
+lclex_value_t *lclex_nbe_eval(lclex_nbe_t *nbe, lclex_node_t *term,
+                              lclex_nbe_list_t *env);
+
+lclex_node_t *lclex_nbe_quote(lclex_nbe_t *nbe, lclex_value_t *value,
+                              size_t depth);
+
+void lclex_nbe_reduce_expression(lclex_nbe_t *nbe, lclex_node_t **pexpr);
+
+void lclex_write_nbe_stats(lclex_nbe_t *nbe, FILE *stream);
+
+#endif
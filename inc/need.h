@@ -0,0 +1,92 @@
+#ifndef LCLEX_NEED_H
+#define LCLEX_NEED_H
+
+#include "tree.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LCLEX_NEED_BLOCK_SIZE 65536
+
+#define LCLEX_NEED_STACK_INIT_SIZE 64
+
+struct lclex_need_env_t;
+
+/* A shared argument: term under env until it is first forced, after which
+   both are overwritten with its weak head normal form. A suspension with
+   a NULL term stands for a variable bound during read back, and the depth
+   at which it was bound is kept in depth. */
+typedef struct lclex_suspension_t {
+    lclex_node_t *term;
+    struct lclex_need_env_t *env;
+    size_t depth;
+    bool evaluated;
+} lclex_suspension_t;
+
+typedef struct lclex_need_env_t {
+    lclex_suspension_t *suspension;
+    struct lclex_need_env_t *next;
+} lclex_need_env_t;
+
+/* An argument, or a marker for a suspension being forced, which is
+   updated once evaluation returns to it. */
+typedef struct {
+    lclex_suspension_t *suspension;
+    bool update;
+} lclex_need_frame_t;
+
+typedef struct lclex_need_block_t {
+    struct lclex_need_block_t *next;
+    size_t used;
+    char data[];
+} lclex_need_block_t;
+
+typedef struct {
+    uint64_t betas;
+    uint64_t suspensions;
+    uint64_t forced;
+    uint64_t updates;
+    uint64_t shared;
+    uint64_t max_stack;
+} lclex_need_stats_t;
+
+/* Lazy Krivine machine: call-by-name evaluation where every argument is a
+   suspension that is updated in place with its value when first forced,
+   so no argument is evaluated twice. Read back works as for the Krivine
+   machine and yields the normal-order normal form. Arguments of neutral
+   terms are read back through var, the variable #0, bound to them. */
+typedef struct {
+    lclex_need_frame_t *stack;
+    size_t size;
+    size_t cap;
+    lclex_need_block_t *blocks;
+    lclex_node_t var;
+    lclex_need_stats_t stats;
+} lclex_need_t;
+
+void lclex_init_need(lclex_need_t *machine);
+
+void lclex_destruct_need(lclex_need_t *machine);
+
+void *lclex_need_alloc(lclex_need_t *machine, size_t size);
+
+lclex_suspension_t *lclex_new_suspension(lclex_need_t *machine,
+                                         lclex_node_t *term,
+                                         lclex_need_env_t *env);
+
+lclex_need_env_t *lclex_new_need_env(lclex_need_t *machine,
+                                     lclex_suspension_t *suspension,
+                                     lclex_need_env_t *next);
+
+void lclex_need_whnf(lclex_need_t *machine, lclex_node_t **pterm,
+                     lclex_need_env_t **penv, size_t base);
+
+lclex_node_t *lclex_need_read_back(lclex_need_t *machine, lclex_node_t *term,
+                                   lclex_need_env_t *env, size_t depth);
+
+void lclex_need_reduce_expression(lclex_need_t *machine,
+                                  lclex_node_t **pexpr);
+
+void lclex_write_need_stats(lclex_need_t *machine, FILE *stream);
+
+#endif
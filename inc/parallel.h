@@ -0,0 +1,85 @@
+#ifndef LCLEX_PARALLEL_H
+#define LCLEX_PARALLEL_H
+
+#include "tree.h"
+#include "arena.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LCLEX_DEQUE_INIT_SIZE 64
+
+/* A subterm to normalize, and the number of steps taken along the chain
+   of tasks that spawned it, which bounds how soon it could start. */
+typedef struct {
+    lclex_node_t **pnode;
+    uint64_t depth;
+} lclex_task_t;
+
+typedef struct {
+    uint64_t steps;
+    uint64_t tasks;
+    uint64_t steals;
+    uint64_t span;
+} lclex_worker_stats_t;
+
+struct lclex_parallel_t;
+
+/* A worker pushes and pops tasks at the bottom of its deque, while idle
+   workers steal from the top, taking the oldest and usually largest
+   subterms. The first worker runs on the calling thread and allocates
+   from its arena, the others allocate from their own, which is reset at
+   the start of each reduction. Their tree counters are added to those 
+   of the calling thread when a reduction finishes. */
+typedef struct {
+    struct lclex_parallel_t *parallel;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    lclex_task_t *tasks;
+    size_t top;
+    size_t bottom;
+    size_t cap;
+    lclex_arena_t arena;
+    lclex_cursor_t cursor;
+    lclex_stack_t stack;
+    uint64_t depth;
+    uint64_t seed;
+    lclex_worker_stats_t stats;
+    lclex_tree_counters_t counters;
+} lclex_worker_t;
+
+/* Parallel normal-order reduction. Once the left child of an application
+   is in normal form and not an abstraction, nothing can make the
+   application a redex, so its right child is reduced as a separate task.
+   Every subterm still goes through the same steps as in sequential
+   reduction, so the normal form is the same. Pending counts the tasks
+   that are queued or running. 
+   The threads of the other workers are started once and live as long
+   as the pool, waiting between reductions for round to change. Running
+   counts those still in the current round. */
+typedef struct lclex_parallel_t {
+    lclex_worker_t *workers;
+    size_t n_workers;
+    uint64_t pending;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t round;
+    size_t running;
+    bool stop;
+} lclex_parallel_t;
+
+void lclex_init_parallel(lclex_parallel_t *parallel, size_t n_workers);
+
+void lclex_destruct_parallel(lclex_parallel_t *parallel);
+
+void lclex_parallel_spawn(void *data, lclex_node_t **pnode);
+
+void lclex_parallel_reduce_expression(lclex_parallel_t *parallel,
+                                      lclex_node_t **pexpr);
+
+void lclex_write_parallel_stats(lclex_parallel_t *parallel, FILE *stream);
+
+#endif
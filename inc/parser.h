@@ -3,6 +3,9 @@
 
 #include "tree.h"
 #include "hashmap.h"
+#include "cache.h"
+#include "symbol.h"
+#include <stdio.h>
 #include <stdbool.h>
 
 typedef enum {
@@ -17,13 +20,32 @@ typedef enum {
     LCLEX_TOKEN_EOF
 } lclex_tokentype_t;
 
+/* A token is the len characters at data, the text is not terminated
+   after it. */
 typedef struct {
     char *data;
+    size_t len;
     lclex_tokentype_t type;
 } lclex_token_t;
 
+/* Reads tokens from the text up to end without writing to it, so that
+   any number of lexers can run at once and statements are read straight
+   from a read-only mapping. Token is the current token and pos where the
+   next one is looked for. */
+typedef struct {
+    char *pos;
+    char *end;
+    lclex_token_t token;
+} lclex_lexer_t;
+
+#define LCLEX_CHAR_SPACE 1
+#define LCLEX_CHAR_ID_START 2
+#define LCLEX_CHAR_DIGIT 4
+
 #define LCLEX_N_OPERATOR_LEVELS 8
-#define LCLEX_MAX_OPERATORS_PER_LEVEL 8
+
+/* Must be a power of two, the table is indexed by masking the hash. */
+#define LCLEX_BINDERS_INIT_SIZE 32
 
 typedef enum {
     LCLEX_OPERATOR_PREFIX,
@@ -34,21 +56,39 @@ typedef enum {
 
 typedef struct {
     char *operator;
+    size_t level;
     lclex_node_t *node;
 } lclex_operator_def_t;
 
+/* Operators keyed by their symbol, any number per level. Lower levels
+   bind tighter, and the type of a level decides its associativity. */
 typedef struct {
-    lclex_operator_type_t type;
-    size_t n;
-    lclex_operator_def_t defs[LCLEX_MAX_OPERATORS_PER_LEVEL];
-} lclex_operator_level_t;
-
+    lclex_hashmap_t defs;
+    lclex_operator_type_t types[LCLEX_N_OPERATOR_LEVELS];
+} lclex_operator_table_t;
+
+/* The binders in scope, as the depth at which each symbol was last bound,
+   so that the de Bruijn index of a variable is found in one lookup.
+   Slots are never emptied: a symbol whose binders are all closed has
+   depth 0. Shadowed holds the depths that inner binders replaced. */
 typedef struct {
-    char **text;
-    lclex_token_t *token;
-    lclex_stack_t *stack;
+    lclex_symbol_t *symbols;
+    size_t *depths;
+    size_t size;
+    size_t cap;
+    size_t depth;
+    lclex_stack_t shadowed;
+} lclex_binder_map_t;
+
+/* The symbol of the current token is interned at most once, and kept
+   along with the position of the token it was interned for. */
+typedef struct {
+    lclex_lexer_t lexer;
+    lclex_binder_map_t binders;
+    lclex_symbol_t symbol;
+    char *symbol_data;
     lclex_hashmap_t *defs;
-    lclex_operator_level_t *opdefs;
+    lclex_operator_table_t *opdefs;
 } lclex_parser_data_t;
 
 typedef enum {
@@ -57,11 +97,19 @@ typedef enum {
     LCLEX_PARSER_EXIT
 } lclex_parser_signal_t;
 
+/* Where syntax errors are written, stderr when NULL. Lets a caller that 
+   parses ahead hold the errors back until the statement is reached. */
+extern FILE *lclex_parser_errors;
+
 bool lclex_is_idchar_start(char c);
 
 bool lclex_is_idchar_continue(char c);
 
-char *lclex_next_token(lclex_token_t *token, char **text);
+void lclex_init_lexer(lclex_lexer_t *lexer, char *text, size_t len);
+
+lclex_tokentype_t lclex_next_token(lclex_lexer_t *lexer);
+
+bool lclex_token_is(lclex_token_t *token, char *str);
 
 char *lclex_type_string(lclex_tokentype_t type);
 
@@ -70,18 +118,39 @@ bool lclex_expect_token(lclex_token_t *token, lclex_tokentype_t expected);
 lclex_node_t *lclex_new_binary_node(lclex_node_t *func, lclex_node_t *left, 
                                     lclex_node_t *right);
 
-void lclex_init_operator_levels(lclex_operator_level_t *opdefs);
+void lclex_init_operator_table(lclex_operator_table_t *opdefs);
+
+void lclex_destruct_operator_table(lclex_operator_table_t *opdefs);
+
+void lclex_define_operator(lclex_operator_table_t *opdefs, char *operator,
+                           size_t level, lclex_node_t *node);
+
+lclex_operator_def_t *lclex_lookup_operator(lclex_operator_table_t *opdefs,
+                                            lclex_symbol_t symbol);
+
+void lclex_init_binder_map(lclex_binder_map_t *binders);
+
+void lclex_destruct_binder_map(lclex_binder_map_t *binders);
+
+void lclex_bind(lclex_binder_map_t *binders, lclex_symbol_t symbol);
+
+void lclex_unbind(lclex_binder_map_t *binders, lclex_symbol_t symbol);
+
+bool lclex_lookup_binder(lclex_binder_map_t *binders, lclex_symbol_t symbol,
+                         size_t *index);
 
-void lclex_destruct_operator_levels(lclex_operator_level_t *opdefs);
+void lclex_bind_primitives(lclex_hashmap_t *defs);
 
-bool lclex_parse_definition(lclex_token_t *token, char **text, char **key);
+bool lclex_parse_definition(lclex_lexer_t *lexer, char **key);
 
-bool lclex_parse_operator_definition(lclex_token_t *token, char **text, 
-                                     char **key, size_t *level,
-                                     lclex_operator_level_t opdefs[]);
+bool lclex_parse_operator_definition(lclex_lexer_t *lexer, char **key, 
+                                     size_t *level);
 
-lclex_parser_signal_t lclex_parse_statement(char **text, lclex_hashmap_t *defs, 
-                                            lclex_operator_level_t opdefs[],
+lclex_parser_signal_t lclex_parse_statement(char **text, size_t len,
+                                            lclex_hashmap_t *defs, 
+                                            lclex_operator_table_t *opdefs,
+                                            lclex_arena_t *def_arena,
+                                            lclex_cache_t *cache,
                                             lclex_node_t **pnode);
 
 lclex_node_t *lclex_parse_application(lclex_parser_data_t *parser);
@@ -0,0 +1,103 @@
+#ifndef LCLEX_POOL_H
+#define LCLEX_POOL_H
+
+#include "tree.h"
+#include "utils.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LCLEX_POOL_INIT_SIZE 1024
+
+#define LCLEX_POOL_NONE UINT32_MAX
+
+typedef uint32_t lclex_handle_t;
+
+/* A place holding a handle: the left or right child of a node, or the
+   root of the pool. Unlike pointers into the arrays, slots stay valid
+   when the arrays grow. The two largest values are taken by the root and
+   by LCLEX_POOL_NONE, which limits pools to 2^31 - 1 nodes. */
+typedef uint32_t lclex_slot_t;
+
+#define LCLEX_SLOT(handle, right) (((handle) << 1) | (right))
+
+#define LCLEX_SLOT_HANDLE(slot) ((slot) >> 1)
+
+#define LCLEX_SLOT_RIGHT(slot) ((slot) & 1)
+
+#define LCLEX_POOL_ROOT (UINT32_MAX - 1)
+
+/* Bytes per node over all arrays, against sizeof(lclex_node_t). */
+#define LCLEX_POOL_NODE_BYTES (sizeof(uint8_t) + 4 * sizeof(uint32_t))
+
+typedef struct {
+    uint64_t steps;
+    uint64_t allocated;
+    uint64_t freed;
+    uint64_t live;
+    uint64_t peak;
+} lclex_pool_stats_t;
+
+/* Term store for the rewrite engine with one array per node field,
+   indexed by 32-bit handles. Data holds the de Bruijn index of a bound
+   variable, the symbol of an abstraction or free variable, the 
+   primitive, or the low half of a numeral, whose high half is kept in
+   left. Freed nodes are linked through left. */
+typedef struct {
+    uint8_t *types;
+    uint32_t *refs;
+    uint32_t *data;
+    lclex_handle_t *left;
+    lclex_handle_t *right;
+    size_t size;
+    size_t cap;
+    lclex_handle_t free_list;
+    lclex_handle_t root;
+    lclex_handle_t primitives[LCLEX_N_PRIMITIVES];
+    lclex_pool_stats_t stats;
+} lclex_pool_t;
+
+void lclex_init_pool(lclex_pool_t *pool);
+
+void lclex_destruct_pool(lclex_pool_t *pool);
+
+lclex_handle_t lclex_pool_new(lclex_pool_t *pool, lclex_type_t type,
+                              uint32_t data, lclex_handle_t left,
+                              lclex_handle_t right);
+
+lclex_handle_t lclex_pool_new_numeral(lclex_pool_t *pool, uint64_t n);
+
+void lclex_pool_free(lclex_pool_t *pool, lclex_handle_t node);
+
+lclex_handle_t lclex_pool_copy(lclex_pool_t *pool, lclex_handle_t node);
+
+void lclex_pool_unshare(lclex_pool_t *pool, lclex_slot_t slot);
+
+bool lclex_pool_is_closed(lclex_pool_t *pool, lclex_handle_t node,
+                          lclex_bruijn_index_t index);
+
+void lclex_pool_shift(lclex_pool_t *pool, lclex_handle_t node,
+                      uint64_t shift, lclex_bruijn_index_t index);
+
+void lclex_pool_find_bound_and_shift(lclex_pool_t *pool, lclex_slot_t slot,
+                                     lclex_bruijn_index_t index,
+                                     lclex_stack_t *stack);
+
+bool lclex_pool_fold_numeral(lclex_pool_t *pool, lclex_handle_t node,
+                             uint64_t *pn);
+
+lclex_handle_t lclex_pool_expand(lclex_pool_t *pool, lclex_handle_t node);
+
+void lclex_pool_reduce_redex(lclex_pool_t *pool, lclex_slot_t redex,
+                             lclex_stack_t *stack);
+
+lclex_handle_t lclex_pool_import(lclex_pool_t *pool, lclex_node_t *node);
+
+lclex_node_t *lclex_pool_export(lclex_pool_t *pool, lclex_handle_t node);
+
+void lclex_pool_reduce_expression(lclex_pool_t *pool, lclex_node_t **pexpr,
+                                  uint64_t max, bool show_reductions);
+
+void lclex_write_pool_stats(lclex_pool_t *pool, FILE *stream);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef LCLEX_SOURCE_H
+#define LCLEX_SOURCE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* A source file mapped read-only and split into statements, which are
+   parsed where they are as spans of the mapping. A statement is a line
+   together with the lines after it that start with a space or a tab; the
+   lexer reads the newlines in it as spaces. Line is the line the last
+   statement starts on, next_line the one after its last line. */
+typedef struct {
+    char *data;
+    size_t size;
+    char *pos;
+    size_t line;
+    size_t next_line;
+} lclex_source_t;
+
+bool lclex_open_source(lclex_source_t *source, char *path);
+
+void lclex_close_source(lclex_source_t *source);
+
+char *lclex_next_statement(lclex_source_t *source, size_t *len);
+
+#endif
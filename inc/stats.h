@@ -0,0 +1,50 @@
+#ifndef LCLEX_STATS_H
+#define LCLEX_STATS_H
+
+#include "tree.h"
+#include "arena.h"
+#include "cache.h"
+#include <stdio.h>
+#include <stdint.h>
+
+typedef enum {
+    LCLEX_PHASE_PARSE,
+    LCLEX_PHASE_REDUCE,
+    LCLEX_PHASE_PRINT,
+    LCLEX_PHASE_DECODE,
+    LCLEX_N_PHASES
+} lclex_phase_t;
+
+/* Measurements of one evaluated statement. Times are in nanoseconds, the
+   tree counters cover the reduction only and the peak resident set is
+   that of the whole process so far, in KiB. The cache counters are those
+   of the whole session so far, and only set with use_cache. */
+typedef struct {
+    uint64_t index;
+    char *engine;
+    uint64_t time[LCLEX_N_PHASES];
+    uint64_t steps;
+    lclex_tree_counters_t counters;
+    lclex_arena_stats_t arena;
+    uint64_t peak_rss;
+    bool use_cache;
+    lclex_cache_stats_t cache;
+} lclex_statement_stats_t;
+
+char *lclex_phase_name(lclex_phase_t phase);
+
+uint64_t lclex_clock(void);
+
+void lclex_tree_counters_since(lclex_tree_counters_t *counters,
+                               lclex_tree_counters_t *start);
+
+void lclex_finish_statement_stats(lclex_statement_stats_t *stats,
+                                  lclex_arena_t *arena);
+
+void lclex_write_statement_stats(lclex_statement_stats_t *stats,
+                                 FILE *stream);
+
+void lclex_write_statement_json(lclex_statement_stats_t *stats,
+                                FILE *stream);
+
+#endif
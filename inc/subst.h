@@ -0,0 +1,96 @@
+#ifndef LCLEX_SUBST_H
+#define LCLEX_SUBST_H
+
+#include "tree.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LCLEX_SUBST_BLOCK_SIZE 4096
+
+#define LCLEX_SUBST_STACK_INIT_SIZE 64
+
+typedef enum {
+    LCLEX_SUBST_CONS,
+    LCLEX_SUBST_LIFT,
+    LCLEX_SUBST_SHIFT
+} lclex_subst_kind_t;
+
+struct lclex_substitution_t;
+
+/* A term of the parsed tree under a substitution that has not been
+   applied to it yet, NULL being the identity. A suspension with a NULL
+   term stands for a variable bound during read back, and its subst field
+   then holds the index of that variable. */
+typedef struct {
+    lclex_node_t *term;
+    struct lclex_substitution_t *subst;
+} lclex_subst_term_t;
+
+/* Substitutions of the lambda-upsilon calculus, never written to once
+   made. Cons maps 0 to head and i + 1 to next(i), lift maps 0 to 0 and
+   i + 1 to next(i) shifted by one, and shift maps i to next(i) shifted
+   by shift. */
+typedef struct lclex_substitution_t {
+    lclex_subst_kind_t kind;
+    uint64_t shift;
+    lclex_subst_term_t head;
+    struct lclex_substitution_t *next;
+} lclex_substitution_t;
+
+typedef struct lclex_subst_block_t {
+    struct lclex_subst_block_t *next;
+    lclex_substitution_t *substs;
+    size_t used;
+} lclex_subst_block_t;
+
+typedef struct {
+    uint64_t steps;
+    uint64_t pushes;
+    uint64_t lookups;
+    uint64_t substs;
+    uint64_t max_stack;
+} lclex_subst_stats_t;
+
+/* Normal-order reduction with explicit substitutions. A beta step only
+   suspends the substitution of the argument on the body, and
+   substitutions are pushed through a node when the search for the head
+   redex or the read back reaches it, so the parts of a term that are
+   discarded are never substituted in or shifted. Arguments wait on the
+   stack, with the first argument on top. */
+typedef struct {
+    lclex_subst_term_t *stack;
+    size_t size;
+    size_t cap;
+    lclex_subst_block_t *blocks;
+    lclex_subst_stats_t stats;
+} lclex_subst_t;
+
+void lclex_init_subst(lclex_subst_t *machine);
+
+void lclex_destruct_subst(lclex_subst_t *machine);
+
+lclex_substitution_t *lclex_new_substitution(lclex_subst_t *machine,
+                                             lclex_subst_kind_t kind,
+                                             lclex_substitution_t *next);
+
+lclex_substitution_t *lclex_shift_substitution(lclex_subst_t *machine,
+                                               lclex_substitution_t *subst,
+                                               uint64_t shift);
+
+void lclex_subst_lookup(lclex_subst_t *machine, lclex_substitution_t *subst,
+                        lclex_bruijn_index_t index,
+                        lclex_subst_term_t *suspension);
+
+void lclex_subst_whnf(lclex_subst_t *machine, lclex_subst_term_t *suspension,
+                      size_t base);
+
+lclex_node_t *lclex_subst_read_back(lclex_subst_t *machine,
+                                    lclex_subst_term_t suspension);
+
+void lclex_subst_reduce_expression(lclex_subst_t *machine,
+                                   lclex_node_t **pexpr);
+
+void lclex_write_subst_stats(lclex_subst_t *machine, FILE *stream);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef LCLEX_SYMBOL_H
+#define LCLEX_SYMBOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Must be a power of two, the table is indexed by masking the hash. */
+#define LCLEX_SYMBOLS_INIT_SIZE 256
+
+#define LCLEX_NO_SYMBOL UINT32_MAX
+
+/* Names of Church numerals, interned first so that encoding a numeral
+   during reduction never touches the table. */
+#define LCLEX_SYMBOL_F 0
+
+#define LCLEX_SYMBOL_X 1
+
+typedef uint32_t lclex_symbol_t;
+
+/* Interned identifiers, shared by every term for the lifetime of the
+   program. A symbol is an index into names, so two names are equal
+   exactly when their symbols are. Slots in the open addressing table hold
+   symbols, with LCLEX_NO_SYMBOL marking empty slots. */
+typedef struct {
+    char **names;
+    size_t n_names;
+    size_t names_cap;
+    lclex_symbol_t *slots;
+    size_t cap;
+} lclex_symbol_table_t;
+
+extern lclex_symbol_table_t lclex_symbols;
+
+void lclex_init_symbols(void);
+
+void lclex_destruct_symbols(void);
+
+lclex_symbol_t lclex_intern(char *name);
+
+lclex_symbol_t lclex_intern_n(char *name, size_t len);
+
+char *lclex_symbol_name(lclex_symbol_t symbol);
+
+#endif
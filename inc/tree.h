@@ -2,6 +2,8 @@
 #define LCLEX_TREE_H
 
 #include "utils.h"
+#include "arena.h"
+#include "symbol.h"
 #include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -11,16 +13,48 @@ typedef enum {
     LCLEX_APPLICATION, 
     LCLEX_ABSTRACTION, 
     LCLEX_FREE_VARIABLE, 
-    LCLEX_BOUND_VARIABLE
+    LCLEX_BOUND_VARIABLE,
+    LCLEX_NUMERAL,
+    LCLEX_PRIMITIVE
 } lclex_type_t;
 
+/* Arithmetic on numerals that is computed natively when every argument
+   folds to a numeral, see lclex_fold_numeral. */
+typedef enum {
+    LCLEX_PRIMITIVE_ADD,
+    LCLEX_PRIMITIVE_MUL,
+    LCLEX_PRIMITIVE_EXP,
+    LCLEX_PRIMITIVE_PRED,
+    LCLEX_PRIMITIVE_SUB,
+    LCLEX_N_PRIMITIVES
+} lclex_primitive_t;
+
+#define LCLEX_MAX_PRIMITIVE_ARITY 2
+
 typedef uint64_t lclex_bruijn_index_t;
 
+#define LCLEX_SCOPE_UNKNOWN UINT32_MAX
+
+/* A node with refs > 1 is shared between several parents, and anything
+   that writes to one copies it first, sharing its children in turn. 
+   Shifting and substitution only enter nodes whose scope reaches the 
+   indices they change, so closed shared terms are never copied. 
+   Shared nodes may be reachable from several threads, so refs is only
+   accessed atomically outside of parsing. 
+   Numerals and primitives are closed leaves that stand for their Church
+   encoding and their definition, and are only expanded when applied.
+   Scope is one more than the largest free index in the node, so 0 for
+   closed nodes. It only has to be an upper bound, as reduction never adds
+   free variables, and is LCLEX_SCOPE_UNKNOWN until the children are set. */
 typedef struct lclex_node_t {
     lclex_type_t type;
+    uint32_t refs;
+    uint32_t scope;
     union {
-        char *str;
+        lclex_symbol_t symbol;
         lclex_bruijn_index_t index;
+        uint64_t number;
+        lclex_primitive_t primitive;
     } data;
     struct lclex_node_t *left;
     struct lclex_node_t *right;
@@ -28,25 +62,92 @@ typedef struct lclex_node_t {
 
 extern lclex_node_t *NULL_NODE;
 
-lclex_node_t *lclex_new_node(lclex_type_t type, char *data,
+/* Definitions the primitives expand to, set by lclex_bind_primitives. */
+extern lclex_node_t *lclex_primitive_defs[LCLEX_N_PRIMITIVES];
+
+/* Work done on the rewritten tree by the calling thread: nodes entered
+   while searching for a redex, created by lclex_copy_node, visited by
+   lclex_shift and by lclex_find_bound_and_shift. Only ever incremented,
+   readers take differences. */
+typedef struct {
+    uint64_t visited;
+    uint64_t copied;
+    uint64_t shifted;
+    uint64_t substituted;
+} lclex_tree_counters_t;
+
+extern __thread lclex_tree_counters_t lclex_tree_counters;
+
+/* Whether nodes are written with only the brackets needed to read them
+   back, rather than around every application and abstraction. */
+extern bool lclex_print_minimal;
+
+/* Resolves a bound variable in an opaque environment for folding, moving
+   *penv to the environment of the term returned. NULL means the variable
+   has no term, such as one bound during read back. */
+typedef lclex_node_t *(*lclex_lookup_function_t)(void **penv,
+                                                 lclex_bruijn_index_t index);
+
+/* Takes over the reduction of the subterm in a slot, see lclex_cursor_t. */
+typedef void (*lclex_spawn_function_t)(void *data, lclex_node_t **pnode);
+
+/* Position of the normal-order search: the slots from the root to the 
+   current node, and the positions in that path that hold shared nodes. 
+   With spawn set, the right child of an application whose left child is
+   in normal form is handed to spawn instead of being entered, as nothing
+   reduced in it can change the rest of the term. */
+typedef struct {
+    lclex_stack_t path;
+    lclex_stack_t shared;
+    lclex_spawn_function_t spawn;
+    void *spawn_data;
+} lclex_cursor_t;
+
+lclex_node_t *lclex_new_node(lclex_type_t type, lclex_symbol_t symbol,
                              lclex_node_t *left, lclex_node_t *right);
 
+void lclex_update_scope(lclex_node_t *node);
+
+uint32_t lclex_node_refs(lclex_node_t *node);
+
+void lclex_retain_node(lclex_node_t *node);
+
 lclex_node_t *lclex_new_application(lclex_node_t *left, lclex_node_t *right);
 
-lclex_node_t *lclex_new_abstraction(char *data, lclex_node_t *left);
+lclex_node_t *lclex_new_abstraction(lclex_symbol_t symbol,
+                                    lclex_node_t *left);
 
-lclex_node_t *lclex_new_free_variable(char *data);
+lclex_node_t *lclex_new_free_variable(lclex_symbol_t symbol);
 
 lclex_node_t *lclex_new_bound_variable(lclex_bruijn_index_t index);
 
+lclex_node_t *lclex_new_numeral(uint64_t n);
+
+lclex_node_t *lclex_new_primitive(lclex_primitive_t primitive);
+
+char *lclex_primitive_name(lclex_primitive_t primitive);
+
+size_t lclex_primitive_arity(lclex_primitive_t primitive);
+
+bool lclex_apply_primitive(lclex_primitive_t primitive, uint64_t *args, 
+                           uint64_t *pn);
+
+bool lclex_fold_numeral(lclex_node_t *node, void *env, 
+                        lclex_lookup_function_t lookup, uint64_t *pn);
+
+lclex_node_t *lclex_expand_node(lclex_node_t *node);
+
 lclex_node_t *lclex_copy_node(lclex_node_t *node);
 
+void lclex_unshare_node(lclex_node_t **pnode);
+
+bool lclex_is_closed(lclex_node_t *node, lclex_bruijn_index_t index);
+
 void lclex_free_node(void *data);
 
 void lclex_free_partial_node(void *data);
 
-void lclex_write_node_wrapped(lclex_node_t *node, FILE *stream, 
-                              lclex_stack_t *stack);
+void lclex_format_node(lclex_node_t *node, lclex_string_buf_t *buf);
 
 void lclex_write_node(lclex_node_t *node, FILE *stream);
 
@@ -56,18 +157,33 @@ uint64_t lclex_church_decode(lclex_node_t *node);
 
 void lclex_remove_bound_names(lclex_node_t *node);
 
-lclex_node_t **lclex_find_redex(lclex_node_t **pnode);
+lclex_node_t **lclex_find_redex(lclex_node_t **pnode, 
+                                lclex_node_t ***pshared);
 
 void lclex_find_bound_and_shift(lclex_node_t **pnode, lclex_node_t *new, 
                                 lclex_bruijn_index_t index, 
                                 lclex_stack_t *stack);
 
-void lclex_shift(lclex_node_t *node, uint64_t shift, 
+void lclex_shift(lclex_node_t **pnode, uint64_t shift, 
                  lclex_bruijn_index_t index);
 
 void lclex_reduce_redex(lclex_node_t **redex, lclex_stack_t *stack);
 
-void lclex_reduce_expression(lclex_node_t **pexpr, uint64_t max, 
-                             bool show_reductions);
+void lclex_init_cursor(lclex_cursor_t *cursor, lclex_node_t **pexpr);
+
+void lclex_destruct_cursor(lclex_cursor_t *cursor);
+
+void lclex_push_cursor(lclex_cursor_t *cursor, lclex_node_t **pnode);
+
+lclex_node_t **lclex_pop_cursor(lclex_cursor_t *cursor);
+
+lclex_node_t **lclex_cursor_next_redex(lclex_cursor_t *cursor);
+
+void lclex_unshare_cursor(lclex_cursor_t *cursor);
+
+void lclex_cursor_contracted(lclex_cursor_t *cursor);
+
+uint64_t lclex_reduce_expression(lclex_node_t **pexpr, uint64_t max, 
+                                 bool show_reductions);
 
 #endif
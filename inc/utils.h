@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #define LCLEX_STRING_BUF_INIT_SIZE 8
 
@@ -18,10 +19,14 @@ void lclex_destruct_string_buf(lclex_string_buf_t *buf);
 
 void lclex_clear_string_buf(lclex_string_buf_t *buf);
 
+void lclex_append_string_buf(lclex_string_buf_t *buf, char *str, size_t len);
+
 void lclex_readline(lclex_string_buf_t *buf, FILE *stream);
 
 char *lclex_strdup(char *str);
 
+char *lclex_strndup(char *str, size_t len);
+
 #define LCLEX_STACK_INIT_SIZE 32
 
 typedef struct {
@@ -40,4 +45,35 @@ void lclex_push_stack(lclex_stack_t *stack, void *data);
 
 void *lclex_pop_stack(lclex_stack_t *stack);
 
+/* A stack of what a traversal has left to visit. It starts on an array
+   of LCLEX_STACK_INIT_SIZE entries the caller declares on the call stack,
+   which is enough for most terms, and moves to the heap once it outgrows
+   it, so that it is there while its capacity is another. Traversals push
+   and pop for most nodes, so these are inline. */
+static inline void lclex_init_pending(lclex_stack_t *pending, void **local) {
+    pending->data = local;
+    pending->size = 0;
+    pending->cap = LCLEX_STACK_INIT_SIZE;
+}
+
+static inline void lclex_destruct_pending(lclex_stack_t *pending) {
+    if (pending->cap != LCLEX_STACK_INIT_SIZE) {
+        free(pending->data);
+    }
+}
+
+void **lclex_grow_pending(void **data, size_t cap);
+
+static inline void lclex_push_pending(lclex_stack_t *pending, void *data) {
+    if (pending->size == pending->cap) {
+        pending->data = lclex_grow_pending(pending->data, pending->cap);
+        pending->cap *= 2;
+    }
+    pending->data[pending->size++] = data;
+}
+
+static inline void *lclex_pop_pending(lclex_stack_t *pending) {
+    return pending->data[--pending->size];
+}
+
 #endif
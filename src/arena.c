@@ -0,0 +1,107 @@
+#include "arena.h"
+#include "tree.h"
+#include <stdlib.h>
+#include <string.h>
+
+__thread lclex_arena_t *lclex_current_arena = NULL;
+
+static lclex_arena_slab_t *lclex_new_arena_slab(void) {
+    lclex_arena_slab_t *slab = malloc(sizeof(lclex_arena_slab_t));
+
+    slab->next = NULL;
+    slab->nodes = malloc(LCLEX_ARENA_SLAB_SIZE * sizeof(lclex_node_t));
+    slab->used = 0;
+
+    return slab;
+}
+
+void lclex_init_arena(lclex_arena_t *arena) {
+    arena->slabs = lclex_new_arena_slab();
+    arena->current = arena->slabs;
+    arena->free_list = NULL;
+
+    memset(&arena->stats, 0, sizeof(lclex_arena_stats_t));
+    arena->stats.slabs = 1;
+}
+
+void lclex_destruct_arena(lclex_arena_t *arena) {
+    lclex_arena_slab_t *next_slab, *slab = arena->slabs;
+
+    while (slab != NULL) {
+        next_slab = slab->next;
+        free(slab->nodes);
+        free(slab);
+        slab = next_slab;
+    }
+
+    if (lclex_current_arena == arena) {
+        lclex_current_arena = NULL;
+    }
+}
+
+void lclex_reset_arena(lclex_arena_t *arena) {
+    uint64_t slabs = arena->stats.slabs;
+
+    arena->current = arena->slabs;
+    arena->current->used = 0;
+    arena->free_list = NULL;
+
+    memset(&arena->stats, 0, sizeof(lclex_arena_stats_t));
+    arena->stats.slabs = slabs;
+}
+
+lclex_arena_t *lclex_use_arena(lclex_arena_t *arena) {
+    lclex_arena_t *prev = lclex_current_arena;
+    lclex_current_arena = arena;
+
+    return prev;
+}
+
+lclex_node_t *lclex_arena_alloc_node(lclex_arena_t *arena) {
+    lclex_node_t *node;
+    lclex_arena_slab_t *slab = arena->current;
+
+    arena->stats.allocated++;
+    arena->stats.live++;
+    if (arena->stats.live > arena->stats.peak) {
+        arena->stats.peak = arena->stats.live;
+    }
+
+    if (arena->free_list != NULL) {
+        node = arena->free_list;
+        arena->free_list = node->left;
+        arena->stats.reused++;
+
+        return node;
+    }
+
+    if (slab->used == LCLEX_ARENA_SLAB_SIZE) {
+        if (slab->next == NULL) {
+            slab->next = lclex_new_arena_slab();
+            arena->stats.slabs++;
+        }
+        slab = slab->next;
+        slab->used = 0;
+        arena->current = slab;
+    }
+
+    node = &slab->nodes[slab->used];
+    slab->used++;
+
+    return node;
+}
+
+void lclex_arena_free_node(lclex_arena_t *arena, lclex_node_t *node) {
+    node->left = arena->free_list;
+    arena->free_list = node;
+
+    arena->stats.freed++;
+    arena->stats.live--;
+}
+
+void lclex_write_arena_stats(lclex_arena_t *arena, FILE *stream) {
+    fprintf(stream, "> nodes: %ld allocated, %ld reused, %ld freed, "
+            "%ld peak, %ld slabs\n",
+            arena->stats.allocated, arena->stats.reused, arena->stats.freed,
+            arena->stats.peak, arena->stats.slabs);
+}
@@ -0,0 +1,618 @@
+#include "cache.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void lclex_keep_symbol(void *data) {
+    (void)data;
+}
+
+static void lclex_free_dependents(void *data) {
+    lclex_stack_t *stack = data;
+
+    lclex_destruct_stack(stack);
+    free(stack);
+}
+
+void lclex_init_cache(lclex_cache_t *cache, bool normalize_defs) {
+    cache->data = calloc(LCLEX_CACHE_INIT_SIZE,
+                         sizeof(lclex_cache_entry_t *));
+    cache->size = 0;
+    cache->cap = LCLEX_CACHE_INIT_SIZE;
+
+    lclex_init_pointer_hashmap(&cache->roots, lclex_keep_symbol);
+    lclex_init_string_hashmap(&cache->dependents, lclex_free_dependents);
+    lclex_init_arena(&cache->arena);
+    pthread_mutex_init(&cache->lock, NULL);
+
+    cache->normalize_defs = normalize_defs;
+    memset(&cache->stats, 0, sizeof(lclex_cache_stats_t));
+}
+
+static void lclex_free_cache_entry(lclex_cache_entry_t *entry) {
+    lclex_free_node(entry->term);
+    if (entry->normal != NULL) {
+        lclex_free_node(entry->normal);
+    }
+    lclex_destruct_stack(&entry->deps);
+    free(entry);
+}
+
+void lclex_destruct_cache(lclex_cache_t *cache) {
+    lclex_arena_t *prev_arena = lclex_use_arena(&cache->arena);
+
+    for (size_t i = 0; i < cache->cap; i++) {
+        lclex_cache_entry_t *next, *entry = cache->data[i];
+
+        while (entry != NULL) {
+            next = entry->next;
+            lclex_free_cache_entry(entry);
+            entry = next;
+        }
+    }
+
+    lclex_use_arena(prev_arena);
+
+    free(cache->data);
+    lclex_destruct_hashmap(&cache->roots);
+    lclex_destruct_hashmap(&cache->dependents);
+    lclex_destruct_arena(&cache->arena);
+    pthread_mutex_destroy(&cache->lock);
+}
+
+/* The symbol of the definition whose body node is, or LCLEX_NO_SYMBOL. */
+static lclex_symbol_t lclex_cache_root(lclex_cache_t *cache,
+                                       lclex_node_t *node) {
+    uintptr_t symbol;
+
+    if (lclex_node_refs(node) == 1) {
+        return LCLEX_NO_SYMBOL;
+    }
+
+    symbol = (uintptr_t)lclex_lookup_hashmap(&cache->roots, node);
+
+    return symbol == 0 ? LCLEX_NO_SYMBOL : symbol - 1;
+}
+
+static bool lclex_stack_contains(lclex_stack_t *stack, void *data) {
+    for (size_t i = 0; i < stack->size; i++) {
+        if (stack->data[i] == data) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static lclex_hash_t lclex_cache_mix(lclex_hash_t hash, uint64_t value) {
+    hash ^= value;
+    hash *= 1099511628211ULL;
+
+    return hash ^ (hash >> 29);
+}
+
+/* The walks below keep what they have left to visit on a pending stack,
+   as terms can be deeper than the call stack allows. A node whose result
+   is built from those of its children is pushed again behind a NULL, and
+   the results wait on a second stack until it is popped. */
+
+/* The hash of node when it is not built from those of its children. */
+static bool lclex_cache_hash_leaf(lclex_cache_t *cache, lclex_node_t *node,
+                                  lclex_hash_t *phash) {
+    lclex_hash_t hash = lclex_cache_mix(14695981039346656037ULL,
+                                        node->type);
+
+    if (lclex_cache_root(cache, node) != LCLEX_NO_SYMBOL) {
+        *phash = lclex_cache_mix(hash, lclex_hash_pointer(node));
+        return true;
+    }
+
+    switch (node->type) {
+        case LCLEX_APPLICATION:
+        case LCLEX_ABSTRACTION:
+            return false;
+
+        case LCLEX_FREE_VARIABLE:
+            *phash = lclex_cache_mix(hash, node->data.symbol);
+            break;
+
+        case LCLEX_BOUND_VARIABLE:
+            *phash = lclex_cache_mix(hash, node->data.index);
+            break;
+
+        case LCLEX_NUMERAL:
+            *phash = lclex_cache_mix(hash, node->data.number);
+            break;
+
+        case LCLEX_PRIMITIVE:
+            *phash = lclex_cache_mix(hash, node->data.primitive);
+            break;
+    }
+
+    return true;
+}
+
+static lclex_hash_t lclex_cache_hash(lclex_cache_t *cache,
+                                     lclex_node_t *node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    void *hashes_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending, hashes;
+    lclex_hash_t hash = 0;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_init_pending(&hashes, hashes_data);
+    lclex_push_pending(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pop_pending(&pending);
+
+        if (node == NULL) {
+            node = lclex_pop_pending(&pending);
+            hash = lclex_cache_mix(14695981039346656037ULL, node->type);
+            if (node->type == LCLEX_ABSTRACTION) {
+                hash = lclex_cache_mix(hash, node->data.symbol);
+            }
+            hash = lclex_cache_mix(hash, 
+                                   (uintptr_t)lclex_pop_pending(&hashes));
+            if (node->type == LCLEX_APPLICATION) {
+                hash = lclex_cache_mix(hash, 
+                                       (uintptr_t)lclex_pop_pending(&hashes));
+            }
+        } else if (!lclex_cache_hash_leaf(cache, node, &hash)) {
+            lclex_push_pending(&pending, node);
+            lclex_push_pending(&pending, NULL);
+            lclex_push_pending(&pending, node->left);
+            if (node->type == LCLEX_APPLICATION) {
+                lclex_push_pending(&pending, node->right);
+            }
+            continue;
+        }
+
+        lclex_push_pending(&hashes, (void *)(uintptr_t)hash);
+    }
+
+    hash = (uintptr_t)lclex_pop_pending(&hashes);
+    lclex_destruct_pending(&pending);
+    lclex_destruct_pending(&hashes);
+
+    return hash;
+}
+
+/* Pairs of nodes left to compare are pushed side by side. */
+static bool lclex_cache_equal(lclex_node_t *left, lclex_node_t *right) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    bool equal = true;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_push_pending(&pending, left);
+    lclex_push_pending(&pending, right);
+
+    while (equal && pending.size > 0) {
+        right = lclex_pop_pending(&pending);
+        left = lclex_pop_pending(&pending);
+
+        if (left == right) {
+            continue;
+        }
+
+        if (left->type != right->type) {
+            equal = false;
+            break;
+        }
+
+        switch (left->type) {
+            case LCLEX_APPLICATION:
+                lclex_push_pending(&pending, left->right);
+                lclex_push_pending(&pending, right->right);
+                lclex_push_pending(&pending, left->left);
+                lclex_push_pending(&pending, right->left);
+                break;
+
+            case LCLEX_ABSTRACTION:
+                equal = left->data.symbol == right->data.symbol;
+                lclex_push_pending(&pending, left->left);
+                lclex_push_pending(&pending, right->left);
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+                equal = left->data.symbol == right->data.symbol;
+                break;
+
+            case LCLEX_BOUND_VARIABLE:
+                equal = left->data.index == right->data.index;
+                break;
+
+            case LCLEX_NUMERAL:
+                equal = left->data.number == right->data.number;
+                break;
+
+            case LCLEX_PRIMITIVE:
+                equal = left->data.primitive == right->data.primitive;
+                break;
+        }
+    }
+
+    lclex_destruct_pending(&pending);
+    return equal;
+}
+
+/* The copy of node when it is not built from copies of its children: 
+   the body of a definition, whose symbol is pushed onto deps, a shared
+   node copied before or a node without children. */
+static lclex_node_t *lclex_cache_copy_leaf(lclex_cache_t *cache,
+                                           lclex_node_t *node,
+                                           lclex_hashmap_t *copies,
+                                           lclex_stack_t *deps) {
+    lclex_symbol_t symbol = lclex_cache_root(cache, node);
+    lclex_node_t *copy;
+
+    if (symbol != LCLEX_NO_SYMBOL) {
+        lclex_retain_node(node);
+        if (!lclex_stack_contains(deps, (void *)(uintptr_t)symbol)) {
+            lclex_push_stack(deps, (void *)(uintptr_t)symbol);
+        }
+        return node;
+    }
+
+    if (lclex_node_refs(node) > 1) {
+        copy = lclex_lookup_hashmap(copies, node);
+        if (copy != NULL) {
+            lclex_retain_node(copy);
+            return copy;
+        }
+    }
+
+    if (node->left != NULL) {
+        return NULL;
+    }
+
+    copy = lclex_new_node(node->type, LCLEX_NO_SYMBOL, NULL, NULL);
+    copy->data = node->data;
+    copy->scope = node->scope;
+
+    if (lclex_node_refs(node) > 1) {
+        lclex_insert_hashmap(copies, node, copy);
+    }
+
+    return copy;
+}
+
+/* Copies node into the current arena, keeping the sharing of shared
+   nodes through copies. The bodies of definitions are shared instead,
+   and their symbols pushed onto deps. Children are copied left before
+   right, and a shared node is done before the walk leaves it, so that
+   later occurrences find its copy. */
+static lclex_node_t *lclex_cache_copy(lclex_cache_t *cache,
+                                      lclex_node_t *node,
+                                      lclex_hashmap_t *copies,
+                                      lclex_stack_t *deps) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    void *results_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending, results;
+    lclex_node_t *left, *right, *copy;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_init_pending(&results, results_data);
+    lclex_push_pending(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pop_pending(&pending);
+
+        if (node != NULL) {
+            copy = lclex_cache_copy_leaf(cache, node, copies, deps);
+            if (copy == NULL) {
+                lclex_push_pending(&pending, node);
+                lclex_push_pending(&pending, NULL);
+                if (node->right != NULL) {
+                    lclex_push_pending(&pending, node->right);
+                }
+                lclex_push_pending(&pending, node->left);
+                continue;
+            }
+
+            lclex_push_pending(&results, copy);
+            continue;
+        }
+
+        node = lclex_pop_pending(&pending);
+        right = node->right != NULL ? lclex_pop_pending(&results) : NULL;
+        left = lclex_pop_pending(&results);
+
+        copy = lclex_new_node(node->type, LCLEX_NO_SYMBOL, left, right);
+        copy->data = node->data;
+        copy->scope = node->scope;
+
+        if (lclex_node_refs(node) > 1) {
+            lclex_insert_hashmap(copies, node, copy);
+        }
+
+        lclex_push_pending(&results, copy);
+    }
+
+    copy = lclex_pop_pending(&results);
+    lclex_destruct_pending(&pending);
+    lclex_destruct_pending(&results);
+
+    return copy;
+}
+
+static void lclex_keep_copy(void *data) {
+    (void)data;
+}
+
+static lclex_node_t *lclex_cache_copy_term(lclex_cache_t *cache,
+                                           lclex_node_t *node,
+                                           lclex_stack_t *deps) {
+    lclex_hashmap_t copies;
+    lclex_init_pointer_hashmap(&copies, lclex_keep_copy);
+
+    lclex_arena_t *prev_arena = lclex_use_arena(&cache->arena);
+    lclex_node_t *copy = lclex_cache_copy(cache, node, &copies, deps);
+    lclex_use_arena(prev_arena);
+
+    lclex_destruct_hashmap(&copies);
+
+    return copy;
+}
+
+/* Drops the entries that used the definition named name, or a definition
+   made with it. */
+static void lclex_cache_evict(lclex_cache_t *cache, char *name) {
+    lclex_stack_t closure;
+    lclex_init_stack(&closure);
+    lclex_push_stack(&closure, (void *)(uintptr_t)lclex_intern(name));
+
+    for (size_t i = 0; i < closure.size; i++) {
+        lclex_symbol_t symbol = (uintptr_t)closure.data[i];
+        lclex_stack_t *dependents = lclex_lookup_hashmap(
+            &cache->dependents, lclex_symbol_name(symbol));
+
+        for (size_t j = 0; dependents != NULL && j < dependents->size; j++) {
+            if (!lclex_stack_contains(&closure, dependents->data[j])) {
+                lclex_push_stack(&closure, dependents->data[j]);
+            }
+        }
+    }
+
+    lclex_arena_t *prev_arena = lclex_use_arena(&cache->arena);
+
+    for (size_t i = 0; i < cache->cap; i++) {
+        lclex_cache_entry_t **pentry = &cache->data[i];
+
+        while (*pentry != NULL) {
+            lclex_cache_entry_t *entry = *pentry;
+            bool used = false;
+
+            for (size_t j = 0; j < entry->deps.size && !used; j++) {
+                used = lclex_stack_contains(&closure, entry->deps.data[j]);
+            }
+
+            if (used) {
+                *pentry = entry->next;
+                lclex_free_cache_entry(entry);
+                cache->size--;
+                cache->stats.evicted++;
+            } else {
+                pentry = &entry->next;
+            }
+        }
+    }
+
+    lclex_use_arena(prev_arena);
+    lclex_destruct_stack(&closure);
+}
+
+/* Collects the symbols of the definitions used in node, left before 
+   right. */
+static void lclex_cache_find_deps(lclex_cache_t *cache, lclex_node_t *node,
+                                  lclex_stack_t *deps) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_push_pending(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pop_pending(&pending);
+
+        lclex_symbol_t symbol = lclex_cache_root(cache, node);
+
+        if (symbol != LCLEX_NO_SYMBOL) {
+            if (!lclex_stack_contains(deps, (void *)(uintptr_t)symbol)) {
+                lclex_push_stack(deps, (void *)(uintptr_t)symbol);
+            }
+            continue;
+        }
+
+        if (node->right != NULL) {
+            lclex_push_pending(&pending, node->right);
+        }
+        if (node->left != NULL) {
+            lclex_push_pending(&pending, node->left);
+        }
+    }
+
+    lclex_destruct_pending(&pending);
+}
+
+static void lclex_cache_add_root(lclex_cache_t *cache, char *name,
+                                 lclex_node_t *node) {
+    lclex_symbol_t symbol = lclex_intern(name);
+
+    lclex_insert_hashmap(&cache->roots, node,
+                         (void *)((uintptr_t)symbol + 1));
+}
+
+/* Registers definitions made without lclex_cache_define, such as those
+   loaded from an image. */
+void lclex_cache_add_roots(lclex_cache_t *cache, lclex_hashmap_t *defs) {
+    for (size_t i = 0; i < defs->cap; i++) {
+        for (lclex_hashmap_entry_t *entry = defs->data[i]; entry != NULL;
+             entry = entry->next) {
+            lclex_cache_add_root(cache, entry->key, entry->value);
+        }
+    }
+}
+
+/* Called by the parser before *pnode is bound to name in defs, in the
+   arena of the definitions. Normalizes the definition when asked to,
+   records the definitions it uses and drops the entries built from the
+   definition it replaces. */
+void lclex_cache_define(lclex_cache_t *cache, lclex_hashmap_t *defs,
+                        char *name, lclex_node_t **pnode) {
+    lclex_node_t *old = lclex_lookup_hashmap(defs, name);
+    lclex_stack_t deps;
+
+    pthread_mutex_lock(&cache->lock);
+
+    if (old != NULL) {
+        lclex_remove_hashmap(&cache->roots, old);
+        lclex_cache_evict(cache, name);
+    }
+
+    lclex_init_stack(&deps);
+    lclex_cache_find_deps(cache, *pnode, &deps);
+
+    for (size_t i = 0; i < deps.size; i++) {
+        char *used = lclex_symbol_name((uintptr_t)deps.data[i]);
+        lclex_stack_t *dependents = lclex_lookup_hashmap(&cache->dependents,
+                                                         used);
+
+        if (dependents == NULL) {
+            dependents = malloc(sizeof(lclex_stack_t));
+            lclex_init_stack(dependents);
+            lclex_insert_hashmap(&cache->dependents, lclex_strdup(used),
+                                 dependents);
+        }
+
+        void *symbol = (void *)(uintptr_t)lclex_intern(name);
+        if (!lclex_stack_contains(dependents, symbol)) {
+            lclex_push_stack(dependents, symbol);
+        }
+    }
+
+    lclex_destruct_stack(&deps);
+
+    if (cache->normalize_defs) {
+        lclex_node_t *normal = lclex_copy_node(*pnode);
+
+        if (lclex_reduce_expression(&normal, LCLEX_CACHE_DEFINE_MAX_STEPS,
+                                    false)
+            < LCLEX_CACHE_DEFINE_MAX_STEPS) {
+            lclex_free_node(*pnode);
+            *pnode = normal;
+            cache->stats.normalized++;
+        } else {
+            lclex_free_node(normal);
+        }
+    }
+
+    lclex_cache_add_root(cache, name, *pnode);
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/* Returns the normal form of term with a reference for the caller, or
+   NULL with *pentry set to an entry for term that lclex_cache_insert
+   completes once it is reduced. */
+lclex_node_t *lclex_cache_lookup(lclex_cache_t *cache, lclex_node_t *term,
+                                 lclex_cache_entry_t **pentry) {
+    lclex_hash_t hash = lclex_cache_hash(cache, term);
+    lclex_node_t *normal = NULL;
+
+    pthread_mutex_lock(&cache->lock);
+
+    lclex_cache_entry_t *entry = cache->data[hash & (cache->cap - 1)];
+
+    while (entry != NULL && normal == NULL) {
+        if (entry->hash == hash && lclex_cache_equal(entry->term, term)) {
+            normal = entry->normal;
+            lclex_retain_node(normal);
+        }
+        entry = entry->next;
+    }
+
+    if (normal != NULL) {
+        cache->stats.hits++;
+        *pentry = NULL;
+    } else {
+        cache->stats.misses++;
+
+        entry = malloc(sizeof(lclex_cache_entry_t));
+        entry->hash = hash;
+        entry->normal = NULL;
+        entry->next = NULL;
+        lclex_init_stack(&entry->deps);
+        entry->term = lclex_cache_copy_term(cache, term, &entry->deps);
+        *pentry = entry;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return normal;
+}
+
+static void lclex_resize_cache(lclex_cache_t *cache, size_t cap) {
+    lclex_cache_entry_t **data = calloc(cap, sizeof(lclex_cache_entry_t *));
+
+    for (size_t i = 0; i < cache->cap; i++) {
+        lclex_cache_entry_t *next, *entry = cache->data[i];
+
+        while (entry != NULL) {
+            next = entry->next;
+
+            size_t idx = entry->hash & (cap - 1);
+            entry->next = data[idx];
+            data[idx] = entry;
+
+            entry = next;
+        }
+    }
+
+    free(cache->data);
+    cache->data = data;
+    cache->cap = cap;
+}
+
+/* Stores normal as the normal form of the term of entry. The entry is
+   dropped if another thread stored the same term first. */
+void lclex_cache_insert(lclex_cache_t *cache, lclex_cache_entry_t *entry,
+                        lclex_node_t *normal) {
+    pthread_mutex_lock(&cache->lock);
+
+    size_t idx = entry->hash & (cache->cap - 1);
+    lclex_cache_entry_t *other = cache->data[idx];
+
+    while (other != NULL && (other->hash != entry->hash
+                             || !lclex_cache_equal(other->term,
+                                                   entry->term))) {
+        other = other->next;
+    }
+
+    if (other != NULL) {
+        lclex_arena_t *prev_arena = lclex_use_arena(&cache->arena);
+        lclex_free_cache_entry(entry);
+        lclex_use_arena(prev_arena);
+    } else {
+        entry->normal = lclex_cache_copy_term(cache, normal, &entry->deps);
+        entry->next = cache->data[idx];
+        cache->data[idx] = entry;
+        cache->size++;
+
+        if (cache->size > LCLEX_HASHMAP_LOAD_FACTOR * cache->cap) {
+            lclex_resize_cache(cache, 2 * cache->cap);
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void lclex_cache_stats(lclex_cache_t *cache, lclex_cache_stats_t *stats) {
+    pthread_mutex_lock(&cache->lock);
+
+    *stats = cache->stats;
+    stats->entries = cache->size;
+
+    pthread_mutex_unlock(&cache->lock);
+}
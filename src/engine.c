@@ -0,0 +1,254 @@
+#include "engine.h"
+#include <string.h>
+
+char *lclex_engine_name(lclex_engine_type_t type) {
+    static char *names[] = {
+        "rewrite",
+        "hashcons",
+        "krivine",
+        "nbe",
+        "optimal",
+        "need",
+        "pool",
+        "subst"
+    };
+
+    return names[type];
+}
+
+bool lclex_parse_engine(char *name, lclex_engine_type_t *type) {
+    for (size_t i = 0; i < LCLEX_N_ENGINES; i++) {
+        if (strcmp(name, lclex_engine_name(i)) == 0) {
+            *type = i;
+            return true;
+        }
+    }
+
+    fprintf(stderr, "Error: unknown engine '%s'\n", name);
+    return false;
+}
+
+bool lclex_engine_shows_reductions(lclex_engine_type_t type) {
+    return type == LCLEX_ENGINE_REWRITE || type == LCLEX_ENGINE_HASHCONS
+           || type == LCLEX_ENGINE_POOL;
+}
+
+void lclex_init_engine(lclex_engine_t *engine, lclex_engine_type_t type,
+                       lclex_parallel_t *parallel) {
+    engine->type = type;
+    engine->parallel = parallel;
+    engine->steps = 0;
+
+    switch (type) {
+        case LCLEX_ENGINE_REWRITE:
+            break;
+
+        case LCLEX_ENGINE_HASHCONS:
+            lclex_init_hashcons(&engine->data.hashcons);
+            break;
+
+        case LCLEX_ENGINE_KRIVINE:
+            lclex_init_krivine(&engine->data.krivine);
+            break;
+
+        case LCLEX_ENGINE_NBE:
+            lclex_init_nbe(&engine->data.nbe);
+            break;
+
+        case LCLEX_ENGINE_OPTIMAL:
+            lclex_init_inet(&engine->data.optimal);
+            break;
+
+        case LCLEX_ENGINE_NEED:
+            lclex_init_need(&engine->data.need);
+            break;
+
+        case LCLEX_ENGINE_POOL:
+            lclex_init_pool(&engine->data.pool);
+            break;
+
+        case LCLEX_ENGINE_SUBST:
+            lclex_init_subst(&engine->data.subst);
+            break;
+
+        case LCLEX_N_ENGINES:
+            break;
+    }
+}
+
+void lclex_destruct_engine(lclex_engine_t *engine) {
+    switch (engine->type) {
+        case LCLEX_ENGINE_REWRITE:
+            break;
+
+        case LCLEX_ENGINE_HASHCONS:
+            lclex_destruct_hashcons(&engine->data.hashcons);
+            break;
+
+        case LCLEX_ENGINE_KRIVINE:
+            lclex_destruct_krivine(&engine->data.krivine);
+            break;
+
+        case LCLEX_ENGINE_NBE:
+            lclex_destruct_nbe(&engine->data.nbe);
+            break;
+
+        case LCLEX_ENGINE_OPTIMAL:
+            lclex_destruct_inet(&engine->data.optimal);
+            break;
+
+        case LCLEX_ENGINE_NEED:
+            lclex_destruct_need(&engine->data.need);
+            break;
+
+        case LCLEX_ENGINE_POOL:
+            lclex_destruct_pool(&engine->data.pool);
+            break;
+
+        case LCLEX_ENGINE_SUBST:
+            lclex_destruct_subst(&engine->data.subst);
+            break;
+
+        case LCLEX_N_ENGINES:
+            break;
+    }
+}
+
+void lclex_engine_reduce(lclex_engine_t *engine, lclex_node_t **pexpr, 
+                         uint64_t max, bool show_reductions) {
+    lclex_node_t *tree;
+
+    switch (engine->type) {
+        case LCLEX_ENGINE_REWRITE:
+            /* Steps are only counted and shown in order sequentially. The
+               workers are then left alone, along with the statistics of 
+               their last reduction. */
+            if (engine->parallel != NULL && max == UINT64_MAX 
+                && !show_reductions) {
+                lclex_parallel_reduce_expression(engine->parallel, pexpr);
+
+                for (size_t i = 0; i < engine->parallel->n_workers; i++) {
+                    engine->steps += engine->parallel->workers[i].stats.steps;
+                }
+            } else {
+                engine->parallel = NULL;
+                engine->steps = lclex_reduce_expression(pexpr, max, 
+                                                        show_reductions);
+            }
+            break;
+
+        case LCLEX_ENGINE_HASHCONS:
+            tree = *pexpr;
+            *pexpr = lclex_hashcons_node(&engine->data.hashcons, tree);
+            lclex_free_node(tree);
+
+            lclex_hashcons_reduce_expression(&engine->data.hashcons, pexpr, 
+                                             max, show_reductions);
+            break;
+
+        case LCLEX_ENGINE_KRIVINE:
+            lclex_krivine_reduce_expression(&engine->data.krivine, pexpr);
+            break;
+
+        case LCLEX_ENGINE_NBE:
+            lclex_nbe_reduce_expression(&engine->data.nbe, pexpr);
+            break;
+
+        case LCLEX_ENGINE_OPTIMAL:
+            lclex_inet_reduce_expression(&engine->data.optimal, pexpr);
+            break;
+
+        case LCLEX_ENGINE_NEED:
+            lclex_need_reduce_expression(&engine->data.need, pexpr);
+            break;
+
+        case LCLEX_ENGINE_POOL:
+            lclex_pool_reduce_expression(&engine->data.pool, pexpr, max,
+                                         show_reductions);
+            break;
+
+        case LCLEX_ENGINE_SUBST:
+            lclex_subst_reduce_expression(&engine->data.subst, pexpr);
+            break;
+
+        case LCLEX_N_ENGINES:
+            break;
+    }
+}
+
+uint64_t lclex_engine_steps(lclex_engine_t *engine) {
+    switch (engine->type) {
+        case LCLEX_ENGINE_REWRITE:
+            return engine->steps;
+
+        case LCLEX_ENGINE_HASHCONS:
+            return engine->data.hashcons.stats.betas;
+
+        case LCLEX_ENGINE_KRIVINE:
+            return engine->data.krivine.stats.steps;
+
+        case LCLEX_ENGINE_NBE:
+            return engine->data.nbe.stats.betas;
+
+        case LCLEX_ENGINE_OPTIMAL:
+            return engine->data.optimal.stats.betas;
+
+        case LCLEX_ENGINE_NEED:
+            return engine->data.need.stats.betas;
+
+        case LCLEX_ENGINE_POOL:
+            return engine->data.pool.stats.steps;
+
+        case LCLEX_ENGINE_SUBST:
+            return engine->data.subst.stats.steps;
+
+        case LCLEX_N_ENGINES:
+            break;
+    }
+
+    return 0;
+}
+
+void lclex_write_engine_stats(lclex_engine_t *engine, lclex_node_t *expr, 
+                              FILE *stream) {
+    switch (engine->type) {
+        case LCLEX_ENGINE_REWRITE:
+            if (engine->parallel != NULL) {
+                lclex_write_parallel_stats(engine->parallel, stream);
+            } else {
+                fprintf(stream, "> rewrite: %ld steps\n", engine->steps);
+            }
+            break;
+
+        case LCLEX_ENGINE_HASHCONS:
+            lclex_write_hashcons_stats(&engine->data.hashcons, expr, stream);
+            break;
+
+        case LCLEX_ENGINE_KRIVINE:
+            lclex_write_krivine_stats(&engine->data.krivine, stream);
+            break;
+
+        case LCLEX_ENGINE_NBE:
+            lclex_write_nbe_stats(&engine->data.nbe, stream);
+            break;
+
+        case LCLEX_ENGINE_OPTIMAL:
+            lclex_write_inet_stats(&engine->data.optimal, stream);
+            break;
+
+        case LCLEX_ENGINE_NEED:
+            lclex_write_need_stats(&engine->data.need, stream);
+            break;
+
+        case LCLEX_ENGINE_POOL:
+            lclex_write_pool_stats(&engine->data.pool, stream);
+            break;
+
+        case LCLEX_ENGINE_SUBST:
+            lclex_write_subst_stats(&engine->data.subst, stream);
+            break;
+
+        case LCLEX_N_ENGINES:
+            break;
+    }
+}
@@ -0,0 +1,831 @@
+#include "hashcons.h"
+#include <stdlib.h>
+#include <string.h>
+
+static lclex_hash_t lclex_mix_hash(lclex_hash_t hash, uint64_t value) {
+    hash ^= value + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+    hash ^= hash >> 31;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 27;
+
+    return hash;
+}
+
+static lclex_hash_t lclex_hash_memo_key(lclex_node_t *key,
+                                        uint64_t a, uint64_t b) {
+    lclex_hash_t hash = lclex_mix_hash((uintptr_t)key, a);
+    return lclex_mix_hash(hash, b);
+}
+
+void lclex_init_memo(lclex_memo_t *memo) {
+    memo->data = calloc(LCLEX_HASHCONS_INIT_SIZE, sizeof(lclex_memo_entry_t));
+    memo->size = 0;
+    memo->cap = LCLEX_HASHCONS_INIT_SIZE;
+    memo->gen = 1;
+}
+
+void lclex_destruct_memo(lclex_memo_t *memo) {
+    free(memo->data);
+}
+
+void lclex_clear_memo(lclex_memo_t *memo) {
+    memo->size = 0;
+    memo->gen++;
+}
+
+lclex_node_t *lclex_lookup_memo(lclex_memo_t *memo, lclex_node_t *key,
+                                uint64_t a, uint64_t b) {
+    size_t mask = memo->cap - 1;
+    size_t idx = lclex_hash_memo_key(key, a, b) & mask;
+
+    while (memo->data[idx].gen == memo->gen) {
+        lclex_memo_entry_t *entry = &memo->data[idx];
+        if (entry->key == key && entry->a == a && entry->b == b) {
+            return entry->value;
+        }
+        idx = (idx + 1) & mask;
+    }
+
+    return NULL;
+}
+
+static void lclex_resize_memo(lclex_memo_t *memo) {
+    lclex_memo_entry_t *old = memo->data;
+    size_t old_cap = memo->cap;
+    uint64_t old_gen = memo->gen;
+
+    memo->cap *= 2;
+    memo->data = calloc(memo->cap, sizeof(lclex_memo_entry_t));
+    memo->size = 0;
+    memo->gen = 1;
+
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].gen == old_gen) {
+            lclex_insert_memo(memo, old[i].key, old[i].a, old[i].b,
+                              old[i].value);
+        }
+    }
+
+    free(old);
+}
+
+void lclex_insert_memo(lclex_memo_t *memo, lclex_node_t *key,
+                       uint64_t a, uint64_t b, lclex_node_t *value) {
+    size_t mask = memo->cap - 1;
+    size_t idx = lclex_hash_memo_key(key, a, b) & mask;
+
+    while (memo->data[idx].gen == memo->gen) {
+        lclex_memo_entry_t *entry = &memo->data[idx];
+        if (entry->key == key && entry->a == a && entry->b == b) {
+            entry->value = value;
+            return;
+        }
+        idx = (idx + 1) & mask;
+    }
+
+    memo->data[idx].key = key;
+    memo->data[idx].a = a;
+    memo->data[idx].b = b;
+    memo->data[idx].gen = memo->gen;
+    memo->data[idx].value = value;
+    memo->size++;
+
+    if (memo->size > LCLEX_HASHMAP_LOAD_FACTOR * memo->cap) {
+        lclex_resize_memo(memo);
+    }
+}
+
+void lclex_init_hashcons(lclex_hashcons_t *table) {
+    table->data = calloc(LCLEX_HASHCONS_INIT_SIZE, sizeof(lclex_node_t *));
+    table->size = 0;
+    table->cap = LCLEX_HASHCONS_INIT_SIZE;
+    table->gc_threshold = LCLEX_HASHCONS_GC_MIN;
+
+    lclex_init_memo(&table->steps);
+    lclex_init_memo(&table->subst);
+    lclex_init_memo(&table->shift);
+
+    memset(&table->stats, 0, sizeof(lclex_hashcons_stats_t));
+}
+
+void lclex_destruct_hashcons(lclex_hashcons_t *table) {
+    free(table->data);
+
+    lclex_destruct_memo(&table->steps);
+    lclex_destruct_memo(&table->subst);
+    lclex_destruct_memo(&table->shift);
+}
+
+/* The payload of a node as passed to lclex_cons_node: its symbol, de 
+   Bruijn index, number or primitive, and 0 for applications. */
+static uint64_t lclex_node_payload(lclex_node_t *node) {
+    switch (node->type) {
+        case LCLEX_ABSTRACTION:
+        case LCLEX_FREE_VARIABLE:
+            return node->data.symbol;
+
+        case LCLEX_BOUND_VARIABLE:
+            return node->data.index;
+
+        case LCLEX_NUMERAL:
+            return node->data.number;
+
+        case LCLEX_PRIMITIVE:
+            return node->data.primitive;
+
+        case LCLEX_APPLICATION:
+            break;
+    }
+
+    return 0;
+}
+
+lclex_hash_t lclex_hash_node_fields(lclex_type_t type, uint64_t data,
+                                    lclex_node_t *left, lclex_node_t *right) {
+    lclex_hash_t hash = lclex_mix_hash(0, type);
+
+    switch (type) {
+        case LCLEX_APPLICATION:
+            hash = lclex_mix_hash(hash, (uintptr_t)right);
+            hash = lclex_mix_hash(hash, (uintptr_t)left);
+            break;
+
+        case LCLEX_ABSTRACTION:
+            hash = lclex_mix_hash(hash, data);
+            hash = lclex_mix_hash(hash, (uintptr_t)left);
+            break;
+
+        case LCLEX_FREE_VARIABLE:
+        case LCLEX_BOUND_VARIABLE:
+        case LCLEX_NUMERAL:
+        case LCLEX_PRIMITIVE:
+            hash = lclex_mix_hash(hash, data);
+            break;
+    }
+
+    return hash;
+}
+
+static bool lclex_equal_node_fields(lclex_node_t *node, lclex_type_t type,
+                                    uint64_t data, lclex_node_t *left,
+                                    lclex_node_t *right) {
+    if (node->type != type) {
+        return false;
+    }
+
+    switch (type) {
+        case LCLEX_APPLICATION:
+            return node->left == left && node->right == right;
+
+        case LCLEX_ABSTRACTION:
+            return node->left == left && node->data.symbol == data;
+
+        case LCLEX_FREE_VARIABLE:
+        case LCLEX_BOUND_VARIABLE:
+        case LCLEX_NUMERAL:
+        case LCLEX_PRIMITIVE:
+            return lclex_node_payload(node) == data;
+    }
+
+    return false;
+}
+
+static void lclex_place_hashcons(lclex_node_t **data, size_t cap,
+                                 lclex_node_t *node) {
+    size_t mask = cap - 1;
+    size_t idx = lclex_hash_node_fields(node->type, lclex_node_payload(node),
+                                        node->left, node->right) & mask;
+
+    while (data[idx] != NULL) {
+        idx = (idx + 1) & mask;
+    }
+    data[idx] = node;
+}
+
+static void lclex_resize_hashcons(lclex_hashcons_t *table, size_t cap) {
+    lclex_node_t **data = calloc(cap, sizeof(lclex_node_t *));
+
+    for (size_t i = 0; i < table->cap; i++) {
+        if (table->data[i] != NULL) {
+            lclex_place_hashcons(data, cap, table->data[i]);
+        }
+    }
+
+    free(table->data);
+    table->data = data;
+    table->cap = cap;
+}
+
+lclex_node_t *lclex_cons_node(lclex_hashcons_t *table, lclex_type_t type,
+                              uint64_t data, lclex_node_t *left,
+                              lclex_node_t *right) {
+    size_t mask = table->cap - 1;
+    size_t idx = lclex_hash_node_fields(type, data, left, right) & mask;
+
+    table->stats.requested++;
+
+    while (table->data[idx] != NULL) {
+        lclex_node_t *node = table->data[idx];
+        if (lclex_equal_node_fields(node, type, data, left, right)) {
+            return node;
+        }
+        idx = (idx + 1) & mask;
+    }
+
+    lclex_node_t *node = lclex_new_node(type, LCLEX_NO_SYMBOL, left, right);
+
+    switch (type) {
+        case LCLEX_ABSTRACTION:
+        case LCLEX_FREE_VARIABLE:
+            node->data.symbol = data;
+            break;
+
+        case LCLEX_BOUND_VARIABLE:
+            node->data.index = data;
+            lclex_update_scope(node);
+            break;
+
+        case LCLEX_NUMERAL:
+            node->data.number = data;
+            break;
+
+        case LCLEX_PRIMITIVE:
+            node->data.primitive = data;
+            break;
+
+        case LCLEX_APPLICATION:
+            break;
+    }
+    table->data[idx] = node;
+    table->size++;
+    table->stats.unique++;
+
+    if (table->size > LCLEX_HASHMAP_LOAD_FACTOR * table->cap) {
+        lclex_resize_hashcons(table, 2 * table->cap);
+    }
+
+    return node;
+}
+
+/* The traversals below keep what they have left to visit on a pending 
+   stack, as terms can be deeper than the call stack allows. A node whose
+   result is built from those of its children is pushed again behind a
+   NULL, and the results wait on a second stack until it is popped. */
+
+lclex_node_t *lclex_hashcons_node(lclex_hashcons_t *table,
+                                  lclex_node_t *node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    void *results_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending, results;
+    lclex_node_t *left, *right, *tree, *result;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_init_pending(&results, results_data);
+    lclex_push_pending(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pop_pending(&pending);
+        left = right = NULL;
+
+        if (node == NULL) {
+            node = lclex_pop_pending(&pending);
+            left = lclex_pop_pending(&results);
+            if (node->type == LCLEX_APPLICATION) {
+                right = lclex_pop_pending(&results);
+            }
+        } else if (node->type == LCLEX_APPLICATION 
+                   || node->type == LCLEX_ABSTRACTION) {
+            lclex_push_pending(&pending, node);
+            lclex_push_pending(&pending, NULL);
+            lclex_push_pending(&pending, node->left);
+            if (node->type == LCLEX_APPLICATION) {
+                lclex_push_pending(&pending, node->right);
+            }
+            continue;
+        } else if (node->type == LCLEX_NUMERAL 
+                   || node->type == LCLEX_PRIMITIVE) {
+            /* Reduction only knows about plain terms, so numerals and 
+               primitives are expanded when the term enters the table.
+               Their expansions have none of their own. */
+            tree = lclex_expand_node(node);
+            lclex_push_pending(&results, lclex_hashcons_node(table, tree));
+            lclex_free_node(tree);
+            continue;
+        }
+
+        result = lclex_cons_node(table, node->type, lclex_node_payload(node),
+                                 left, right);
+        lclex_push_pending(&results, result);
+    }
+
+    result = lclex_pop_pending(&results);
+    lclex_destruct_pending(&pending);
+    lclex_destruct_pending(&results);
+
+    return result;
+}
+
+/* The result of shift, or of subst when arg is not NULL, for a node 
+   without children. */
+static lclex_node_t *lclex_rebuild_leaf(lclex_hashcons_t *table,
+                                        lclex_node_t *node, uint64_t shift,
+                                        lclex_node_t *arg,
+                                        lclex_bruijn_index_t index) {
+    if (node->type != LCLEX_BOUND_VARIABLE || node->data.index < index) {
+        return node;
+    }
+
+    if (arg == NULL) {
+        return lclex_cons_node(table, LCLEX_BOUND_VARIABLE,
+                               node->data.index + shift, NULL, NULL);
+    }
+
+    if (node->data.index == index) {
+        return index == 0 ? arg : lclex_hashcons_shift(table, arg, index, 0);
+    }
+
+    return lclex_cons_node(table, LCLEX_BOUND_VARIABLE,
+                           node->data.index - 1, NULL, NULL);
+}
+
+/* Rebuilds node with its free indices from index on shifted, or with 
+   index substituted by arg when arg is not NULL, memoizing the result of
+   every subterm. Nodes are pushed with the index they are under. */
+static lclex_node_t *lclex_hashcons_rebuild(lclex_hashcons_t *table,
+                                            lclex_node_t *node,
+                                            uint64_t shift, 
+                                            lclex_node_t *arg,
+                                            lclex_bruijn_index_t index) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    void *results_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending, results;
+    lclex_memo_t *memo = arg == NULL ? &table->shift : &table->subst;
+    lclex_node_t *left, *right, *result;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_init_pending(&results, results_data);
+    lclex_push_pending(&pending, (void *)(uintptr_t)index);
+    lclex_push_pending(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pop_pending(&pending);
+
+        if (node == NULL) {
+            node = lclex_pop_pending(&pending);
+            index = (uintptr_t)lclex_pop_pending(&pending);
+
+            if (node->type == LCLEX_APPLICATION) {
+                left = lclex_pop_pending(&results);
+                right = lclex_pop_pending(&results);
+                result = lclex_cons_node(table, LCLEX_APPLICATION, 0,
+                                         left, right);
+            } else {
+                left = lclex_pop_pending(&results);
+                result = lclex_cons_node(table, LCLEX_ABSTRACTION,
+                                         node->data.symbol, left, NULL);
+            }
+        } else {
+            index = (uintptr_t)lclex_pop_pending(&pending);
+            result = arg == NULL
+                     ? lclex_lookup_memo(memo, node, shift, index)
+                     : lclex_lookup_memo(memo, node, index, 0);
+
+            if (result != NULL) {
+                lclex_push_pending(&results, result);
+                continue;
+            }
+
+            if (node->type == LCLEX_APPLICATION) {
+                lclex_push_pending(&pending, (void *)(uintptr_t)index);
+                lclex_push_pending(&pending, node);
+                lclex_push_pending(&pending, NULL);
+                lclex_push_pending(&pending, (void *)(uintptr_t)index);
+                lclex_push_pending(&pending, node->left);
+                lclex_push_pending(&pending, (void *)(uintptr_t)index);
+                lclex_push_pending(&pending, node->right);
+                continue;
+            }
+
+            if (node->type == LCLEX_ABSTRACTION) {
+                lclex_push_pending(&pending, (void *)(uintptr_t)index);
+                lclex_push_pending(&pending, node);
+                lclex_push_pending(&pending, NULL);
+                lclex_push_pending(&pending, (void *)(uintptr_t)(index + 1));
+                lclex_push_pending(&pending, node->left);
+                continue;
+            }
+
+            result = lclex_rebuild_leaf(table, node, shift, arg, index);
+        }
+
+        if (arg == NULL) {
+            lclex_insert_memo(memo, node, shift, index, result);
+        } else {
+            lclex_insert_memo(memo, node, index, 0, result);
+        }
+        lclex_push_pending(&results, result);
+    }
+
+    result = lclex_pop_pending(&results);
+    lclex_destruct_pending(&pending);
+    lclex_destruct_pending(&results);
+
+    return result;
+}
+
+lclex_node_t *lclex_hashcons_shift(lclex_hashcons_t *table,
+                                   lclex_node_t *node, uint64_t shift,
+                                   lclex_bruijn_index_t index) {
+    return lclex_hashcons_rebuild(table, node, shift, NULL, index);
+}
+
+lclex_node_t *lclex_hashcons_subst(lclex_hashcons_t *table,
+                                   lclex_node_t *node, lclex_node_t *arg,
+                                   lclex_bruijn_index_t index) {
+    return lclex_hashcons_rebuild(table, node, 0, arg, index);
+}
+
+/* A node whose children are being stepped waits on the stack with the 
+   child it is at, 0 for the left one and 1 for the right one. */
+lclex_node_t *lclex_hashcons_step(lclex_hashcons_t *table,
+                                  lclex_node_t *node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    lclex_node_t *parent, *result;
+    uintptr_t child;
+
+    lclex_init_pending(&pending, pending_data);
+
+    while (true) {
+        result = lclex_lookup_memo(&table->steps, node, LCLEX_MEMO_STEP, 0);
+
+        if (result == NULL) {
+            if (node->type == LCLEX_APPLICATION 
+                && node->left->type == LCLEX_ABSTRACTION) {
+                lclex_clear_memo(&table->subst);
+
+                result = lclex_hashcons_subst(table, node->left->left,
+                                              node->right, 0);
+                table->stats.betas++;
+            } else if (node->type == LCLEX_APPLICATION
+                       || node->type == LCLEX_ABSTRACTION) {
+                lclex_push_pending(&pending, node);
+                lclex_push_pending(&pending, (void *)0);
+                node = node->left;
+                continue;
+            } else {
+                result = node;
+            }
+
+            lclex_insert_memo(&table->steps, node, LCLEX_MEMO_STEP, 0, 
+                              result);
+        }
+
+        /* Passes result up to the nodes waiting for it, until one of
+           them has its right child left to step. */
+        while (pending.size > 0) {
+            child = (uintptr_t)lclex_pop_pending(&pending);
+            parent = lclex_pop_pending(&pending);
+
+            if (child == 0 && result != parent->left) {
+                result = parent->type == LCLEX_APPLICATION
+                         ? lclex_cons_node(table, LCLEX_APPLICATION, 0,
+                                           result, parent->right)
+                         : lclex_cons_node(table, LCLEX_ABSTRACTION,
+                                           parent->data.symbol, result, 
+                                           NULL);
+            } else if (child == 0 && parent->type == LCLEX_APPLICATION) {
+                lclex_push_pending(&pending, parent);
+                lclex_push_pending(&pending, (void *)1);
+                break;
+            } else if (child == 1 && result != parent->right) {
+                result = lclex_cons_node(table, LCLEX_APPLICATION, 0,
+                                         parent->left, result);
+            } else {
+                result = parent;
+            }
+
+            lclex_insert_memo(&table->steps, parent, LCLEX_MEMO_STEP, 0, 
+                              result);
+        }
+
+        if (pending.size == 0) {
+            break;
+        }
+        node = ((lclex_node_t *)pending.data[pending.size - 2])->right;
+    }
+
+    lclex_destruct_pending(&pending);
+
+    return result;
+}
+
+static void lclex_mark_hashcons(lclex_memo_t *marks, lclex_node_t *node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_push_pending(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pop_pending(&pending);
+
+        if (lclex_lookup_memo(marks, node, 0, 0) != NULL) {
+            continue;
+        }
+        lclex_insert_memo(marks, node, 0, 0, node);
+
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                lclex_push_pending(&pending, node->right);
+
+                __attribute__((fallthrough));
+            case LCLEX_ABSTRACTION:
+                lclex_push_pending(&pending, node->left);
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                break;
+        }
+    }
+
+    lclex_destruct_pending(&pending);
+}
+
+void lclex_collect_hashcons(lclex_hashcons_t *table, lclex_node_t *root) {
+    lclex_memo_t marks;
+    lclex_init_memo(&marks);
+    lclex_mark_hashcons(&marks, root);
+
+    lclex_node_t **data = calloc(table->cap, sizeof(lclex_node_t *));
+    size_t size = 0;
+
+    for (size_t i = 0; i < table->cap; i++) {
+        lclex_node_t *node = table->data[i];
+        if (node == NULL) {
+            continue;
+        }
+
+        if (lclex_lookup_memo(&marks, node, 0, 0) != NULL) {
+            lclex_place_hashcons(data, table->cap, node);
+            size++;
+        } else {
+            lclex_arena_free_node(lclex_current_arena, node);
+            table->stats.collected++;
+        }
+    }
+
+    free(table->data);
+    table->data = data;
+    table->size = size;
+    table->stats.collections++;
+
+    if (2 * size > LCLEX_HASHCONS_GC_MIN) {
+        table->gc_threshold = 2 * size;
+    } else {
+        table->gc_threshold = LCLEX_HASHCONS_GC_MIN;
+    }
+
+    lclex_clear_memo(&table->steps);
+    lclex_clear_memo(&table->subst);
+    lclex_clear_memo(&table->shift);
+    lclex_destruct_memo(&marks);
+}
+
+/* Reduces the head of node, evaluating the heads of applications first.
+   An application whose head is being reduced waits on the stack with the
+   node its result is memoized for. */
+lclex_node_t *lclex_hashcons_whnf(lclex_hashcons_t *table,
+                                  lclex_node_t *node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    lclex_node_t *result, *app, *head;
+
+    lclex_init_pending(&pending, pending_data);
+
+    while (true) {
+        result = lclex_lookup_memo(&table->steps, node, LCLEX_MEMO_WHNF, 0);
+
+        if (result == NULL && node->type == LCLEX_APPLICATION) {
+            lclex_push_pending(&pending, node);
+            lclex_push_pending(&pending, node);
+            node = node->left;
+            continue;
+        }
+
+        if (result == NULL) {
+            result = node;
+            lclex_insert_memo(&table->steps, node, LCLEX_MEMO_WHNF, 0, 
+                              result);
+        }
+
+        /* result is the head of the application on top of the stack. */
+        while (pending.size > 0) {
+            head = result;
+            app = lclex_pop_pending(&pending);
+
+            if (head->type != LCLEX_ABSTRACTION) {
+                result = lclex_cons_node(table, LCLEX_APPLICATION, 0,
+                                         head, app->right);
+            } else {
+                lclex_clear_memo(&table->subst);
+                result = lclex_hashcons_subst(table, head->left, app->right,
+                                              0);
+                table->stats.betas++;
+
+                if (result->type == LCLEX_APPLICATION) {
+                    lclex_push_pending(&pending, result);
+                    break;
+                }
+            }
+
+            node = lclex_pop_pending(&pending);
+            lclex_insert_memo(&table->steps, node, LCLEX_MEMO_WHNF, 0, 
+                              result);
+        }
+
+        if (pending.size == 0) {
+            break;
+        }
+        node = result->left;
+    }
+
+    lclex_destruct_pending(&pending);
+
+    return result;
+}
+
+lclex_node_t *lclex_hashcons_normalize(lclex_hashcons_t *table,
+                                       lclex_node_t *node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    void *results_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending, results;
+    lclex_node_t *whnf, *left, *right, *result;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_init_pending(&results, results_data);
+    lclex_push_pending(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pop_pending(&pending);
+
+        if (node == NULL) {
+            whnf = lclex_pop_pending(&pending);
+            node = lclex_pop_pending(&pending);
+
+            if (whnf->type == LCLEX_APPLICATION) {
+                right = lclex_pop_pending(&results);
+                left = lclex_pop_pending(&results);
+                result = lclex_cons_node(table, LCLEX_APPLICATION, 0,
+                                         left, right);
+            } else {
+                left = lclex_pop_pending(&results);
+                result = lclex_cons_node(table, LCLEX_ABSTRACTION,
+                                         whnf->data.symbol, left, NULL);
+            }
+        } else {
+            result = lclex_lookup_memo(&table->steps, node, 
+                                       LCLEX_MEMO_NORMAL, 0);
+            if (result != NULL) {
+                lclex_push_pending(&results, result);
+                continue;
+            }
+
+            whnf = lclex_hashcons_whnf(table, node);
+
+            if (whnf->type == LCLEX_APPLICATION
+                || whnf->type == LCLEX_ABSTRACTION) {
+                lclex_push_pending(&pending, node);
+                lclex_push_pending(&pending, whnf);
+                lclex_push_pending(&pending, NULL);
+                if (whnf->type == LCLEX_APPLICATION) {
+                    lclex_push_pending(&pending, whnf->right);
+                }
+                lclex_push_pending(&pending, whnf->left);
+                continue;
+            }
+
+            result = whnf;
+        }
+
+        lclex_insert_memo(&table->steps, node, LCLEX_MEMO_NORMAL, 0, result);
+        lclex_push_pending(&results, result);
+    }
+
+    result = lclex_pop_pending(&results);
+    lclex_destruct_pending(&pending);
+    lclex_destruct_pending(&results);
+
+    return result;
+}
+
+void lclex_hashcons_reduce_expression(lclex_hashcons_t *table,
+                                      lclex_node_t **pexpr, uint64_t max,
+                                      bool show_reductions) {
+    lclex_node_t *next, *expr = *pexpr;
+    uint64_t count = 0;
+
+    /* Without a trace or step limit, the memoized big-step normalizer
+       reaches the same normal form without rebuilding the path to every
+       redex. */
+    if (!show_reductions && max == UINT64_MAX) {
+        *pexpr = lclex_hashcons_normalize(table, expr);
+        return;
+    }
+
+    while (count < max && (next = lclex_hashcons_step(table, expr)) != expr) {
+        expr = next;
+        count++;
+
+        if (show_reductions) {
+            printf("%ld: ", count);
+            lclex_write_node(expr, stdout);
+        }
+
+        if (table->size > table->gc_threshold) {
+            lclex_collect_hashcons(table, expr);
+        }
+    }
+
+    *pexpr = expr;
+}
+
+uint64_t lclex_tree_size(lclex_memo_t *memo, lclex_node_t *root) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    lclex_node_t *node;
+    uint64_t size;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_push_pending(&pending, root);
+
+    /* A node is pushed again behind a NULL until the sizes of its 
+       children are in the memo. */
+    while (pending.size > 0) {
+        node = lclex_pop_pending(&pending);
+
+        if (node == NULL) {
+            node = lclex_pop_pending(&pending);
+            size = 1 + (uint64_t)lclex_lookup_memo(memo, node->left, 0, 0);
+            if (node->type == LCLEX_APPLICATION) {
+                size += (uint64_t)lclex_lookup_memo(memo, node->right, 0, 0);
+            }
+            lclex_insert_memo(memo, node, 0, 0, (lclex_node_t *)size);
+            continue;
+        }
+
+        if (lclex_lookup_memo(memo, node, 0, 0) != NULL) {
+            continue;
+        }
+
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                lclex_push_pending(&pending, node);
+                lclex_push_pending(&pending, NULL);
+                lclex_push_pending(&pending, node->right);
+                lclex_push_pending(&pending, node->left);
+                break;
+
+            case LCLEX_ABSTRACTION:
+                lclex_push_pending(&pending, node);
+                lclex_push_pending(&pending, NULL);
+                lclex_push_pending(&pending, node->left);
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                lclex_insert_memo(memo, node, 0, 0, (lclex_node_t *)1);
+                break;
+        }
+    }
+
+    lclex_destruct_pending(&pending);
+
+    return (uint64_t)lclex_lookup_memo(memo, root, 0, 0);
+}
+
+void lclex_write_hashcons_stats(lclex_hashcons_t *table, lclex_node_t *expr,
+                                FILE *stream) {
+    lclex_memo_t memo;
+    lclex_init_memo(&memo);
+
+    uint64_t tree_size = lclex_tree_size(&memo, expr);
+    uint64_t shared_size = memo.size;
+
+    lclex_destruct_memo(&memo);
+
+    double dedup = table->stats.unique == 0 ? 1.0
+                   : (double)table->stats.requested / table->stats.unique;
+
+    fprintf(stream, "> hashcons: %ld betas, %ld requested, %ld unique, "
+            "%.2fx dedup, %ld collected in %ld collections\n",
+            table->stats.betas, table->stats.requested, table->stats.unique, 
+            dedup, table->stats.collected, table->stats.collections);
+    fprintf(stream, "> result: %ld tree nodes in %ld shared nodes\n",
+            tree_size, shared_size);
+}
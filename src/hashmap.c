@@ -3,9 +3,27 @@
 #include <string.h>
 
 lclex_hash_t lclex_hash_string(void *data) {
-    (void)data;
+    unsigned char *p = data;
+    lclex_hash_t hash = 14695981039346656037ULL;
 
-    lclex_hash_t hash = 42;
+    while (*p != '\0') {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+        p++;
+    }
+
+    return hash;
+}
+
+/* Same as lclex_hash_string for the len characters at data. */
+lclex_hash_t lclex_hash_bytes(void *data, size_t len) {
+    unsigned char *p = data;
+    lclex_hash_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
 
     return hash;
 }
@@ -14,17 +32,41 @@ bool lclex_equal_string(void *left, void *right) {
     return strcmp(left, right) == 0;
 }
 
+lclex_hash_t lclex_hash_pointer(void *data) {
+    lclex_hash_t hash = (uintptr_t)data * 11400714819323198485ULL;
+
+    return hash ^ (hash >> 32);
+}
+
+bool lclex_equal_pointer(void *left, void *right) {
+    return left == right;
+}
+
+static void lclex_keep_key(void *key) {
+    (void)key;
+}
+
 void lclex_init_string_hashmap(lclex_hashmap_t *map, 
                                lclex_free_function_t value_free_func) {
     map->hash_func = lclex_hash_string;
     map->equal_func = lclex_equal_string;
     map->key_free_func = free;
     map->value_free_func = value_free_func;
+    map->size = 0;
     map->cap = LCLEX_HASHMAP_INIT_SIZE;
     map->data = calloc(LCLEX_HASHMAP_INIT_SIZE, 
                        sizeof(lclex_hashmap_entry_t *));
 }
 
+/* Keys are compared by address and are not owned by the map. */
+void lclex_init_pointer_hashmap(lclex_hashmap_t *map,
+                                lclex_free_function_t value_free_func) {
+    lclex_init_string_hashmap(map, value_free_func);
+    map->hash_func = lclex_hash_pointer;
+    map->equal_func = lclex_equal_pointer;
+    map->key_free_func = lclex_keep_key;
+}
+
 lclex_hashmap_entry_t *lclex_new_hashmap_entry(void *key, void *value, 
                                                lclex_hash_t hash, 
                                                lclex_hashmap_entry_t *next) {
@@ -55,9 +97,32 @@ void lclex_destruct_hashmap(lclex_hashmap_t *map) {
     free(map->data);
 }
 
+void lclex_resize_hashmap(lclex_hashmap_t *map, size_t cap) {
+    lclex_hashmap_entry_t **data = calloc(cap, 
+                                          sizeof(lclex_hashmap_entry_t *));
+
+    for (size_t i = 0; i < map->cap; i++) {
+        lclex_hashmap_entry_t *next, *entry = map->data[i];
+
+        while (entry != NULL) {
+            next = entry->next;
+
+            size_t idx = entry->hash & (cap - 1);
+            entry->next = data[idx];
+            data[idx] = entry;
+
+            entry = next;
+        }
+    }
+
+    free(map->data);
+    map->data = data;
+    map->cap = cap;
+}
+
 void *lclex_lookup_hashmap(lclex_hashmap_t *map, void *key) {
     lclex_hash_t hash = map->hash_func(key);
-    size_t idx = hash % map->cap;
+    size_t idx = hash & (map->cap - 1);
 
     lclex_hashmap_entry_t *entry = map->data[idx];
     void *value = NULL;
@@ -75,8 +140,47 @@ void *lclex_lookup_hashmap(lclex_hashmap_t *map, void *key) {
 
 void lclex_insert_hashmap(lclex_hashmap_t *map, void *key, void *value) {
     lclex_hash_t hash = map->hash_func(key);
-    size_t idx = hash % map->cap;
+    size_t idx = hash & (map->cap - 1);
+
+    lclex_hashmap_entry_t *entry = map->data[idx];
+
+    while (entry != NULL) {
+        if (entry->hash == hash && map->equal_func(entry->key, key)) {
+            map->key_free_func(key);
+            map->value_free_func(entry->value);
+            entry->value = value;
+
+            return;
+        }
+        entry = entry->next;
+    }
 
-    /* TODO: lookup and free / replace */
     map->data[idx] = lclex_new_hashmap_entry(key, value, hash, map->data[idx]);
+    map->size++;
+
+    if (map->size > LCLEX_HASHMAP_LOAD_FACTOR * map->cap) {
+        lclex_resize_hashmap(map, 2 * map->cap);
+    }
+}
+
+void lclex_remove_hashmap(lclex_hashmap_t *map, void *key) {
+    lclex_hash_t hash = map->hash_func(key);
+    size_t idx = hash & (map->cap - 1);
+
+    lclex_hashmap_entry_t **pentry = &map->data[idx];
+
+    while (*pentry != NULL) {
+        lclex_hashmap_entry_t *entry = *pentry;
+
+        if (entry->hash == hash && map->equal_func(entry->key, key)) {
+            *pentry = entry->next;
+            map->key_free_func(entry->key);
+            map->value_free_func(entry->value);
+            free(entry);
+            map->size--;
+
+            return;
+        }
+        pentry = &entry->next;
+    }
 }
@@ -0,0 +1,422 @@
+#include "image.h"
+#include "symbol.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LCLEX_IMAGE_INIT_SIZE 256
+
+/* Nodes in the order they are written, each with the number of
+   references to it from the image, and the index of every node added so
+   far so that shared nodes are written once. */
+typedef struct {
+    lclex_node_t *nodes;
+    size_t n_nodes;
+    size_t cap;
+    lclex_hashmap_t indices;
+    lclex_image_entry_t *entries;
+    size_t n_entries;
+    size_t entries_cap;
+    lclex_string_buf_t strings;
+} lclex_image_writer_t;
+
+static void lclex_keep_index(void *data) {
+    (void)data;
+}
+
+static size_t lclex_image_align(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+static uint64_t lclex_image_add_string(lclex_image_writer_t *writer,
+                                       char *str) {
+    lclex_string_buf_t *strings = &writer->strings;
+    size_t len = strlen(str) + 1;
+    uint64_t offset = strings->len;
+
+    while (strings->len + len > strings->cap) {
+        strings->cap *= 2;
+        strings->str = realloc(strings->str, strings->cap);
+    }
+
+    memcpy(strings->str + strings->len, str, len);
+    strings->len += len;
+
+    return offset;
+}
+
+/* Adds node and everything below it after its children, and returns one
+   more than its index. */
+static uint64_t lclex_image_add_node(lclex_image_writer_t *writer,
+                                     lclex_node_t *node) {
+    uint64_t left = 0, right = 0, index;
+
+    if (node == NULL) {
+        return 0;
+    }
+
+    index = (uintptr_t)lclex_lookup_hashmap(&writer->indices, node);
+    if (index != 0) {
+        writer->nodes[index - 1].refs++;
+        return index;
+    }
+
+    left = lclex_image_add_node(writer, node->left);
+    right = lclex_image_add_node(writer, node->right);
+
+    if (writer->n_nodes == writer->cap) {
+        writer->cap *= 2;
+        writer->nodes = realloc(writer->nodes,
+                                writer->cap * sizeof(lclex_node_t));
+    }
+
+    lclex_node_t *record = &writer->nodes[writer->n_nodes];
+    *record = *node;
+    record->refs = 1;
+    record->left = (lclex_node_t *)(uintptr_t)left;
+    record->right = (lclex_node_t *)(uintptr_t)right;
+
+    writer->n_nodes++;
+    index = writer->n_nodes;
+    lclex_insert_hashmap(&writer->indices, node, (void *)(uintptr_t)index);
+
+    return index;
+}
+
+static void lclex_image_add_entry(lclex_image_writer_t *writer,
+                                  lclex_image_entry_type_t type,
+                                  uint32_t level, char *name,
+                                  lclex_node_t *node) {
+    if (writer->n_entries == writer->entries_cap) {
+        writer->entries_cap *= 2;
+        writer->entries = realloc(writer->entries, writer->entries_cap
+                                  * sizeof(lclex_image_entry_t));
+    }
+
+    lclex_image_entry_t *entry = &writer->entries[writer->n_entries];
+    entry->type = type;
+    entry->level = level;
+    entry->name = lclex_image_add_string(writer, name);
+    entry->node = lclex_image_add_node(writer, node) - 1;
+
+    writer->n_entries++;
+}
+
+static bool lclex_image_write_part(FILE *file, void *data, size_t size) {
+    static char padding[8] = { 0 };
+    size_t aligned = lclex_image_align(size);
+
+    return fwrite(data, 1, size, file) == size
+           && fwrite(padding, 1, aligned - size, file) == aligned - size;
+}
+
+/* Writes the definitions, operators and the definitions of primitives.
+   Every symbol is written, so that the symbols of the nodes can be
+   stored as they are. */
+bool lclex_write_image(FILE *file, lclex_hashmap_t *defs,
+                       lclex_operator_table_t *opdefs) {
+    lclex_image_writer_t writer = {
+        .nodes = malloc(LCLEX_IMAGE_INIT_SIZE * sizeof(lclex_node_t)),
+        .n_nodes = 0,
+        .cap = LCLEX_IMAGE_INIT_SIZE,
+        .entries = malloc(LCLEX_IMAGE_INIT_SIZE
+                          * sizeof(lclex_image_entry_t)),
+        .n_entries = 0,
+        .entries_cap = LCLEX_IMAGE_INIT_SIZE
+    };
+
+    lclex_init_pointer_hashmap(&writer.indices, lclex_keep_index);
+
+    lclex_init_string_buf(&writer.strings);
+
+    uint64_t *names = malloc((lclex_symbols.n_names + 1) * sizeof(uint64_t));
+    for (size_t i = 0; i < lclex_symbols.n_names; i++) {
+        names[i] = lclex_image_add_string(&writer, lclex_symbol_name(i));
+    }
+
+    for (size_t i = 0; i < defs->cap; i++) {
+        for (lclex_hashmap_entry_t *entry = defs->data[i]; entry != NULL;
+             entry = entry->next) {
+            lclex_image_add_entry(&writer, LCLEX_IMAGE_DEFINITION, 0,
+                                  entry->key, entry->value);
+        }
+    }
+
+    for (size_t i = 0; i < opdefs->defs.cap; i++) {
+        for (lclex_hashmap_entry_t *entry = opdefs->defs.data[i]; 
+             entry != NULL; entry = entry->next) {
+            lclex_operator_def_t *def = entry->value;
+
+            lclex_image_add_entry(&writer, LCLEX_IMAGE_OPERATOR, def->level,
+                                  def->operator, def->node);
+        }
+    }
+
+    for (size_t i = 0; i < LCLEX_N_PRIMITIVES; i++) {
+        if (lclex_primitive_defs[i] != NULL) {
+            lclex_image_add_entry(&writer, LCLEX_IMAGE_PRIMITIVE, i,
+                                  lclex_primitive_name(i),
+                                  lclex_primitive_defs[i]);
+        }
+    }
+
+    lclex_image_header_t header = {
+        .version = LCLEX_IMAGE_VERSION,
+        .node_size = sizeof(lclex_node_t),
+        .n_nodes = writer.n_nodes,
+        .n_names = lclex_symbols.n_names,
+        .n_entries = writer.n_entries,
+        .strings_size = writer.strings.len
+    };
+    memcpy(header.magic, LCLEX_IMAGE_MAGIC, sizeof(header.magic));
+
+    bool success = lclex_image_write_part(file, &header, sizeof(header))
+        && lclex_image_write_part(file, writer.nodes,
+                                  writer.n_nodes * sizeof(lclex_node_t))
+        && lclex_image_write_part(file, names,
+                                  header.n_names * sizeof(uint64_t))
+        && lclex_image_write_part(file, writer.entries, writer.n_entries
+                                  * sizeof(lclex_image_entry_t))
+        && lclex_image_write_part(file, writer.strings.str,
+                                  writer.strings.len);
+
+    free(names);
+    free(writer.nodes);
+    free(writer.entries);
+    lclex_destruct_hashmap(&writer.indices);
+    lclex_destruct_string_buf(&writer.strings);
+
+    return success;
+}
+
+static bool lclex_image_invalid(lclex_image_t *image, char *path) {
+    fprintf(stderr, "Error: '%s' is not an image of this build\n", path);
+    munmap(image->data, image->size);
+    image->data = NULL;
+
+    return false;
+}
+
+/* Maps the image at path and relocates its nodes in place, which only
+   writes to the pages of the mapping. The names of symbols are interned
+   and the entries added to defs, opdefs and the definitions of the
+   primitives. */
+bool lclex_load_image(lclex_image_t *image, char *path,
+                      lclex_hashmap_t *defs,
+                      lclex_operator_table_t *opdefs) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &st) < 0
+        || (size_t)st.st_size < sizeof(lclex_image_header_t)) {
+        fprintf(stderr, "Error: could not open image '%s'\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+
+    image->size = st.st_size;
+    image->data = mmap(NULL, image->size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (image->data == MAP_FAILED) {
+        fprintf(stderr, "Error: could not map image '%s'\n", path);
+        image->data = NULL;
+        return false;
+    }
+
+    lclex_image_header_t *header = image->data;
+
+    if (memcmp(header->magic, LCLEX_IMAGE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != LCLEX_IMAGE_VERSION
+        || header->node_size != sizeof(lclex_node_t)
+        || header->n_nodes > image->size / sizeof(lclex_node_t)
+        || header->n_names > image->size / sizeof(uint64_t)
+        || header->n_entries > image->size / sizeof(lclex_image_entry_t)
+        || header->strings_size > image->size) {
+        return lclex_image_invalid(image, path);
+    }
+
+    lclex_node_t *nodes = (lclex_node_t *)(header + 1);
+    uint64_t *names = (uint64_t *)(nodes + header->n_nodes);
+    lclex_image_entry_t *entries = (lclex_image_entry_t *)
+                                   (names + header->n_names);
+    char *strings = (char *)(entries + header->n_entries);
+
+    if ((size_t)(strings - (char *)image->data) + header->strings_size
+        > image->size
+        || (header->strings_size > 0
+            && strings[header->strings_size - 1] != '\0')) {
+        return lclex_image_invalid(image, path);
+    }
+
+    /* Entries are checked before anything is added, so that a damaged
+       image leaves the definitions as they were. */
+    for (size_t i = 0; i < header->n_entries; i++) {
+        lclex_image_entry_t *entry = &entries[i];
+
+        if (entry->node >= header->n_nodes
+            || entry->name >= header->strings_size
+            || (entry->type == LCLEX_IMAGE_OPERATOR
+                && (entry->level < 1
+                    || entry->level > LCLEX_N_OPERATOR_LEVELS))
+            || (entry->type == LCLEX_IMAGE_PRIMITIVE
+                && entry->level >= LCLEX_N_PRIMITIVES)
+            || entry->type > LCLEX_IMAGE_PRIMITIVE) {
+            return lclex_image_invalid(image, path);
+        }
+    }
+
+    lclex_symbol_t *symbols = malloc((header->n_names + 1)
+                                     * sizeof(lclex_symbol_t));
+    for (size_t i = 0; i < header->n_names; i++) {
+        if (names[i] >= header->strings_size) {
+            free(symbols);
+            return lclex_image_invalid(image, path);
+        }
+        symbols[i] = lclex_intern(strings + names[i]);
+    }
+
+    /* Children are written before their parents, which rules out cycles
+       in a damaged image. Every node is checked against what its type 
+       allows, and the scope it was written with must bound the one of
+       its children, as walks skip the nodes whose scope is too low. 
+       References are counted to be checked once all parents are seen. */
+    uint32_t *scopes = malloc((header->n_nodes + 1) * sizeof(uint32_t));
+    uint32_t *refs = calloc(header->n_nodes + 1, sizeof(uint32_t));
+    bool valid = true;
+
+    for (size_t i = 0; valid && i < header->n_nodes; i++) {
+        lclex_node_t *node = &nodes[i];
+        uintptr_t left = (uintptr_t)node->left;
+        uintptr_t right = (uintptr_t)node->right;
+
+        if (left > i || right > i || node->type > LCLEX_PRIMITIVE) {
+            valid = false;
+            break;
+        }
+
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                valid = left != 0 && right != 0;
+                break;
+
+            case LCLEX_ABSTRACTION:
+                valid = left != 0 && right == 0;
+                break;
+
+            case LCLEX_PRIMITIVE:
+                valid = node->data.primitive < LCLEX_N_PRIMITIVES
+                        && left == 0 && right == 0;
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+            case LCLEX_NUMERAL:
+                valid = left == 0 && right == 0;
+                break;
+        }
+        if (!valid) {
+            break;
+        }
+
+        node->left = left == 0 ? NULL : &nodes[left - 1];
+        node->right = right == 0 ? NULL : &nodes[right - 1];
+        refs[left]++;
+        refs[right]++;
+
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                scopes[i] = scopes[left - 1] > scopes[right - 1] 
+                            ? scopes[left - 1] : scopes[right - 1];
+                break;
+
+            case LCLEX_ABSTRACTION:
+                scopes[i] = scopes[left - 1] > 0 ? scopes[left - 1] - 1 : 0;
+                break;
+
+            case LCLEX_BOUND_VARIABLE:
+                scopes[i] = node->data.index < LCLEX_SCOPE_UNKNOWN - 1 
+                            ? node->data.index + 1 : LCLEX_SCOPE_UNKNOWN;
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                scopes[i] = 0;
+                break;
+        }
+        valid = node->scope >= scopes[i];
+
+        if (valid && (node->type == LCLEX_ABSTRACTION
+                      || node->type == LCLEX_FREE_VARIABLE)
+            && node->data.symbol != LCLEX_NO_SYMBOL) {
+            valid = node->data.symbol < header->n_names;
+            if (valid) {
+                node->data.symbol = symbols[node->data.symbol];
+            }
+        }
+    }
+
+    /* Definitions must be closed, so that every bound index is within
+       its binders. */
+    for (size_t i = 0; valid && i < header->n_entries; i++) {
+        valid = scopes[entries[i].node] == 0;
+        refs[entries[i].node + 1]++;
+    }
+
+    for (size_t i = 0; valid && i < header->n_nodes; i++) {
+        valid = nodes[i].refs == refs[i + 1];
+    }
+
+    free(scopes);
+    free(refs);
+    free(symbols);
+
+    if (!valid) {
+        return lclex_image_invalid(image, path);
+    }
+
+    for (size_t i = 0; i < header->n_nodes; i++) {
+        if (nodes[i].scope == 0) {
+            nodes[i].refs++;
+        }
+    }
+
+    for (size_t i = 0; i < header->n_entries; i++) {
+        lclex_image_entry_t *entry = &entries[i];
+        lclex_node_t *node = &nodes[entry->node];
+        char *name = strings + entry->name;
+
+        switch (entry->type) {
+            case LCLEX_IMAGE_DEFINITION:
+                lclex_insert_hashmap(defs, lclex_strdup(name), node);
+                break;
+
+            case LCLEX_IMAGE_OPERATOR:
+                lclex_define_operator(opdefs, lclex_strdup(name), 
+                                      entry->level, node);
+                break;
+
+            case LCLEX_IMAGE_PRIMITIVE:
+                lclex_primitive_defs[entry->level] = node;
+                break;
+        }
+    }
+
+    return true;
+}
+
+/* Only valid once nothing refers to the nodes of the image anymore. */
+void lclex_unload_image(lclex_image_t *image) {
+    if (image->data != NULL) {
+        munmap(image->data, image->size);
+        image->data = NULL;
+    }
+}
@@ -0,0 +1,946 @@
+#include "inet.h"
+#include "krivine.h"
+#include <stdlib.h>
+#include <string.h>
+
+void lclex_init_inet(lclex_inet_t *net) {
+    net->agents = malloc(LCLEX_INET_INIT_SIZE * sizeof(lclex_agent_t));
+    net->size = 0;
+    net->cap = LCLEX_INET_INIT_SIZE;
+    net->free_list = LCLEX_INET_NONE;
+    net->live = 0;
+    net->blocks = NULL;
+    lclex_init_stack(&net->path);
+    net->trail = malloc(LCLEX_TRAIL_INIT_SIZE * sizeof(lclex_inet_step_t));
+    net->trail_size = 0;
+    net->trail_cap = LCLEX_TRAIL_INIT_SIZE;
+
+    memset(&net->stats, 0, sizeof(lclex_inet_stats_t));
+}
+
+void lclex_destruct_inet(lclex_inet_t *net) {
+    lclex_inet_block_t *next, *block = net->blocks;
+
+    while (block != NULL) {
+        next = block->next;
+        free(block);
+        block = next;
+    }
+
+    lclex_destruct_stack(&net->path);
+    free(net->trail);
+    free(net->agents);
+}
+
+void *lclex_inet_alloc(lclex_inet_t *net, size_t size) {
+    lclex_inet_block_t *block = net->blocks;
+
+    if (block == NULL || block->used + size > LCLEX_INET_BLOCK_SIZE) {
+        block = malloc(sizeof(lclex_inet_block_t) + LCLEX_INET_BLOCK_SIZE);
+        block->next = net->blocks;
+        block->used = 0;
+        net->blocks = block;
+    }
+
+    void *data = block->data + block->used;
+    block->used += size;
+
+    return data;
+}
+
+/* Frees what was allocated since block held used bytes. */
+static void lclex_inet_release(lclex_inet_t *net, lclex_inet_block_t *block,
+                               size_t used) {
+    while (net->blocks != block) {
+        lclex_inet_block_t *next = net->blocks->next;
+        free(net->blocks);
+        net->blocks = next;
+    }
+
+    if (block != NULL) {
+        block->used = used;
+    }
+}
+
+/* Makes room for n new agents, so that pointers into the agent array stay
+   valid while a rule allocates them. */
+static void lclex_reserve_agents(lclex_inet_t *net, size_t n) {
+    if (net->size + n > net->cap) {
+        while (net->size + n > net->cap) {
+            net->cap *= 2;
+        }
+        net->agents = realloc(net->agents, net->cap * sizeof(lclex_agent_t));
+    }
+}
+
+uint32_t lclex_new_agent(lclex_inet_t *net, lclex_agent_type_t type,
+                         uint32_t level, lclex_symbol_t name) {
+    uint32_t agent;
+
+    if (net->free_list != LCLEX_INET_NONE) {
+        agent = net->free_list;
+        net->free_list = net->agents[agent].ports[0];
+    } else {
+        lclex_reserve_agents(net, 1);
+        agent = net->size;
+        net->size++;
+    }
+
+    net->agents[agent].type = type;
+    net->agents[agent].level = level;
+    net->agents[agent].name = name;
+
+    net->stats.agents++;
+    net->live++;
+    if (net->live > net->stats.peak) {
+        net->stats.peak = net->live;
+    }
+
+    return agent;
+}
+
+void lclex_free_agent(lclex_inet_t *net, uint32_t agent) {
+    net->agents[agent].ports[0] = net->free_list;
+    net->free_list = agent;
+    net->live--;
+}
+
+void lclex_link_ports(lclex_inet_t *net, lclex_port_t a, lclex_port_t b) {
+    net->agents[LCLEX_PORT_AGENT(a)].ports[LCLEX_PORT_SLOT(a)] = b;
+    net->agents[LCLEX_PORT_AGENT(b)].ports[LCLEX_PORT_SLOT(b)] = a;
+}
+
+static lclex_port_t lclex_peer(lclex_inet_t *net, lclex_port_t port) {
+    return net->agents[LCLEX_PORT_AGENT(port)].ports[LCLEX_PORT_SLOT(port)];
+}
+
+static size_t lclex_agent_arity(lclex_agent_type_t type) {
+    switch (type) {
+        case LCLEX_AGENT_LAMBDA:
+        case LCLEX_AGENT_APPLY:
+        case LCLEX_AGENT_FAN:
+            return 2;
+
+        case LCLEX_AGENT_CROISSANT:
+        case LCLEX_AGENT_BRACKET:
+            return 1;
+
+        case LCLEX_AGENT_ROOT:
+        case LCLEX_AGENT_ERASER:
+        case LCLEX_AGENT_FREE:
+            return 0;
+    }
+
+    return 0;
+}
+
+static bool lclex_is_control(lclex_agent_type_t type) {
+    return type == LCLEX_AGENT_FAN || type == LCLEX_AGENT_CROISSANT
+           || type == LCLEX_AGENT_BRACKET;
+}
+
+/* Whether port and its peer form an active pair. An application of a free
+   variable is a neutral term, not a redex. */
+static bool lclex_is_redex(lclex_inet_t *net, lclex_port_t port) {
+    lclex_port_t peer = lclex_peer(net, port);
+    lclex_agent_type_t a = net->agents[LCLEX_PORT_AGENT(port)].type;
+    lclex_agent_type_t b = net->agents[LCLEX_PORT_AGENT(peer)].type;
+
+    if (LCLEX_PORT_SLOT(port) != 0 || LCLEX_PORT_SLOT(peer) != 0
+        || a == LCLEX_AGENT_ROOT || b == LCLEX_AGENT_ROOT) {
+        return false;
+    }
+
+    return !((a == LCLEX_AGENT_APPLY && b == LCLEX_AGENT_FREE)
+             || (a == LCLEX_AGENT_FREE && b == LCLEX_AGENT_APPLY));
+}
+
+static lclex_inet_var_t *lclex_new_inet_var(lclex_inet_t *net, size_t binder,
+                                            lclex_port_t port,
+                                            lclex_inet_var_t *next) {
+    lclex_inet_var_t *var = lclex_inet_alloc(net, sizeof(lclex_inet_var_t));
+
+    var->binder = binder;
+    var->port = port;
+    var->next = next;
+
+    return var;
+}
+
+/* Translates node at the given level into the net, returning the port of
+   its root. The wires of bound variables whose binders lie outside node
+   are returned in pvars. Arguments live one level deeper than the
+   application, their free variables leave through brackets, an
+   occurrence of a variable starts with a croissant, and occurrences are
+   merged by fans at the level of the application or lambda joining them.
+
+   Terms can be deeper than the call stack allows, so a node is pushed 
+   onto pending with its level and depth, node on top. A lambda or an 
+   application gets its agent before its children, which are translated 
+   left first, and is then pushed again with its agent behind a NULL. The
+   port and variables of each translated node wait on results. */
+static lclex_port_t lclex_inet_translate_term(lclex_inet_t *net,
+                                              lclex_node_t *node,
+                                              uint32_t level, size_t depth,
+                                              lclex_inet_var_t **pvars) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    void *results_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending, results;
+    uint32_t agent, other;
+    lclex_port_t port = 0;
+    lclex_inet_var_t *vars = NULL, *left, *right, **tail;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_init_pending(&results, results_data);
+    lclex_push_pending(&pending, (void *)(uintptr_t)level);
+    lclex_push_pending(&pending, (void *)(depth));
+    lclex_push_pending(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pop_pending(&pending);
+
+        if (node == NULL) {
+            node = lclex_pop_pending(&pending);
+            agent = (uintptr_t)lclex_pop_pending(&pending);
+            depth = (size_t)lclex_pop_pending(&pending);
+            level = (uintptr_t)lclex_pop_pending(&pending);
+
+            if (node->type == LCLEX_ABSTRACTION) {
+                port = (uintptr_t)lclex_pop_pending(&results);
+                vars = lclex_pop_pending(&results);
+                lclex_link_ports(net, LCLEX_PORT(agent, 1), port);
+
+                if (vars != NULL && vars->binder == depth) {
+                    lclex_link_ports(net, LCLEX_PORT(agent, 2), vars->port);
+                    vars = vars->next;
+                } else {
+                    other = lclex_new_agent(net, LCLEX_AGENT_ERASER, 0,
+                                            LCLEX_NO_SYMBOL);
+                    lclex_link_ports(net, LCLEX_PORT(agent, 2),
+                                     LCLEX_PORT(other, 0));
+                }
+                port = LCLEX_PORT(agent, 0);
+            } else {
+                port = (uintptr_t)lclex_pop_pending(&results);
+                right = lclex_pop_pending(&results);
+                lclex_link_ports(net, LCLEX_PORT(agent, 2), port);
+                port = (uintptr_t)lclex_pop_pending(&results);
+                left = lclex_pop_pending(&results);
+                lclex_link_ports(net, LCLEX_PORT(agent, 0), port);
+
+                for (lclex_inet_var_t *var = right; var != NULL; 
+                     var = var->next) {
+                    other = lclex_new_agent(net, LCLEX_AGENT_BRACKET, level,
+                                            LCLEX_NO_SYMBOL);
+                    lclex_link_ports(net, LCLEX_PORT(other, 1), var->port);
+                    var->port = LCLEX_PORT(other, 0);
+                }
+
+                tail = &vars;
+                while (left != NULL || right != NULL) {
+                    if (right == NULL
+                        || (left != NULL && left->binder > right->binder)) {
+                        *tail = left;
+                        left = left->next;
+                    } else if (left == NULL 
+                               || right->binder > left->binder) {
+                        *tail = right;
+                        right = right->next;
+                    } else {
+                        other = lclex_new_agent(net, LCLEX_AGENT_FAN, level,
+                                                LCLEX_NO_SYMBOL);
+                        lclex_link_ports(net, LCLEX_PORT(other, 1), 
+                                         left->port);
+                        lclex_link_ports(net, LCLEX_PORT(other, 2), 
+                                         right->port);
+                        left->port = LCLEX_PORT(other, 0);
+                        *tail = left;
+                        left = left->next;
+                        right = right->next;
+                    }
+                    tail = &(*tail)->next;
+                }
+                *tail = NULL;
+                port = LCLEX_PORT(agent, 1);
+            }
+
+            lclex_push_pending(&results, vars);
+            lclex_push_pending(&results, (void *)(uintptr_t)port);
+            continue;
+        }
+
+        depth = (size_t)lclex_pop_pending(&pending);
+        level = (uintptr_t)lclex_pop_pending(&pending);
+
+        switch (node->type) {
+            case LCLEX_ABSTRACTION:
+            case LCLEX_APPLICATION:
+                agent = lclex_new_agent(net, 
+                                        node->type == LCLEX_ABSTRACTION
+                                        ? LCLEX_AGENT_LAMBDA 
+                                        : LCLEX_AGENT_APPLY,
+                                        level, 
+                                        node->type == LCLEX_ABSTRACTION
+                                        ? node->data.symbol 
+                                        : LCLEX_NO_SYMBOL);
+                lclex_push_pending(&pending, (void *)(uintptr_t)level);
+                lclex_push_pending(&pending, (void *)(depth));
+                lclex_push_pending(&pending, (void *)(uintptr_t)agent);
+                lclex_push_pending(&pending, node);
+                lclex_push_pending(&pending, NULL);
+
+                if (node->type == LCLEX_ABSTRACTION) {
+                    depth++;
+                } else {
+                    lclex_push_pending(&pending, 
+                                       (void *)(uintptr_t)(level + 1));
+                    lclex_push_pending(&pending, (void *)(depth));
+                    lclex_push_pending(&pending, node->right);
+                }
+                lclex_push_pending(&pending, (void *)(uintptr_t)level);
+                lclex_push_pending(&pending, (void *)(depth));
+                lclex_push_pending(&pending, node->left);
+                continue;
+
+            case LCLEX_FREE_VARIABLE:
+                agent = lclex_new_agent(net, LCLEX_AGENT_FREE, UINT32_MAX,
+                                        node->data.symbol);
+                vars = NULL;
+                port = LCLEX_PORT(agent, 0);
+                break;
+
+            case LCLEX_BOUND_VARIABLE:
+                agent = lclex_new_agent(net, LCLEX_AGENT_CROISSANT, level,
+                                        LCLEX_NO_SYMBOL);
+                vars = lclex_new_inet_var(net, depth - node->data.index - 1,
+                                          LCLEX_PORT(agent, 0), NULL);
+                port = LCLEX_PORT(agent, 1);
+                break;
+
+            /* Closed, so they are translated as what they stand for. */
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                lclex_push_pending(&pending, (void *)(uintptr_t)level);
+                lclex_push_pending(&pending, (void *)(depth));
+                lclex_push_pending(&pending, lclex_expand_node(node));
+                continue;
+        }
+
+        lclex_push_pending(&results, vars);
+        lclex_push_pending(&results, (void *)(uintptr_t)port);
+    }
+
+    port = (uintptr_t)lclex_pop_pending(&results);
+    *pvars = lclex_pop_pending(&results);
+    lclex_destruct_pending(&pending);
+    lclex_destruct_pending(&results);
+
+    return port;
+}
+
+lclex_port_t lclex_inet_translate(lclex_inet_t *net, lclex_node_t *node) {
+    lclex_inet_var_t *vars;
+
+    return lclex_inet_translate_term(net, node, 0, 0, &vars);
+}
+
+static void lclex_inet_erase(lclex_inet_t *net, uint32_t eraser,
+                             uint32_t agent) {
+    lclex_agent_t *target = &net->agents[agent];
+    size_t arity = lclex_agent_arity(target->type);
+
+    lclex_reserve_agents(net, arity);
+    target = &net->agents[agent];
+
+    for (size_t i = 1; i <= arity; i++) {
+        uint32_t other = lclex_new_agent(net, LCLEX_AGENT_ERASER, 0,
+                                         LCLEX_NO_SYMBOL);
+        lclex_link_ports(net, LCLEX_PORT(other, 0), target->ports[i]);
+    }
+
+    lclex_free_agent(net, eraser);
+    lclex_free_agent(net, agent);
+    net->stats.erasures++;
+}
+
+static void lclex_inet_beta(lclex_inet_t *net, uint32_t lambda,
+                            uint32_t apply) {
+    lclex_port_t body = net->agents[lambda].ports[1];
+    lclex_port_t binder = net->agents[lambda].ports[2];
+    lclex_port_t result = net->agents[apply].ports[1];
+    lclex_port_t argument = net->agents[apply].ports[2];
+
+    lclex_link_ports(net, body, result);
+    lclex_link_ports(net, binder, argument);
+
+    lclex_free_agent(net, lambda);
+    lclex_free_agent(net, apply);
+    net->stats.betas++;
+}
+
+static void lclex_inet_annihilate(lclex_inet_t *net, uint32_t a, uint32_t b) {
+    size_t arity = lclex_agent_arity(net->agents[a].type);
+
+    for (size_t i = 1; i <= arity; i++) {
+        lclex_link_ports(net, net->agents[a].ports[i],
+                         net->agents[b].ports[i]);
+    }
+
+    lclex_free_agent(net, a);
+    lclex_free_agent(net, b);
+    net->stats.annihilations++;
+}
+
+/* The control agent passes through agent, which has a higher level. A fan
+   duplicates it, a croissant lowers its level and a bracket raises it. */
+static void lclex_inet_propagate(lclex_inet_t *net, uint32_t control,
+                                 uint32_t agent) {
+    lclex_agent_t *c, *a;
+    size_t arity = lclex_agent_arity(net->agents[agent].type);
+    uint32_t copy, other;
+
+    lclex_reserve_agents(net, arity + 1);
+    c = &net->agents[control];
+    a = &net->agents[agent];
+
+    if (c->type == LCLEX_AGENT_FAN) {
+        copy = lclex_new_agent(net, a->type, a->level, a->name);
+
+        for (size_t i = 1; i <= arity; i++) {
+            other = lclex_new_agent(net, LCLEX_AGENT_FAN, c->level,
+                                    LCLEX_NO_SYMBOL);
+            lclex_link_ports(net, LCLEX_PORT(other, 0), a->ports[i]);
+            lclex_link_ports(net, LCLEX_PORT(other, 1), LCLEX_PORT(agent, i));
+            lclex_link_ports(net, LCLEX_PORT(other, 2), LCLEX_PORT(copy, i));
+        }
+
+        lclex_link_ports(net, LCLEX_PORT(agent, 0), c->ports[1]);
+        lclex_link_ports(net, LCLEX_PORT(copy, 0), c->ports[2]);
+        net->stats.duplications++;
+    } else {
+        if (a->type != LCLEX_AGENT_FREE) {
+            if (c->type == LCLEX_AGENT_CROISSANT) {
+                a->level--;
+            } else {
+                a->level++;
+            }
+        }
+
+        for (size_t i = 1; i <= arity; i++) {
+            other = lclex_new_agent(net, c->type, c->level, LCLEX_NO_SYMBOL);
+            lclex_link_ports(net, LCLEX_PORT(other, 0), a->ports[i]);
+            lclex_link_ports(net, LCLEX_PORT(other, 1), LCLEX_PORT(agent, i));
+        }
+
+        lclex_link_ports(net, LCLEX_PORT(agent, 0), c->ports[1]);
+        net->stats.propagations++;
+    }
+
+    lclex_free_agent(net, control);
+}
+
+bool lclex_inet_interact(lclex_inet_t *net, uint32_t a, uint32_t b) {
+    lclex_agent_t *x = &net->agents[a];
+    lclex_agent_t *y = &net->agents[b];
+
+    if (y->type == LCLEX_AGENT_ERASER) {
+        lclex_inet_erase(net, b, a);
+        return true;
+    }
+    if (x->type == LCLEX_AGENT_ERASER) {
+        lclex_inet_erase(net, a, b);
+        return true;
+    }
+
+    if (x->type == LCLEX_AGENT_LAMBDA && y->type == LCLEX_AGENT_APPLY) {
+        lclex_inet_beta(net, a, b);
+        return true;
+    }
+    if (x->type == LCLEX_AGENT_APPLY && y->type == LCLEX_AGENT_LAMBDA) {
+        lclex_inet_beta(net, b, a);
+        return true;
+    }
+
+    if (x->type == y->type && x->level == y->level
+        && lclex_is_control(x->type)) {
+        lclex_inet_annihilate(net, a, b);
+        return true;
+    }
+
+    /* The agent with the lower level acts on the other one, which must be
+       a control agent itself unless it is above every level. */
+    if (lclex_is_control(x->type) && x->level < y->level) {
+        lclex_inet_propagate(net, a, b);
+        return true;
+    }
+    if (lclex_is_control(y->type) && y->level < x->level) {
+        lclex_inet_propagate(net, b, a);
+        return true;
+    }
+
+    return false;
+}
+
+static lclex_level_t *lclex_new_level(lclex_inet_t *net,
+                                      lclex_context_type_t type,
+                                      uint32_t choice, lclex_level_t *first,
+                                      lclex_level_t *second) {
+    lclex_level_t *level = lclex_inet_alloc(net, sizeof(lclex_level_t));
+
+    level->type = type;
+    level->choice = choice;
+    level->first = first;
+    level->second = second;
+
+    return level;
+}
+
+void lclex_init_context(lclex_context_t *context) {
+    context->levels = malloc(LCLEX_CONTEXT_INIT_SIZE * sizeof(lclex_level_t *));
+    context->size = 0;
+    context->cap = LCLEX_CONTEXT_INIT_SIZE;
+}
+
+void lclex_destruct_context(lclex_context_t *context) {
+    free(context->levels);
+}
+
+static void lclex_reserve_levels(lclex_context_t *context, size_t size) {
+    if (size > context->cap) {
+        while (size > context->cap) {
+            context->cap *= 2;
+        }
+        context->levels = realloc(context->levels,
+                                  context->cap * sizeof(lclex_level_t *));
+    }
+}
+
+void lclex_copy_context(lclex_context_t *dest, lclex_context_t *src) {
+    lclex_reserve_levels(dest, src->size);
+    memcpy(dest->levels, src->levels, src->size * sizeof(lclex_level_t *));
+    dest->size = src->size;
+}
+
+static lclex_level_t *lclex_get_level(lclex_context_t *context,
+                                      uint32_t index) {
+    return index < context->size ? context->levels[index] : NULL;
+}
+
+/* Replaces drop levels at index by the n given levels. */
+static void lclex_splice_context(lclex_context_t *context, uint32_t index,
+                                 uint32_t drop, lclex_level_t **levels,
+                                 uint32_t n) {
+    if (context->size < index + drop) {
+        lclex_reserve_levels(context, index + drop);
+        while (context->size < index + drop) {
+            context->levels[context->size] = NULL;
+            context->size++;
+        }
+    }
+
+    lclex_reserve_levels(context, context->size - drop + n);
+    memmove(context->levels + index + n, context->levels + index + drop,
+            (context->size - index - drop) * sizeof(lclex_level_t *));
+    if (n > 0) {
+        memcpy(context->levels + index, levels, n * sizeof(lclex_level_t *));
+    }
+    context->size = context->size - drop + n;
+}
+
+/* Updates context for passing control from its auxiliary port slot to its
+   principal port. */
+static void lclex_context_up(lclex_inet_t *net, lclex_context_t *context,
+                             lclex_agent_t *control, uint32_t slot) {
+    lclex_level_t *levels[1];
+    uint32_t i = control->level;
+
+    switch (control->type) {
+        case LCLEX_AGENT_FAN:
+            levels[0] = lclex_new_level(net, LCLEX_CONTEXT_PUSH, slot,
+                                        lclex_get_level(context, i), NULL);
+            lclex_splice_context(context, i, 1, levels, 1);
+            break;
+
+        case LCLEX_AGENT_CROISSANT:
+            levels[0] = lclex_new_level(net, LCLEX_CONTEXT_STAR, 0,
+                                        NULL, NULL);
+            lclex_splice_context(context, i, 0, levels, 1);
+            break;
+
+        case LCLEX_AGENT_BRACKET:
+            levels[0] = lclex_new_level(net, LCLEX_CONTEXT_PAIR, 0,
+                                        lclex_get_level(context, i),
+                                        lclex_get_level(context, i + 1));
+            lclex_splice_context(context, i, 2, levels, 1);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* Passes control from its principal port to an auxiliary port, returning
+   the slot of that port, or 0 if the context does not allow it. */
+static uint32_t lclex_context_down(lclex_context_t *context,
+                                   lclex_agent_t *control) {
+    lclex_level_t *levels[2];
+    uint32_t i = control->level;
+    lclex_level_t *level = lclex_get_level(context, i);
+
+    switch (control->type) {
+        case LCLEX_AGENT_FAN:
+            if (level == NULL || level->type != LCLEX_CONTEXT_PUSH) {
+                return 0;
+            }
+            levels[0] = level->first;
+            lclex_splice_context(context, i, 1, levels, 1);
+            return level->choice;
+
+        case LCLEX_AGENT_CROISSANT:
+            if (level == NULL || level->type != LCLEX_CONTEXT_STAR) {
+                return 0;
+            }
+            lclex_splice_context(context, i, 1, NULL, 0);
+            return 1;
+
+        case LCLEX_AGENT_BRACKET:
+            if (level == NULL || level->type != LCLEX_CONTEXT_PAIR) {
+                return 0;
+            }
+            levels[0] = level->first;
+            levels[1] = level->second;
+            lclex_splice_context(context, i, 1, levels, 2);
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+static void lclex_push_step(lclex_inet_t *net, lclex_port_t port,
+                            lclex_agent_t *agent, uint32_t slot, bool up) {
+    if (net->trail_size == net->trail_cap) {
+        net->trail_cap *= 2;
+        net->trail = realloc(net->trail,
+                             net->trail_cap * sizeof(lclex_inet_step_t));
+    }
+
+    net->trail[net->trail_size].port = port;
+    net->trail[net->trail_size].agent = *agent;
+    net->trail[net->trail_size].slot = slot;
+    net->trail[net->trail_size].up = up;
+    net->trail_size++;
+}
+
+/* Follows the wire leaving from through control agents until it reaches a
+   lambda, the result of an application, a binder or a free variable, and
+   returns the port it arrives at, updating context along the way. Active
+   pairs met on the way are reduced first. */
+static lclex_port_t lclex_inet_walk(lclex_inet_t *net, lclex_port_t from,
+                                    lclex_context_t *context, bool *ok) {
+    lclex_port_t current = from;
+
+    net->trail_size = 0;
+
+    while (true) {
+        lclex_port_t port = lclex_peer(net, current);
+        uint32_t index = LCLEX_PORT_AGENT(port);
+        uint32_t slot = LCLEX_PORT_SLOT(port);
+        lclex_agent_t *agent = &net->agents[index];
+        lclex_port_t next = LCLEX_PORT(index, 0);
+
+        /* The control agent passed last took part in a rule, so the walk
+           steps back over it. At from, the function of the application 
+           being read became a lambda, and the caller has to contract the
+           application first. */
+        if (lclex_is_redex(net, current)) {
+            if (net->trail_size == 0) {
+                return LCLEX_INET_NONE;
+            }
+
+            net->trail_size--;
+            lclex_inet_step_t *step = &net->trail[net->trail_size];
+            if (step->up) {
+                lclex_context_down(context, &step->agent);
+            } else {
+                lclex_context_up(net, context, &step->agent, step->slot);
+            }
+            current = step->port;
+            continue;
+        }
+
+        switch (agent->type) {
+            case LCLEX_AGENT_FAN:
+            case LCLEX_AGENT_CROISSANT:
+            case LCLEX_AGENT_BRACKET:
+                if (slot != 0) {
+                    if (lclex_is_redex(net, next)) {
+                        if (!lclex_inet_interact(
+                                net, index,
+                                LCLEX_PORT_AGENT(lclex_peer(net, next)))) {
+                            *ok = false;
+                            return port;
+                        }
+                        continue;
+                    }
+                    lclex_push_step(net, current, agent, slot, true);
+                    lclex_context_up(net, context, agent, slot);
+                    current = next;
+                } else {
+                    slot = lclex_context_down(context, agent);
+                    if (slot == 0) {
+                        *ok = false;
+                        return port;
+                    }
+                    lclex_push_step(net, current, agent, slot, false);
+                    current = LCLEX_PORT(index, slot);
+                }
+                continue;
+
+            case LCLEX_AGENT_APPLY:
+                if (slot != 1) {
+                    *ok = false;
+                    return port;
+                }
+                if (lclex_is_redex(net, next)) {
+                    if (!lclex_inet_interact(
+                            net, index,
+                            LCLEX_PORT_AGENT(lclex_peer(net, next)))) {
+                        *ok = false;
+                        return port;
+                    }
+                    continue;
+                }
+                break;
+
+            case LCLEX_AGENT_LAMBDA:
+                if (slot == 1) {
+                    *ok = false;
+                    return port;
+                }
+                break;
+
+            case LCLEX_AGENT_FREE:
+                break;
+
+            case LCLEX_AGENT_ROOT:
+            case LCLEX_AGENT_ERASER:
+                *ok = false;
+                return port;
+        }
+
+        return port;
+    }
+}
+
+/* Appends the levels of context to saved. */
+static void lclex_save_context(lclex_context_t *saved,
+                               lclex_context_t *context) {
+    lclex_reserve_levels(saved, saved->size + context->size);
+    memcpy(saved->levels + saved->size, context->levels,
+           context->size * sizeof(lclex_level_t *));
+    saved->size += context->size;
+}
+
+static void lclex_restore_context(lclex_context_t *context,
+                                  lclex_context_t *saved, size_t offset,
+                                  size_t size) {
+    lclex_reserve_levels(context, size);
+    memcpy(context->levels, saved->levels + offset, 
+           size * sizeof(lclex_level_t *));
+    context->size = size;
+}
+
+/* Bodies of lambdas and arguments are read back in place through slot.
+   The function of an application is read into a frame pushed onto 
+   frames, with the contexts of the reader saved onto saved, as terms can
+   be deeper than the call stack allows. A frame is done when its term is
+   complete or a walk stops at its own wire. The saved contexts are older
+   than the walks made for the frame, so the levels those made are freed
+   once it is popped, and the frame is kept on spare for the next
+   application. */
+lclex_node_t *lclex_inet_read_back(lclex_inet_t *net, lclex_port_t from,
+                                   lclex_context_t *source, bool *ok) {
+    lclex_node_t *root = NULL;
+    lclex_node_t **slot = &root;
+    size_t base = net->path.size;
+    lclex_context_t context, start, saved;
+    lclex_inet_frame_t *frames = NULL, *spare = NULL, *frame;
+
+    lclex_init_context(&context);
+    lclex_init_context(&start);
+    lclex_init_context(&saved);
+    lclex_copy_context(&context, source);
+
+    while (*ok) {
+        lclex_port_t port = LCLEX_INET_NONE;
+
+        if (slot != NULL) {
+            lclex_copy_context(&start, &context);
+            port = lclex_inet_walk(net, from, &context, ok);
+        }
+
+        if (!*ok) {
+            break;
+        }
+
+        if (port == LCLEX_INET_NONE) {
+            if (frames == NULL) {
+                break;
+            }
+
+            frame = frames;
+            frames = frame->next;
+            frame->next = spare;
+            spare = frame;
+
+            uint32_t index = frame->apply;
+            lclex_node_t *left = frame->left;
+
+            net->path.size = frame->base;
+            lclex_restore_context(&start, &saved, frame->saved,
+                                  frame->start_size);
+            lclex_restore_context(&context, &saved, 
+                                  frame->saved + frame->start_size,
+                                  frame->context_size);
+            saved.size = frame->saved;
+            lclex_inet_release(net, frame->block, frame->used);
+            slot = frame->slot;
+            from = frame->from;
+
+            /* Reading the function can turn it into a lambda, making this
+               application a redex after all. */
+            if (left == NULL || lclex_is_redex(net, LCLEX_PORT(index, 0))) {
+                if (left != NULL) {
+                    lclex_free_partial_node(left);
+                }
+                lclex_copy_context(&context, &start);
+                continue;
+            }
+
+            lclex_node_t *node = lclex_new_application(left, NULL);
+            *slot = node;
+            slot = &node->right;
+            from = LCLEX_PORT(index, 2);
+            continue;
+        }
+
+        uint32_t index = LCLEX_PORT_AGENT(port);
+        lclex_agent_t *agent = &net->agents[index];
+        lclex_node_t *node;
+
+        if (agent->type == LCLEX_AGENT_FREE) {
+            *slot = lclex_new_free_variable(agent->name);
+            slot = NULL;
+        } else if (agent->type == LCLEX_AGENT_LAMBDA
+                   && LCLEX_PORT_SLOT(port) == 2) {
+            size_t i = net->path.size;
+
+            /* The binder is the innermost lambda on the path with this 
+               agent, including those of enclosing frames. */
+            while (i > 0 && net->path.data[i - 1] != (void *)(uintptr_t)index) {
+                i--;
+            }
+            if (i == 0) {
+                *ok = false;
+                break;
+            }
+
+            *slot = lclex_new_bound_variable(net->path.size - i);
+            slot = NULL;
+        } else if (agent->type == LCLEX_AGENT_LAMBDA) {
+            node = lclex_new_abstraction(agent->name, NULL);
+            *slot = node;
+            slot = &node->left;
+
+            lclex_push_stack(&net->path, (void *)(uintptr_t)index);
+            from = LCLEX_PORT(index, 1);
+        } else {
+            if (spare != NULL) {
+                frame = spare;
+                spare = frame->next;
+            } else {
+                frame = malloc(sizeof(lclex_inet_frame_t));
+            }
+            frame->next = frames;
+            frames = frame;
+
+            frame->left = NULL;
+            frame->slot = slot;
+            frame->from = from;
+            frame->apply = index;
+            frame->base = net->path.size;
+            frame->saved = saved.size;
+            frame->start_size = start.size;
+            frame->context_size = context.size;
+            frame->block = net->blocks;
+            frame->used = net->blocks != NULL ? net->blocks->used : 0;
+            lclex_save_context(&saved, &start);
+            lclex_save_context(&saved, &context);
+
+            slot = &frame->left;
+            from = LCLEX_PORT(index, 0);
+        }
+    }
+
+    /* Frames left by a failed read back hold parts of the result, which
+       are left to the statement arena. */
+    while (frames != NULL) {
+        frame = frames;
+        frames = frame->next;
+        free(frame);
+    }
+    while (spare != NULL) {
+        frame = spare;
+        spare = frame->next;
+        free(frame);
+    }
+
+    net->path.size = base;
+    lclex_destruct_context(&context);
+    lclex_destruct_context(&start);
+    lclex_destruct_context(&saved);
+
+    return root;
+}
+
+void lclex_inet_reduce_expression(lclex_inet_t *net, lclex_node_t **pexpr) {
+    lclex_node_t *expr = *pexpr;
+    uint32_t root = lclex_new_agent(net, LCLEX_AGENT_ROOT, 0, LCLEX_NO_SYMBOL);
+    lclex_port_t port = lclex_inet_translate(net, expr);
+    lclex_context_t context;
+    bool ok = true;
+
+    lclex_link_ports(net, LCLEX_PORT(root, 0), port);
+
+    lclex_init_context(&context);
+    lclex_node_t *result = lclex_inet_read_back(net, LCLEX_PORT(root, 0),
+                                                &context, &ok);
+    lclex_destruct_context(&context);
+
+    if (ok) {
+        *pexpr = result;
+        lclex_free_node(expr);
+        return;
+    }
+
+    /* A configuration the rules do not cover, the partial result is left
+       to the statement arena and the term is normalized by the Krivine
+       machine instead. */
+    lclex_krivine_t machine;
+
+    net->stats.fallback = true;
+    lclex_init_krivine(&machine);
+    lclex_krivine_reduce_expression(&machine, pexpr);
+    lclex_destruct_krivine(&machine);
+}
+
+void lclex_write_inet_stats(lclex_inet_t *net, FILE *stream) {
+    fprintf(stream, "> optimal: %ld betas, %ld annihilations, "
+            "%ld duplications, %ld propagations, %ld erasures, "
+            "%ld agents, %ld peak%s\n",
+            net->stats.betas, net->stats.annihilations,
+            net->stats.duplications, net->stats.propagations,
+            net->stats.erasures, net->stats.agents, net->stats.peak,
+            net->stats.fallback ? ", fell back to krivine" : "");
+}
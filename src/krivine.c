@@ -0,0 +1,278 @@
+#include "krivine.h"
+#include <stdlib.h>
+#include <string.h>
+
+void lclex_init_krivine(lclex_krivine_t *machine) {
+    machine->stack = malloc(LCLEX_KRIVINE_STACK_INIT_SIZE
+                            * sizeof(lclex_closure_t));
+    machine->size = 0;
+    machine->cap = LCLEX_KRIVINE_STACK_INIT_SIZE;
+    machine->blocks = NULL;
+
+    memset(&machine->stats, 0, sizeof(lclex_krivine_stats_t));
+}
+
+void lclex_destruct_krivine(lclex_krivine_t *machine) {
+    lclex_krivine_block_t *next, *block = machine->blocks;
+
+    while (block != NULL) {
+        next = block->next;
+        free(block->cells);
+        free(block);
+        block = next;
+    }
+
+    free(machine->stack);
+}
+
+lclex_env_t *lclex_new_env(lclex_krivine_t *machine, lclex_node_t *term,
+                           lclex_env_t *env, lclex_env_t *next) {
+    lclex_krivine_block_t *block = machine->blocks;
+
+    if (block == NULL || block->used == LCLEX_KRIVINE_BLOCK_SIZE) {
+        block = malloc(sizeof(lclex_krivine_block_t));
+        block->next = machine->blocks;
+        block->cells = malloc(LCLEX_KRIVINE_BLOCK_SIZE * sizeof(lclex_env_t));
+        block->used = 0;
+        machine->blocks = block;
+    }
+
+    lclex_env_t *cell = &block->cells[block->used];
+    block->used++;
+    machine->stats.cells++;
+
+    cell->term = term;
+    cell->env = env;
+    cell->next = next;
+
+    return cell;
+}
+
+void lclex_push_closure(lclex_krivine_t *machine, lclex_node_t *term,
+                        lclex_env_t *env) {
+    if (machine->size == machine->cap) {
+        machine->cap *= 2;
+        machine->stack = realloc(machine->stack,
+                                 machine->cap * sizeof(lclex_closure_t));
+    }
+
+    machine->stack[machine->size].term = term;
+    machine->stack[machine->size].env = env;
+    machine->size++;
+
+    if (machine->size > machine->stats.max_stack) {
+        machine->stats.max_stack = machine->size;
+    }
+}
+
+static lclex_env_t *lclex_lookup_env(lclex_krivine_t *machine,
+                                     lclex_env_t *env,
+                                     lclex_bruijn_index_t index) {
+    machine->stats.lookups++;
+
+    while (index > 0) {
+        env = env->next;
+        index--;
+    }
+
+    return env;
+}
+
+static lclex_node_t *lclex_krivine_lookup(void **penv,
+                                          lclex_bruijn_index_t index) {
+    lclex_env_t *cell = *penv;
+
+    while (index > 0) {
+        cell = cell->next;
+        index--;
+    }
+
+    *penv = cell->env;
+    return cell->term;
+}
+
+/* Computes primitive natively if the closures on top of the stack supply
+   all of its arguments and they fold to numerals. */
+static bool lclex_krivine_primitive(lclex_krivine_t *machine,
+                                    lclex_primitive_t primitive,
+                                    size_t base, uint64_t *pn) {
+    uint64_t args[LCLEX_MAX_PRIMITIVE_ARITY] = { 0 };
+    size_t arity = lclex_primitive_arity(primitive);
+
+    if (machine->size - base < arity) {
+        return false;
+    }
+
+    for (size_t i = 0; i < arity; i++) {
+        lclex_closure_t *arg = &machine->stack[machine->size - i - 1];
+
+        if (arg->term == NULL
+            || !lclex_fold_numeral(arg->term, arg->env, lclex_krivine_lookup,
+                                   &args[i])) {
+            return false;
+        }
+    }
+
+    if (!lclex_apply_primitive(primitive, args, pn)) {
+        return false;
+    }
+
+    machine->size -= arity;
+    return true;
+}
+
+void lclex_krivine_whnf(lclex_krivine_t *machine, lclex_closure_t *closure,
+                        size_t base) {
+    lclex_node_t *term = closure->term;
+    lclex_env_t *env = closure->env;
+    lclex_env_t *cell;
+    lclex_node_t *arg;
+    uint64_t n;
+
+    while (term != NULL) {
+        switch (term->type) {
+            case LCLEX_APPLICATION:
+                arg = term->right;
+
+                /* Pushing the closure a variable refers to, rather than the
+                   variable, keeps chains of indirections from forming. */
+                if (arg->type == LCLEX_BOUND_VARIABLE) {
+                    cell = lclex_lookup_env(machine, env, arg->data.index);
+                    lclex_push_closure(machine, cell->term, cell->env);
+                } else {
+                    lclex_push_closure(machine, arg, env);
+                }
+                term = term->left;
+                break;
+
+            case LCLEX_ABSTRACTION:
+                if (machine->size == base) {
+                    closure->term = term;
+                    closure->env = env;
+                    return;
+                }
+
+                machine->size--;
+                env = lclex_new_env(machine, machine->stack[machine->size].term,
+                                    machine->stack[machine->size].env, env);
+                term = term->left;
+                machine->stats.steps++;
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+                closure->term = term;
+                closure->env = env;
+                return;
+
+            case LCLEX_BOUND_VARIABLE:
+                cell = lclex_lookup_env(machine, env, term->data.index);
+                term = cell->term;
+                env = cell->env;
+                break;
+
+            case LCLEX_NUMERAL:
+                if (machine->size == base) {
+                    closure->term = term;
+                    closure->env = env;
+                    return;
+                }
+
+                term = lclex_expand_node(term);
+                break;
+
+            /* Definitions are never written to, so they are used as is. */
+            case LCLEX_PRIMITIVE:
+                if (lclex_krivine_primitive(machine, term->data.primitive,
+                                            base, &n)) {
+                    term = lclex_new_numeral(n);
+                    env = NULL;
+                } else {
+                    term = lclex_primitive_defs[term->data.primitive];
+                }
+                break;
+        }
+    }
+
+    /* A variable bound during read back, its depth is kept in env. */
+    closure->term = NULL;
+    closure->env = env;
+}
+
+lclex_node_t *lclex_krivine_read_back(lclex_krivine_t *machine,
+                                      lclex_node_t *term, lclex_env_t *env,
+                                      size_t depth) {
+    lclex_node_t *root = NULL;
+    lclex_node_t **slot = &root;
+    lclex_closure_t closure = {
+        .term = term,
+        .env = env
+    };
+
+    /* Bodies of abstractions and last arguments are read back in place 
+       through slot, so only the other arguments recurse. */
+    while (slot != NULL) {
+        size_t base = machine->size;
+        lclex_node_t *node;
+
+        lclex_krivine_whnf(machine, &closure, base);
+
+        if (closure.term != NULL 
+            && closure.term->type == LCLEX_ABSTRACTION) {
+            node = lclex_new_abstraction(closure.term->data.symbol, NULL);
+            *slot = node;
+            slot = &node->left;
+
+            closure.env = lclex_new_env(machine, NULL, (lclex_env_t *)depth, 
+                                        closure.env);
+            closure.term = closure.term->left;
+            depth++;
+            continue;
+        }
+
+        if (closure.term == NULL) {
+            size_t level = (size_t)(closure.env);
+            node = lclex_new_bound_variable(depth - level - 1);
+        } else if (closure.term->type == LCLEX_NUMERAL) {
+            node = lclex_new_numeral(closure.term->data.number);
+        } else {
+            node = lclex_new_free_variable(closure.term->data.symbol);
+        }
+
+        /* The arguments of a neutral term lie on the stack above base, 
+           with the first argument on top. */
+        for (size_t i = machine->size; i > base + 1; i--) {
+            lclex_closure_t arg = machine->stack[i - 1];
+            lclex_node_t *right = lclex_krivine_read_back(machine, arg.term,
+                                                          arg.env, depth);
+            node = lclex_new_application(node, right);
+        }
+
+        if (machine->size > base) {
+            closure = machine->stack[base];
+            node = lclex_new_application(node, NULL);
+            *slot = node;
+            slot = &node->right;
+        } else {
+            *slot = node;
+            slot = NULL;
+        }
+        machine->size = base;
+    }
+
+    return root;
+}
+
+void lclex_krivine_reduce_expression(lclex_krivine_t *machine,
+                                     lclex_node_t **pexpr) {
+    lclex_node_t *expr = *pexpr;
+
+    *pexpr = lclex_krivine_read_back(machine, expr, NULL, 0);
+    lclex_free_node(expr);
+}
+
+void lclex_write_krivine_stats(lclex_krivine_t *machine, FILE *stream) {
+    fprintf(stream, "> krivine: %ld steps, %ld lookups, %ld env cells, "
+            "%ld max stack\n",
+            machine->stats.steps, machine->stats.lookups,
+            machine->stats.cells, machine->stats.max_stack);
+}
@@ -2,8 +2,14 @@
 
 #include "tree.h"
 #include "parser.h"
+#include "engine.h"
+#include "stats.h"
+#include "image.h"
+#include "source.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <unistd.h>
 
@@ -12,14 +18,424 @@ typedef struct {
     bool show_reductions;
     bool show_parsed;
     bool hide_results;
+    bool show_stats;
+    bool json_stats;
+    lclex_engine_type_t engine;
+    size_t jobs;
+    char *source_file;
+    char *batch_file;
+    char *image_file;
+    char *compile_file;
+    bool memoize;
+    bool normalize_defs;
+    lclex_cache_t *cache;
+    lclex_parallel_t *parallel;
 } lclex_options_t;
 
+/* An expression to reduce, or a statement that failed to parse, whose
+   errors are the text from error_start to error_end of the errors of 
+   the batch. Expr is NULL if there is nothing to reduce. */
+typedef struct {
+    lclex_node_t *expr;
+    lclex_statement_stats_t stats;
+    char *output;
+    size_t size;
+    size_t error_start;
+    size_t error_end;
+} lclex_batch_job_t;
+
+/* Statements of a batch file, parsed in order and then claimed by the 
+   workers through next. Output is collected per expression and written
+   in input order once all are reduced, with the syntax errors held 
+   back in errors until their statement is reached. */
+typedef struct {
+    lclex_batch_job_t *jobs;
+    size_t n_jobs;
+    size_t cap;
+    size_t next;
+    lclex_options_t *opts;
+    char *errors;
+} lclex_batch_t;
+
+typedef struct {
+    lclex_batch_t *batch;
+    pthread_t thread;
+    lclex_arena_t arena;
+} lclex_batch_worker_t;
+
 void lclex_help(char *argv[]) {
-    fprintf(stderr, "Usage: %s [-nrph]\n", argv[0]);
+    fprintf(stderr, "Usage: %s [-nrpPhsJcmd] [-e engine] [-j jobs] [-f file] "
+            "[-b file] [-i image] [-C image]\n", argv[0]);
     fprintf(stderr, "    -n: show numbers\n");
-    fprintf(stderr, "    -r: show reductions\n");
+    fprintf(stderr, "    -r: show reductions, with the rewrite, hashcons "
+            "and pool engines\n");
     fprintf(stderr, "    -p: show parsed expression\n");
+    fprintf(stderr, "    -P: print with only the brackets needed\n");
     fprintf(stderr, "    -h: hide result expression\n");
+    fprintf(stderr, "    -s: show statistics\n");
+    fprintf(stderr, "    -J: show statistics as JSON lines\n");
+    fprintf(stderr, "    -c: hash-cons terms, same as -e hashcons\n");
+    fprintf(stderr, "    -m: cache the normal forms of expressions\n");
+    fprintf(stderr, "    -d: normalize definitions when they are made, "
+            "implies -m\n");
+    fprintf(stderr, "    -e: reduction engine, one of:");
+    for (size_t i = 0; i < LCLEX_N_ENGINES; i++) {
+        fprintf(stderr, " %s", lclex_engine_name(i));
+    }
+    fprintf(stderr, "\n");
+    fprintf(stderr, "    -j: worker threads for the rewrite engine, or for "
+            "expressions with -b\n");
+    fprintf(stderr, "    -f: run the statements in file, indented lines "
+            "continue a statement\n");
+    fprintf(stderr, "    -b: evaluate the statements in file, - for stdin\n");
+    fprintf(stderr, "    -i: load the definitions from image instead of "
+            "the standard ones\n");
+    fprintf(stderr, "    -C: compile the definitions into image and exit\n");
+}
+
+/* Reduces expr and writes what was asked for to stream, with the 
+   statistics of the arena it was reduced in. The caller sets the index
+   and parse time of stats, the remaining phases are timed here. The 
+   rewrite engine runs on the workers of parallel unless it is NULL. */
+void lclex_evaluate(lclex_node_t *expr, lclex_options_t *opts, 
+                    lclex_parallel_t *parallel, lclex_arena_t *arena, 
+                    lclex_statement_stats_t *stats, FILE *stream) {
+    lclex_tree_counters_t counters = lclex_tree_counters;
+    lclex_cache_entry_t *entry = NULL;
+    lclex_node_t *normal = NULL;
+    uint64_t start = lclex_clock();
+
+    if (opts->show_parsed) {
+        lclex_write_node(expr, stream);
+    }
+
+    stats->time[LCLEX_PHASE_PRINT] = lclex_clock() - start;
+
+    lclex_engine_t engine;
+    lclex_init_engine(&engine, opts->engine, parallel);
+
+    start = lclex_clock();
+    if (opts->cache != NULL) {
+        normal = lclex_cache_lookup(opts->cache, expr, &entry);
+    }
+
+    if (normal != NULL) {
+        expr = normal;
+    } else {
+        lclex_engine_reduce(&engine, &expr, UINT64_MAX, 
+                            opts->show_reductions);
+    }
+
+    if (entry != NULL) {
+        lclex_cache_insert(opts->cache, entry, expr);
+    }
+    stats->time[LCLEX_PHASE_REDUCE] = lclex_clock() - start;
+
+    stats->engine = lclex_engine_name(opts->engine);
+    stats->steps = lclex_engine_steps(&engine);
+    lclex_tree_counters_since(&stats->counters, &counters);
+    
+    start = lclex_clock();
+    if (!opts->hide_results) {
+        fprintf(stream, "> ");
+        lclex_write_node(expr, stream);
+    }
+    stats->time[LCLEX_PHASE_PRINT] += lclex_clock() - start;
+    
+    start = lclex_clock();
+    if (opts->show_numbers) {
+        uint64_t n = lclex_church_decode(expr);
+        stats->time[LCLEX_PHASE_DECODE] = lclex_clock() - start;
+
+        if (n == UINT64_MAX) {
+            fprintf(stream, "> nan\n");
+        } else {
+            fprintf(stream, "> %ld\n", n);
+        }
+    } else {
+        stats->time[LCLEX_PHASE_DECODE] = 0;
+    }
+
+    lclex_finish_statement_stats(stats, arena);
+
+    stats->use_cache = opts->cache != NULL;
+    if (stats->use_cache) {
+        lclex_cache_stats(opts->cache, &stats->cache);
+    }
+
+    if (opts->show_stats) {
+        lclex_write_arena_stats(arena, stream);
+        lclex_write_engine_stats(&engine, expr, stream);
+        lclex_write_statement_stats(stats, stream);
+    }
+
+    if (opts->json_stats) {
+        lclex_write_statement_json(stats, stream);
+    }
+
+    lclex_destruct_engine(&engine);
+
+    if (normal != NULL) {
+        lclex_free_node(normal);
+    }
+}
+
+void *lclex_run_batch_worker(void *data) {
+    lclex_batch_worker_t *worker = data;
+    lclex_batch_t *batch = worker->batch;
+    size_t i;
+
+    lclex_use_arena(&worker->arena);
+
+    while ((i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) 
+           < batch->n_jobs) {
+        lclex_batch_job_t *job = &batch->jobs[i];
+        if (job->expr == NULL) {
+            continue;
+        }
+
+        FILE *stream = open_memstream(&job->output, &job->size);
+
+        lclex_evaluate(job->expr, batch->opts, NULL, &worker->arena, 
+                       &job->stats, stream);
+        fclose(stream);
+
+        lclex_reset_arena(&worker->arena);
+    }
+
+    return NULL;
+}
+
+/* Writes the syntax errors of a statement of the batch, after what was
+   written to stdout before it. */
+static void lclex_write_batch_errors(lclex_batch_t *batch, 
+                                     lclex_batch_job_t *job) {
+    if (job->error_end == job->error_start) {
+        return;
+    }
+
+    fflush(stdout);
+    fwrite(batch->errors + job->error_start, 1, 
+           job->error_end - job->error_start, stderr);
+}
+
+/* Skips the blanks before a statement of len characters and takes them
+   off len, NULL if there is nothing else. */
+static char *lclex_skip_blank_statement(char *text, size_t *len) {
+    while (*len > 0 && (*text == ' ' || *text == '\t' || *text == '\r'
+                        || *text == '\n')) {
+        text++;
+        (*len)--;
+    }
+
+    return *len == 0 ? NULL : text;
+}
+
+/* Runs the statements of a source file in order, one by one as if they
+   were entered. Returns LCLEX_PARSER_EXIT if the file could not be opened
+   or one of its statements is exit, and sets *opened to whether it could
+   be opened. */
+lclex_parser_signal_t lclex_run_source(char *path, lclex_options_t *opts,
+                                       lclex_hashmap_t *defs,
+                                       lclex_operator_table_t *opdefs,
+                                       lclex_arena_t *def_arena,
+                                       lclex_arena_t *stmt_arena,
+                                       lclex_statement_stats_t *stats,
+                                       bool *opened) {
+    lclex_parser_signal_t sig = LCLEX_PARSER_SUCCESS;
+    lclex_source_t source;
+    char *text;
+    size_t len;
+
+    *opened = lclex_open_source(&source, path);
+
+    if (!*opened) {
+        return LCLEX_PARSER_EXIT;
+    }
+
+    while (sig != LCLEX_PARSER_EXIT
+           && (text = lclex_next_statement(&source, &len)) != NULL) {
+        lclex_node_t *expr;
+
+        text = lclex_skip_blank_statement(text, &len);
+        if (text == NULL) {
+            continue;
+        }
+
+        uint64_t start = lclex_clock();
+        sig = lclex_parse_statement(&text, len, defs, opdefs, def_arena, 
+                                    opts->cache, &expr);
+        stats->time[LCLEX_PHASE_PARSE] = lclex_clock() - start;
+
+        if (sig == LCLEX_PARSER_FAILURE) {
+            fprintf(stderr, "Error: in the statement on line %zu of '%s'\n",
+                    source.line, path);
+        }
+
+        if (expr != NULL) {
+            stats->index++;
+            lclex_evaluate(expr, opts, opts->parallel, stmt_arena, stats, 
+                           stdout);
+        }
+
+        lclex_reset_arena(stmt_arena);
+    }
+
+    lclex_close_source(&source);
+
+    return sig;
+}
+
+/* Runs the definitions of a file in order while parsing its expressions,
+   then reduces the expressions on the given number of workers. Shown 
+   reductions are only in order on a single worker, which then writes
+   straight to stdout. Expressions are parsed into the current arena. A
+   file is mapped and split like with -f, stdin is read line by line. */
+void lclex_run_batch(char *path, lclex_options_t *opts, lclex_hashmap_t *defs,
+                     lclex_operator_table_t *opdefs, 
+                     lclex_arena_t *def_arena) {
+    lclex_parser_signal_t sig = LCLEX_PARSER_SUCCESS;
+    size_t n_workers = opts->show_reductions ? 1 : opts->jobs;
+    bool use_stdin = strcmp(path, "-") == 0;
+
+    lclex_source_t source;
+    if (!use_stdin && !lclex_open_source(&source, path)) {
+        return;
+    }
+
+    lclex_string_buf_t buf;
+    lclex_init_string_buf(&buf);
+
+    lclex_batch_t batch = {
+        .jobs = malloc(LCLEX_STACK_INIT_SIZE * sizeof(lclex_batch_job_t)),
+        .n_jobs = 0,
+        .cap = LCLEX_STACK_INIT_SIZE,
+        .next = 0,
+        .opts = opts,
+        .errors = NULL
+    };
+
+    size_t errors_size, n_exprs = 0, line = 0;
+    FILE *errors = open_memstream(&batch.errors, &errors_size);
+    lclex_parser_errors = errors;
+
+    while (sig != LCLEX_PARSER_EXIT) {
+        char *text;
+        size_t len;
+        lclex_node_t *expr;
+
+        if (use_stdin) {
+            lclex_readline(&buf, stdin);
+            if (buf.len == 0 && feof(stdin)) {
+                break;
+            }
+            text = buf.str;
+            len = buf.len;
+            line++;
+        } else if ((text = lclex_next_statement(&source, &len)) == NULL) {
+            break;
+        } else {
+            line = source.line;
+        }
+
+        text = lclex_skip_blank_statement(text, &len);
+        if (text == NULL) {
+            continue;
+        }
+
+        size_t error_start = ftell(errors);
+        uint64_t start = lclex_clock();
+        sig = lclex_parse_statement(&text, len, defs, opdefs, def_arena, 
+                                    opts->cache, &expr);
+        uint64_t parse_time = lclex_clock() - start;
+
+        if (sig == LCLEX_PARSER_FAILURE) {
+            fprintf(errors, "Error: in the statement on line %zu of '%s'\n",
+                    line, path);
+        }
+
+        if (expr == NULL && sig != LCLEX_PARSER_FAILURE) {
+            continue;
+        }
+
+        if (batch.n_jobs == batch.cap) {
+            batch.cap *= 2;
+            batch.jobs = realloc(batch.jobs, 
+                                 batch.cap * sizeof(lclex_batch_job_t));
+        }
+        if (expr != NULL) {
+            n_exprs++;
+        }
+        batch.jobs[batch.n_jobs].expr = expr;
+        batch.jobs[batch.n_jobs].stats.index = n_exprs;
+        batch.jobs[batch.n_jobs].stats.time[LCLEX_PHASE_PARSE] = parse_time;
+        batch.jobs[batch.n_jobs].output = NULL;
+        batch.jobs[batch.n_jobs].size = 0;
+        batch.jobs[batch.n_jobs].error_start = error_start;
+        batch.jobs[batch.n_jobs].error_end = ftell(errors);
+        batch.n_jobs++;
+    }
+
+    lclex_parser_errors = NULL;
+    fclose(errors);
+
+    lclex_batch_worker_t *workers = malloc(n_workers 
+                                           * sizeof(lclex_batch_worker_t));
+
+    for (size_t i = 0; i < n_workers; i++) {
+        workers[i].batch = &batch;
+        lclex_init_arena(&workers[i].arena);
+    }
+
+    lclex_arena_t *prev_arena = lclex_current_arena;
+
+    if (n_workers == 1) {
+        lclex_use_arena(&workers[0].arena);
+
+        for (size_t i = 0; i < batch.n_jobs; i++) {
+            lclex_write_batch_errors(&batch, &batch.jobs[i]);
+            if (batch.jobs[i].expr == NULL) {
+                continue;
+            }
+
+            lclex_evaluate(batch.jobs[i].expr, opts, NULL, 
+                           &workers[0].arena, &batch.jobs[i].stats, stdout);
+            lclex_reset_arena(&workers[0].arena);
+        }
+    } else {
+        for (size_t i = 1; i < n_workers; i++) {
+            pthread_create(&workers[i].thread, NULL, lclex_run_batch_worker,
+                           &workers[i]);
+        }
+
+        lclex_run_batch_worker(&workers[0]);
+
+        for (size_t i = 1; i < n_workers; i++) {
+            pthread_join(workers[i].thread, NULL);
+        }
+
+        for (size_t i = 0; i < batch.n_jobs; i++) {
+            lclex_write_batch_errors(&batch, &batch.jobs[i]);
+            fwrite(batch.jobs[i].output, 1, batch.jobs[i].size, stdout);
+            free(batch.jobs[i].output);
+        }
+    }
+
+    lclex_use_arena(prev_arena);
+
+    for (size_t i = 0; i < n_workers; i++) {
+        lclex_destruct_arena(&workers[i].arena);
+    }
+
+    free(workers);
+    free(batch.jobs);
+    free(batch.errors);
+    lclex_destruct_string_buf(&buf);
+
+    /* Expressions point into the mapping until they are reduced. */
+    if (!use_stdin) {
+        lclex_close_source(&source);
+    }
 }
 
 char *std_exprs[] = {
@@ -47,11 +463,24 @@ int main(int argc, char *argv[]) {
     lclex_options_t opts = {
         .show_numbers = false,
         .show_reductions = false,
-        .hide_results = false
+        .hide_results = false,
+        .show_stats = false,
+        .json_stats = false,
+        .engine = LCLEX_ENGINE_REWRITE,
+        .jobs = 1,
+        .source_file = NULL,
+        .batch_file = NULL,
+        .image_file = NULL,
+        .compile_file = NULL,
+        .memoize = false,
+        .normalize_defs = false,
+        .cache = NULL,
+        .parallel = NULL
     };
 
     int opt;
-    while ((opt = getopt(argc, argv, "nrph")) != -1) {
+    char *end;
+    while ((opt = getopt(argc, argv, "nrpPhsJcmde:j:f:b:i:C:")) != -1) {
         switch (opt) {
             case 'n':
                 opts.show_numbers = true;
@@ -65,9 +494,65 @@ int main(int argc, char *argv[]) {
                 opts.show_parsed = true;
                 break;
 
+            case 'P':
+                lclex_print_minimal = true;
+                break;
+
             case 'h':
                 opts.hide_results = true;
                 break;
+
+            case 's':
+                opts.show_stats = true;
+                break;
+
+            case 'J':
+                opts.json_stats = true;
+                break;
+
+            case 'c':
+                opts.engine = LCLEX_ENGINE_HASHCONS;
+                break;
+
+            case 'm':
+                opts.memoize = true;
+                break;
+
+            case 'd':
+                opts.memoize = true;
+                opts.normalize_defs = true;
+                break;
+
+            case 'e':
+                if (!lclex_parse_engine(optarg, &opts.engine)) {
+                    return 1;
+                }
+                break;
+
+            case 'j':
+                opts.jobs = strtoul(optarg, &end, 10);
+                if (*end != '\0' || opts.jobs < 1) {
+                    fprintf(stderr, "Error: invalid number of jobs '%s'\n",
+                            optarg);
+                    return 1;
+                }
+                break;
+
+            case 'f':
+                opts.source_file = optarg;
+                break;
+
+            case 'b':
+                opts.batch_file = optarg;
+                break;
+
+            case 'i':
+                opts.image_file = optarg;
+                break;
+
+            case 'C':
+                opts.compile_file = optarg;
+                break;
             
             case '?':
                 lclex_help(argv);
@@ -78,23 +563,64 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (opts.show_reductions && !lclex_engine_shows_reductions(opts.engine)) {
+        fprintf(stderr, "Error: the %s engine cannot show reductions\n",
+                lclex_engine_name(opts.engine));
+        return 1;
+    }
+
     lclex_string_buf_t buf;
     lclex_init_string_buf(&buf);
 
+    lclex_init_symbols();
+
+    lclex_arena_t def_arena, stmt_arena;
+    lclex_init_arena(&def_arena);
+    lclex_init_arena(&stmt_arena);
+    lclex_use_arena(&stmt_arena);
+
     lclex_hashmap_t defs;
     lclex_init_string_hashmap(&defs, lclex_free_node);
 
-    lclex_operator_level_t opdefs[LCLEX_N_OPERATOR_LEVELS];
-    lclex_init_operator_levels(opdefs);
+    lclex_operator_table_t opdefs;
+    lclex_init_operator_table(&opdefs);
+
+    lclex_cache_t cache;
+    if (opts.memoize) {
+        lclex_init_cache(&cache, opts.normalize_defs);
+        opts.cache = &cache;
+    }
+
+    /* The workers of the rewrite engine are started once for the session
+       rather than for each statement. A batch file spends the jobs on
+       its expressions instead, so only -f and the REPL need them. */
+    lclex_parallel_t parallel;
+    if (opts.jobs > 1 && opts.engine == LCLEX_ENGINE_REWRITE
+        && (opts.batch_file == NULL || opts.source_file != NULL)) {
+        lclex_init_parallel(&parallel, opts.jobs);
+        opts.parallel = &parallel;
+    }
 
     lclex_parser_signal_t sig = LCLEX_PARSER_SUCCESS;
 
-    for (size_t i = 0; i < sizeof(std_exprs) / sizeof(*std_exprs); i++) {
-        char *command = lclex_strdup(std_exprs[i]);
-        char *text = command;
+    lclex_image_t image = { .data = NULL, .size = 0 };
+    size_t n_std_exprs = sizeof(std_exprs) / sizeof(*std_exprs);
+
+    if (opts.image_file != NULL) {
+        n_std_exprs = 0;
+        if (!lclex_load_image(&image, opts.image_file, &defs, &opdefs)) {
+            sig = LCLEX_PARSER_EXIT;
+        } else if (opts.cache != NULL) {
+            lclex_cache_add_roots(opts.cache, &defs);
+        }
+    }
+
+    for (size_t i = 0; i < n_std_exprs; i++) {
+        char *text = std_exprs[i];
         lclex_node_t *expr;
 
-        sig = lclex_parse_statement(&text, &defs, opdefs, &expr);
+        sig = lclex_parse_statement(&text, strlen(text), &defs, &opdefs, 
+                                    &def_arena, opts.cache, &expr);
 
         if (sig == LCLEX_PARSER_FAILURE) {
             fprintf(stderr, "Error: syntax error in standard expression\n");
@@ -103,11 +629,41 @@ int main(int argc, char *argv[]) {
             break;
         }
 
-        if (expr != NULL) {
-            lclex_free_node(expr);
+        lclex_use_arena(&def_arena);
+        lclex_bind_primitives(&defs);
+        lclex_use_arena(&stmt_arena);
+
+        lclex_reset_arena(&stmt_arena);
+    }
+
+    lclex_statement_stats_t stats = { 0 };
+    /* Whether the image and source loaded; an exit statement in the source
+       file still compiles the definitions before it. */
+    bool loaded = sig != LCLEX_PARSER_EXIT;
+    int status = 0;
+
+    if (opts.source_file != NULL && loaded) {
+        sig = lclex_run_source(opts.source_file, &opts, &defs, &opdefs,
+                               &def_arena, &stmt_arena, &stats, &loaded);
+    }
+
+    if (opts.batch_file != NULL && sig != LCLEX_PARSER_EXIT) {
+        lclex_run_batch(opts.batch_file, &opts, &defs, &opdefs, &def_arena);
+        sig = LCLEX_PARSER_EXIT;
+    }
+
+    /* After the batch file, so that its definitions are compiled too. */
+    if (opts.compile_file != NULL) {
+        FILE *file = loaded ? fopen(opts.compile_file, "wb") : NULL;
+
+        if (file == NULL || !lclex_write_image(file, &defs, &opdefs)
+            || fclose(file) != 0) {
+            fprintf(stderr, "Error: could not write image '%s'\n",
+                    opts.compile_file);
+            status = 1;
         }
 
-        free(command);
+        sig = LCLEX_PARSER_EXIT;
     }
 
     while (sig != LCLEX_PARSER_EXIT) {
@@ -117,38 +673,37 @@ int main(int argc, char *argv[]) {
         char *text = buf.str;
         lclex_node_t *expr;
 
-        sig = lclex_parse_statement(&text, &defs, opdefs, &expr);
+        uint64_t start = lclex_clock();
+        sig = lclex_parse_statement(&text, buf.len, &defs, &opdefs, 
+                                    &def_arena, opts.cache, &expr);
+        stats.time[LCLEX_PHASE_PARSE] = lclex_clock() - start;
 
-        if (expr == NULL) {
-            continue;
+        if (expr != NULL) {
+            stats.index++;
+            lclex_evaluate(expr, &opts, opts.parallel, &stmt_arena, &stats, 
+                           stdout);
         }
+        
+        lclex_reset_arena(&stmt_arena);
+    }
 
-        if (opts.show_parsed) {
-            lclex_write_node(expr, stdout);
-        }
+    lclex_use_arena(&def_arena);
 
-        lclex_reduce_expression(&expr, UINT64_MAX, opts.show_reductions);
-        
-        if (!opts.hide_results) {
-            printf("> ");
-            lclex_write_node(expr, stdout);
-        }
-        
-        if (opts.show_numbers) {
-            uint64_t n = lclex_church_decode(expr);
-            if (n == UINT64_MAX) {
-                printf("> nan\n");
-            } else {
-                printf("> %ld\n", n);
-            }
-        } 
-        
-        lclex_free_node(expr);
+    if (opts.cache != NULL) {
+        lclex_destruct_cache(opts.cache);
+    }
+
+    if (opts.parallel != NULL) {
+        lclex_destruct_parallel(opts.parallel);
     }
 
     lclex_destruct_string_buf(&buf);
     lclex_destruct_hashmap(&defs);
-    lclex_destruct_operator_levels(opdefs);
+    lclex_destruct_operator_table(&opdefs);
+    lclex_unload_image(&image);
+    lclex_destruct_arena(&stmt_arena);
+    lclex_destruct_arena(&def_arena);
+    lclex_destruct_symbols();
 
-    return 0;
+    return status;
 }
@@ -0,0 +1,302 @@
+#include "nbe.h"
+#include <stdlib.h>
+#include <string.h>
+
+void lclex_init_nbe(lclex_nbe_t *nbe) {
+    nbe->stack = malloc(LCLEX_NBE_STACK_INIT_SIZE * sizeof(lclex_thunk_t *));
+    nbe->size = 0;
+    nbe->cap = LCLEX_NBE_STACK_INIT_SIZE;
+    nbe->blocks = NULL;
+
+    memset(&nbe->stats, 0, sizeof(lclex_nbe_stats_t));
+}
+
+void lclex_destruct_nbe(lclex_nbe_t *nbe) {
+    lclex_nbe_block_t *next, *block = nbe->blocks;
+
+    while (block != NULL) {
+        next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(nbe->stack);
+}
+
+void *lclex_nbe_alloc(lclex_nbe_t *nbe, size_t size) {
+    lclex_nbe_block_t *block = nbe->blocks;
+
+    if (block == NULL || block->used + size > LCLEX_NBE_BLOCK_SIZE) {
+        block = malloc(sizeof(lclex_nbe_block_t) + LCLEX_NBE_BLOCK_SIZE);
+        block->next = nbe->blocks;
+        block->used = 0;
+        nbe->blocks = block;
+        nbe->stats.bytes += LCLEX_NBE_BLOCK_SIZE;
+    }
+
+    void *data = block->data + block->used;
+    block->used += size;
+
+    return data;
+}
+
+static void lclex_push_thunk(lclex_nbe_t *nbe, lclex_thunk_t *thunk) {
+    if (nbe->size == nbe->cap) {
+        nbe->cap *= 2;
+        nbe->stack = realloc(nbe->stack, nbe->cap * sizeof(lclex_thunk_t *));
+    }
+
+    nbe->stack[nbe->size] = thunk;
+    nbe->size++;
+}
+
+static lclex_nbe_list_t *lclex_new_nbe_list(lclex_nbe_t *nbe,
+                                            lclex_thunk_t *thunk,
+                                            lclex_nbe_list_t *next) {
+    lclex_nbe_list_t *list = lclex_nbe_alloc(nbe, sizeof(lclex_nbe_list_t));
+
+    list->thunk = thunk;
+    list->next = next;
+
+    return list;
+}
+
+static lclex_thunk_t *lclex_lookup_thunk(lclex_nbe_list_t *env,
+                                         lclex_bruijn_index_t index) {
+    while (index > 0) {
+        env = env->next;
+        index--;
+    }
+
+    return env->thunk;
+}
+
+lclex_thunk_t *lclex_new_thunk(lclex_nbe_t *nbe, lclex_node_t *term,
+                               lclex_nbe_list_t *env, lclex_value_t *value) {
+    lclex_thunk_t *thunk = lclex_nbe_alloc(nbe, sizeof(lclex_thunk_t));
+
+    thunk->term = term;
+    thunk->env = env;
+    thunk->value = value;
+    nbe->stats.thunks++;
+
+    return thunk;
+}
+
+lclex_value_t *lclex_new_value(lclex_nbe_t *nbe, lclex_value_type_t type,
+                               lclex_node_t *term, lclex_nbe_list_t *env,
+                               lclex_nbe_list_t *spine) {
+    lclex_value_t *value = lclex_nbe_alloc(nbe, sizeof(lclex_value_t));
+
+    value->type = type;
+    value->term = term;
+    value->data.env = env;
+    value->spine = spine;
+    nbe->stats.values++;
+
+    return value;
+}
+
+lclex_value_t *lclex_nbe_force(lclex_nbe_t *nbe, lclex_thunk_t *thunk) {
+    if (thunk->value == NULL) {
+        thunk->value = lclex_nbe_eval(nbe, thunk->term, thunk->env);
+        nbe->stats.forced++;
+    } else {
+        nbe->stats.shared++;
+    }
+
+    return thunk->value;
+}
+
+static lclex_node_t *lclex_nbe_lookup(void **penv,
+                                      lclex_bruijn_index_t index) {
+    lclex_thunk_t *thunk = lclex_lookup_thunk(*penv, index);
+
+    *penv = thunk->env;
+    return thunk->term;
+}
+
+/* Computes primitive natively if the thunks on top of the stack supply 
+   all of its arguments and they fold to numerals. */
+static bool lclex_nbe_primitive(lclex_nbe_t *nbe, lclex_primitive_t primitive,
+                                size_t base, uint64_t *pn) {
+    uint64_t args[LCLEX_MAX_PRIMITIVE_ARITY] = { 0 };
+    size_t arity = lclex_primitive_arity(primitive);
+
+    if (nbe->size - base < arity) {
+        return false;
+    }
+
+    for (size_t i = 0; i < arity; i++) {
+        lclex_thunk_t *thunk = nbe->stack[nbe->size - i - 1];
+
+        if (thunk->term == NULL
+            || !lclex_fold_numeral(thunk->term, thunk->env, 
+                                   lclex_nbe_lookup, &args[i])) {
+            return false;
+        }
+    }
+
+    if (!lclex_apply_primitive(primitive, args, pn)) {
+        return false;
+    }
+
+    nbe->size -= arity;
+    return true;
+}
+
+lclex_value_t *lclex_nbe_eval(lclex_nbe_t *nbe, lclex_node_t *term,
+                              lclex_nbe_list_t *env) {
+    size_t base = nbe->size;
+    lclex_value_t *value = NULL;
+    lclex_thunk_t *thunk;
+    uint64_t n;
+
+    while (true) {
+        switch (term->type) {
+            case LCLEX_APPLICATION:
+                /* A variable argument shares the thunk it is bound to. */
+                if (term->right->type == LCLEX_BOUND_VARIABLE) {
+                    thunk = lclex_lookup_thunk(env, term->right->data.index);
+                } else {
+                    thunk = lclex_new_thunk(nbe, term->right, env, NULL);
+                }
+                lclex_push_thunk(nbe, thunk);
+                term = term->left;
+                continue;
+
+            case LCLEX_ABSTRACTION:
+                if (nbe->size == base) {
+                    return lclex_new_value(nbe, LCLEX_VALUE_CLOSURE, term,
+                                           env, NULL);
+                }
+
+                nbe->size--;
+                env = lclex_new_nbe_list(nbe, nbe->stack[nbe->size], env);
+                term = term->left;
+                nbe->stats.betas++;
+                continue;
+
+            case LCLEX_FREE_VARIABLE:
+                value = lclex_new_value(nbe, LCLEX_VALUE_FREE, term,
+                                        NULL, NULL);
+                break;
+
+            case LCLEX_BOUND_VARIABLE:
+                thunk = lclex_lookup_thunk(env, term->data.index);
+                value = lclex_nbe_force(nbe, thunk);
+                break;
+
+            /* Values only know about closures, so numerals evaluate to
+               their Church encoding. */
+            case LCLEX_NUMERAL:
+                term = lclex_expand_node(term);
+                continue;
+
+            case LCLEX_PRIMITIVE:
+                if (lclex_nbe_primitive(nbe, term->data.primitive, base, &n)) {
+                    term = lclex_new_numeral(n);
+                    env = NULL;
+                } else {
+                    term = lclex_primitive_defs[term->data.primitive];
+                }
+                continue;
+        }
+
+        /* Apply the value to the pending arguments: a neutral term grows
+           its spine, a closure continues with its body. */
+        while (nbe->size > base && value->type != LCLEX_VALUE_CLOSURE) {
+            nbe->size--;
+            value = lclex_new_value(
+                nbe, value->type, value->term, value->data.env,
+                lclex_new_nbe_list(nbe, nbe->stack[nbe->size], value->spine));
+        }
+
+        if (nbe->size == base) {
+            return value;
+        }
+
+        nbe->size--;
+        env = lclex_new_nbe_list(nbe, nbe->stack[nbe->size], value->data.env);
+        term = value->term->left;
+        nbe->stats.betas++;
+    }
+}
+
+lclex_node_t *lclex_nbe_quote(lclex_nbe_t *nbe, lclex_value_t *value,
+                              size_t depth) {
+    lclex_node_t *root = NULL;
+    lclex_node_t **slot = &root;
+
+    /* Bodies of closures and last arguments are quoted in place through
+       slot, so only the other arguments recurse. */
+    while (slot != NULL) {
+        lclex_node_t *node;
+
+        if (value->type == LCLEX_VALUE_CLOSURE) {
+            lclex_value_t *var = lclex_new_value(nbe, LCLEX_VALUE_BOUND,
+                                                 NULL, NULL, NULL);
+            var->data.level = depth;
+            lclex_thunk_t *thunk = lclex_new_thunk(nbe, NULL, NULL, var);
+
+            node = lclex_new_abstraction(value->term->data.symbol, NULL);
+            *slot = node;
+            slot = &node->left;
+
+            value = lclex_nbe_eval(nbe, value->term->left,
+                                   lclex_new_nbe_list(nbe, thunk,
+                                                      value->data.env));
+            depth++;
+            continue;
+        }
+
+        if (value->type == LCLEX_VALUE_BOUND) {
+            node = lclex_new_bound_variable(depth - value->data.level - 1);
+        } else {
+            node = lclex_new_free_variable(value->term->data.symbol);
+        }
+
+        size_t base = nbe->size;
+        for (lclex_nbe_list_t *arg = value->spine; arg != NULL;
+             arg = arg->next) {
+            lclex_push_thunk(nbe, arg->thunk);
+        }
+
+        /* Popping the spine yields the arguments first to last. */
+        while (nbe->size > base + 1) {
+            nbe->size--;
+            lclex_value_t *arg = lclex_nbe_force(nbe, nbe->stack[nbe->size]);
+            node = lclex_new_application(node,
+                                         lclex_nbe_quote(nbe, arg, depth));
+        }
+
+        if (nbe->size > base) {
+            nbe->size--;
+            value = lclex_nbe_force(nbe, nbe->stack[nbe->size]);
+
+            node = lclex_new_application(node, NULL);
+            *slot = node;
+            slot = &node->right;
+        } else {
+            *slot = node;
+            slot = NULL;
+        }
+    }
+
+    return root;
+}
+
+void lclex_nbe_reduce_expression(lclex_nbe_t *nbe, lclex_node_t **pexpr) {
+    lclex_node_t *expr = *pexpr;
+    lclex_value_t *value = lclex_nbe_eval(nbe, expr, NULL);
+
+    *pexpr = lclex_nbe_quote(nbe, value, 0);
+    lclex_free_node(expr);
+}
+
+void lclex_write_nbe_stats(lclex_nbe_t *nbe, FILE *stream) {
+    fprintf(stream, "> nbe: %ld betas, %ld thunks, %ld forced, %ld shared, "
+            "%ld values, %ld bytes\n",
+            nbe->stats.betas, nbe->stats.thunks, nbe->stats.forced,
+            nbe->stats.shared, nbe->stats.values, nbe->stats.bytes);
+}
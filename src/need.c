@@ -0,0 +1,378 @@
+#include "need.h"
+#include <stdlib.h>
+#include <string.h>
+
+void lclex_init_need(lclex_need_t *machine) {
+    machine->stack = malloc(LCLEX_NEED_STACK_INIT_SIZE
+                            * sizeof(lclex_need_frame_t));
+    machine->size = 0;
+    machine->cap = LCLEX_NEED_STACK_INIT_SIZE;
+    machine->blocks = NULL;
+
+    machine->var.type = LCLEX_BOUND_VARIABLE;
+    machine->var.refs = 1;
+    machine->var.scope = 1;
+    machine->var.data.index = 0;
+    machine->var.left = NULL;
+    machine->var.right = NULL;
+
+    memset(&machine->stats, 0, sizeof(lclex_need_stats_t));
+}
+
+void lclex_destruct_need(lclex_need_t *machine) {
+    lclex_need_block_t *next, *block = machine->blocks;
+
+    while (block != NULL) {
+        next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(machine->stack);
+}
+
+void *lclex_need_alloc(lclex_need_t *machine, size_t size) {
+    lclex_need_block_t *block = machine->blocks;
+
+    if (block == NULL || block->used + size > LCLEX_NEED_BLOCK_SIZE) {
+        block = malloc(sizeof(lclex_need_block_t) + LCLEX_NEED_BLOCK_SIZE);
+        block->next = machine->blocks;
+        block->used = 0;
+        machine->blocks = block;
+    }
+
+    void *data = block->data + block->used;
+    block->used += size;
+
+    return data;
+}
+
+lclex_suspension_t *lclex_new_suspension(lclex_need_t *machine,
+                                         lclex_node_t *term,
+                                         lclex_need_env_t *env) {
+    lclex_suspension_t *suspension = lclex_need_alloc(
+        machine, sizeof(lclex_suspension_t));
+
+    suspension->term = term;
+    suspension->env = env;
+    suspension->depth = 0;
+    suspension->evaluated = false;
+    machine->stats.suspensions++;
+
+    return suspension;
+}
+
+lclex_need_env_t *lclex_new_need_env(lclex_need_t *machine,
+                                     lclex_suspension_t *suspension,
+                                     lclex_need_env_t *next) {
+    lclex_need_env_t *env = lclex_need_alloc(machine,
+                                             sizeof(lclex_need_env_t));
+
+    env->suspension = suspension;
+    env->next = next;
+
+    return env;
+}
+
+static void lclex_push_frame(lclex_need_t *machine,
+                             lclex_suspension_t *suspension, bool update) {
+    if (machine->size == machine->cap) {
+        machine->cap *= 2;
+        machine->stack = realloc(machine->stack,
+                                 machine->cap * sizeof(lclex_need_frame_t));
+    }
+
+    machine->stack[machine->size].suspension = suspension;
+    machine->stack[machine->size].update = update;
+    machine->size++;
+
+    if (machine->size > machine->stats.max_stack) {
+        machine->stats.max_stack = machine->size;
+    }
+}
+
+static lclex_suspension_t *lclex_lookup_suspension(lclex_need_env_t *env,
+                                                   lclex_bruijn_index_t index) {
+    while (index > 0) {
+        env = env->next;
+        index--;
+    }
+
+    return env->suspension;
+}
+
+/* Evaluation stopped at a neutral term: head, a free variable, or the read
+   back variable of suspension, applied to the arguments on the stack
+   above base. Every suspension being forced in between is updated with
+   the head applied to the arguments above its marker, built as a term
+   over an environment of those arguments so that they stay shared. The
+   environments are consed from the top of the stack down, so each marker
+   extends the one above it. The markers are then removed, leaving only
+   the arguments. */
+static void lclex_update_neutral(lclex_need_t *machine, lclex_node_t *head,
+                                 lclex_suspension_t *suspension, size_t base) {
+    lclex_need_env_t *env = NULL;
+    size_t size = base;
+    size_t n = 0;
+
+    if (suspension != NULL) {
+        env = lclex_new_need_env(machine, suspension, NULL);
+    }
+
+    for (size_t i = machine->size; i > base; i--) {
+        lclex_need_frame_t *frame = &machine->stack[i - 1];
+        lclex_node_t *term;
+
+        if (!frame->update) {
+            env = lclex_new_need_env(machine, frame->suspension, env);
+            n++;
+            continue;
+        }
+
+        term = head != NULL ? head : lclex_new_bound_variable(n);
+        for (size_t k = n; k > 0; k--) {
+            term = lclex_new_application(term,
+                                         lclex_new_bound_variable(k - 1));
+        }
+
+        frame->suspension->term = term;
+        frame->suspension->env = env;
+        frame->suspension->evaluated = true;
+        machine->stats.updates++;
+    }
+
+    for (size_t i = base; i < machine->size; i++) {
+        if (!machine->stack[i].update) {
+            machine->stack[size] = machine->stack[i];
+            size++;
+        }
+    }
+    machine->size = size;
+}
+
+static lclex_node_t *lclex_need_lookup(void **penv,
+                                       lclex_bruijn_index_t index) {
+    lclex_suspension_t *suspension = lclex_lookup_suspension(*penv, index);
+
+    *penv = suspension->env;
+    return suspension->term;
+}
+
+/* Computes primitive natively if the arguments on top of the stack, with
+   no update marker between them, supply all of its arguments and they 
+   fold to numerals. */
+static bool lclex_need_primitive(lclex_need_t *machine,
+                                 lclex_primitive_t primitive,
+                                 size_t base, uint64_t *pn) {
+    uint64_t args[LCLEX_MAX_PRIMITIVE_ARITY] = { 0 };
+    size_t arity = lclex_primitive_arity(primitive);
+
+    if (machine->size - base < arity) {
+        return false;
+    }
+
+    for (size_t i = 0; i < arity; i++) {
+        lclex_need_frame_t *frame = &machine->stack[machine->size - i - 1];
+
+        if (frame->update || frame->suspension->term == NULL
+            || !lclex_fold_numeral(frame->suspension->term, 
+                                   frame->suspension->env,
+                                   lclex_need_lookup, &args[i])) {
+            return false;
+        }
+    }
+
+    if (!lclex_apply_primitive(primitive, args, pn)) {
+        return false;
+    }
+
+    machine->size -= arity;
+    return true;
+}
+
+void lclex_need_whnf(lclex_need_t *machine, lclex_node_t **pterm,
+                     lclex_need_env_t **penv, size_t base) {
+    lclex_node_t *term = *pterm;
+    lclex_need_env_t *env = *penv;
+    lclex_suspension_t *suspension;
+    lclex_need_frame_t *top;
+    uint64_t n;
+
+    while (true) {
+        switch (term->type) {
+            case LCLEX_APPLICATION:
+                /* A variable argument shares the suspension it refers to. */
+                if (term->right->type == LCLEX_BOUND_VARIABLE) {
+                    suspension = lclex_lookup_suspension(
+                        env, term->right->data.index);
+                } else {
+                    suspension = lclex_new_suspension(machine, term->right,
+                                                      env);
+                }
+                lclex_push_frame(machine, suspension, false);
+                term = term->left;
+                break;
+
+            case LCLEX_ABSTRACTION:
+                if (machine->size == base) {
+                    *pterm = term;
+                    *penv = env;
+                    return;
+                }
+
+                top = &machine->stack[machine->size - 1];
+                machine->size--;
+
+                if (top->update) {
+                    top->suspension->term = term;
+                    top->suspension->env = env;
+                    top->suspension->evaluated = true;
+                    machine->stats.updates++;
+                    break;
+                }
+
+                env = lclex_new_need_env(machine, top->suspension, env);
+                term = term->left;
+                machine->stats.betas++;
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+                lclex_update_neutral(machine, term, NULL, base);
+                *pterm = term;
+                *penv = env;
+                return;
+
+            case LCLEX_BOUND_VARIABLE:
+                suspension = lclex_lookup_suspension(env, term->data.index);
+
+                if (suspension->term == NULL) {
+                    lclex_update_neutral(machine, NULL, suspension, base);
+                    *pterm = NULL;
+                    *penv = lclex_new_need_env(machine, suspension, NULL);
+                    return;
+                }
+
+                if (suspension->evaluated) {
+                    machine->stats.shared++;
+                } else {
+                    lclex_push_frame(machine, suspension, true);
+                    machine->stats.forced++;
+                }
+                term = suspension->term;
+                env = suspension->env;
+                break;
+
+            case LCLEX_NUMERAL:
+                if (machine->size == base) {
+                    *pterm = term;
+                    *penv = env;
+                    return;
+                }
+
+                top = &machine->stack[machine->size - 1];
+                if (top->update) {
+                    top->suspension->term = term;
+                    top->suspension->env = env;
+                    top->suspension->evaluated = true;
+                    machine->stats.updates++;
+                    machine->size--;
+                    break;
+                }
+
+                term = lclex_expand_node(term);
+                break;
+
+            case LCLEX_PRIMITIVE:
+                if (lclex_need_primitive(machine, term->data.primitive,
+                                         base, &n)) {
+                    term = lclex_new_numeral(n);
+                    env = NULL;
+                } else {
+                    term = lclex_primitive_defs[term->data.primitive];
+                }
+                break;
+        }
+    }
+}
+
+lclex_node_t *lclex_need_read_back(lclex_need_t *machine, lclex_node_t *term,
+                                   lclex_need_env_t *env, size_t depth) {
+    lclex_node_t *root = NULL;
+    lclex_node_t **slot = &root;
+
+    /* Bodies of abstractions and last arguments are read back in place
+       through slot, so only the other arguments recurse. */
+    while (slot != NULL) {
+        size_t base = machine->size;
+        lclex_suspension_t *suspension;
+        lclex_node_t *node;
+
+        lclex_need_whnf(machine, &term, &env, base);
+
+        if (term != NULL && term->type == LCLEX_ABSTRACTION) {
+            node = lclex_new_abstraction(term->data.symbol, NULL);
+            *slot = node;
+            slot = &node->left;
+
+            suspension = lclex_new_suspension(machine, NULL, NULL);
+            suspension->depth = depth;
+            suspension->evaluated = true;
+
+            env = lclex_new_need_env(machine, suspension, env);
+            term = term->left;
+            depth++;
+            continue;
+        }
+
+        if (term == NULL) {
+            node = lclex_new_bound_variable(
+                depth - env->suspension->depth - 1);
+        } else if (term->type == LCLEX_NUMERAL) {
+            node = lclex_new_numeral(term->data.number);
+        } else {
+            node = lclex_new_free_variable(term->data.symbol);
+        }
+
+        /* The arguments of a neutral term lie on the stack above base,
+           with the first argument on top. Each is read back as a variable
+           bound to its suspension, so forcing it updates the suspension. */
+        for (size_t i = machine->size; i > base + 1; i--) {
+            suspension = machine->stack[i - 1].suspension;
+            lclex_node_t *right = lclex_need_read_back(
+                machine, &machine->var,
+                lclex_new_need_env(machine, suspension, NULL), depth);
+            node = lclex_new_application(node, right);
+        }
+
+        if (machine->size > base) {
+            term = &machine->var;
+            env = lclex_new_need_env(machine, machine->stack[base].suspension,
+                                     NULL);
+            node = lclex_new_application(node, NULL);
+            *slot = node;
+            slot = &node->right;
+        } else {
+            *slot = node;
+            slot = NULL;
+        }
+        machine->size = base;
+    }
+
+    return root;
+}
+
+void lclex_need_reduce_expression(lclex_need_t *machine,
+                                  lclex_node_t **pexpr) {
+    lclex_node_t *expr = *pexpr;
+
+    *pexpr = lclex_need_read_back(machine, expr, NULL, 0);
+    lclex_free_node(expr);
+}
+
+void lclex_write_need_stats(lclex_need_t *machine, FILE *stream) {
+    fprintf(stream, "> need: %ld betas, %ld suspensions, %ld forced, "
+            "%ld updates, %ld shared, %ld max stack\n",
+            machine->stats.betas, machine->stats.suspensions,
+            machine->stats.forced, machine->stats.updates,
+            machine->stats.shared, machine->stats.max_stack);
+}
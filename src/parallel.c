@@ -0,0 +1,312 @@
+#include "parallel.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void *lclex_run_worker_thread(void *data);
+
+void lclex_init_parallel(lclex_parallel_t *parallel, size_t n_workers) {
+    parallel->workers = malloc(n_workers * sizeof(lclex_worker_t));
+    parallel->n_workers = n_workers;
+    parallel->pending = 0;
+    parallel->round = 0;
+    parallel->running = 0;
+    parallel->stop = false;
+
+    pthread_mutex_init(&parallel->lock, NULL);
+    pthread_cond_init(&parallel->start, NULL);
+    pthread_cond_init(&parallel->done, NULL);
+
+    for (size_t i = 0; i < n_workers; i++) {
+        lclex_worker_t *worker = &parallel->workers[i];
+
+        worker->parallel = parallel;
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->tasks = malloc(LCLEX_DEQUE_INIT_SIZE * sizeof(lclex_task_t));
+        worker->top = 0;
+        worker->bottom = 0;
+        worker->cap = LCLEX_DEQUE_INIT_SIZE;
+
+        if (i > 0) {
+            lclex_init_arena(&worker->arena);
+        }
+
+        lclex_init_stack(&worker->cursor.path);
+        lclex_init_stack(&worker->cursor.shared);
+        worker->cursor.spawn = lclex_parallel_spawn;
+        worker->cursor.spawn_data = worker;
+        lclex_init_stack(&worker->stack);
+
+        worker->depth = 0;
+        worker->seed = i + 1;
+        memset(&worker->stats, 0, sizeof(lclex_worker_stats_t));
+    }
+
+    for (size_t i = 1; i < n_workers; i++) {
+        lclex_worker_t *worker = &parallel->workers[i];
+
+        pthread_create(&worker->thread, NULL, lclex_run_worker_thread, 
+                       worker);
+    }
+}
+
+void lclex_destruct_parallel(lclex_parallel_t *parallel) {
+    pthread_mutex_lock(&parallel->lock);
+    parallel->stop = true;
+    pthread_cond_broadcast(&parallel->start);
+    pthread_mutex_unlock(&parallel->lock);
+
+    for (size_t i = 1; i < parallel->n_workers; i++) {
+        pthread_join(parallel->workers[i].thread, NULL);
+    }
+
+    for (size_t i = 0; i < parallel->n_workers; i++) {
+        lclex_worker_t *worker = &parallel->workers[i];
+
+        pthread_mutex_destroy(&worker->lock);
+        free(worker->tasks);
+
+        if (i > 0) {
+            lclex_destruct_arena(&worker->arena);
+        }
+
+        lclex_destruct_cursor(&worker->cursor);
+        lclex_destruct_stack(&worker->stack);
+    }
+
+    pthread_mutex_destroy(&parallel->lock);
+    pthread_cond_destroy(&parallel->start);
+    pthread_cond_destroy(&parallel->done);
+    free(parallel->workers);
+}
+
+static void lclex_push_task(lclex_worker_t *worker, lclex_task_t task) {
+    pthread_mutex_lock(&worker->lock);
+
+    if (worker->bottom == worker->cap) {
+        if (worker->top > 0) {
+            memmove(worker->tasks, worker->tasks + worker->top,
+                    (worker->bottom - worker->top) * sizeof(lclex_task_t));
+            worker->bottom -= worker->top;
+            worker->top = 0;
+        } else {
+            worker->cap *= 2;
+            worker->tasks = realloc(worker->tasks,
+                                    worker->cap * sizeof(lclex_task_t));
+        }
+    }
+
+    worker->tasks[worker->bottom] = task;
+    worker->bottom++;
+
+    pthread_mutex_unlock(&worker->lock);
+}
+
+static bool lclex_pop_task(lclex_worker_t *worker, lclex_task_t *task) {
+    bool found = false;
+
+    pthread_mutex_lock(&worker->lock);
+
+    if (worker->bottom > worker->top) {
+        worker->bottom--;
+        *task = worker->tasks[worker->bottom];
+        found = true;
+    }
+
+    pthread_mutex_unlock(&worker->lock);
+
+    return found;
+}
+
+static bool lclex_steal_task(lclex_worker_t *worker, lclex_task_t *task) {
+    lclex_parallel_t *parallel = worker->parallel;
+    size_t n = parallel->n_workers;
+
+    /* Xorshift, so that thieves do not all start with the same victim. */
+    worker->seed ^= worker->seed << 13;
+    worker->seed ^= worker->seed >> 7;
+    worker->seed ^= worker->seed << 17;
+
+    for (size_t i = 0; i < n; i++) {
+        lclex_worker_t *victim = &parallel->workers[(worker->seed + i) % n];
+        bool found = false;
+
+        if (victim == worker) {
+            continue;
+        }
+
+        pthread_mutex_lock(&victim->lock);
+
+        if (victim->bottom > victim->top) {
+            *task = victim->tasks[victim->top];
+            victim->top++;
+            found = true;
+        }
+
+        pthread_mutex_unlock(&victim->lock);
+
+        if (found) {
+            worker->stats.steals++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void lclex_parallel_spawn(void *data, lclex_node_t **pnode) {
+    lclex_worker_t *worker = data;
+    lclex_task_t task = { pnode, worker->depth };
+
+    __atomic_add_fetch(&worker->parallel->pending, 1, __ATOMIC_RELAXED);
+    lclex_push_task(worker, task);
+}
+
+static void lclex_run_task(lclex_worker_t *worker, lclex_task_t task) {
+    lclex_cursor_t *cursor = &worker->cursor;
+    lclex_node_t **redex;
+
+    lclex_clear_stack(&cursor->path);
+    lclex_clear_stack(&cursor->shared);
+    lclex_push_cursor(cursor, task.pnode);
+
+    worker->depth = task.depth;
+    worker->stats.tasks++;
+
+    while ((redex = lclex_cursor_next_redex(cursor)) != NULL) {
+        lclex_unshare_cursor(cursor);
+        redex = cursor->path.data[cursor->path.size - 1];
+
+        lclex_reduce_redex(redex, &worker->stack);
+        lclex_cursor_contracted(cursor);
+
+        worker->depth++;
+        worker->stats.steps++;
+    }
+
+    if (worker->depth > worker->stats.span) {
+        worker->stats.span = worker->depth;
+    }
+
+    __atomic_sub_fetch(&worker->parallel->pending, 1, __ATOMIC_RELEASE);
+}
+
+static void lclex_run_worker(lclex_worker_t *worker) {
+    lclex_parallel_t *parallel = worker->parallel;
+    lclex_task_t task;
+
+    while (__atomic_load_n(&parallel->pending, __ATOMIC_ACQUIRE) > 0) {
+        if (lclex_pop_task(worker, &task)
+            || lclex_steal_task(worker, &task)) {
+            lclex_run_task(worker, task);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+/* Runs one round of the worker for each reduction until the pool is
+   destructed. The tree counters of the thread only ever hold those of 
+   the current round. */
+static void *lclex_run_worker_thread(void *data) {
+    lclex_worker_t *worker = data;
+    lclex_parallel_t *parallel = worker->parallel;
+    uint64_t round = 0;
+
+    lclex_use_arena(&worker->arena);
+
+    pthread_mutex_lock(&parallel->lock);
+
+    for (;;) {
+        while (parallel->round == round && !parallel->stop) {
+            pthread_cond_wait(&parallel->start, &parallel->lock);
+        }
+        if (parallel->stop) {
+            break;
+        }
+        round = parallel->round;
+        pthread_mutex_unlock(&parallel->lock);
+
+        memset(&lclex_tree_counters, 0, sizeof(lclex_tree_counters_t));
+        lclex_run_worker(worker);
+        worker->counters = lclex_tree_counters;
+
+        pthread_mutex_lock(&parallel->lock);
+        parallel->running--;
+        if (parallel->running == 0) {
+            pthread_cond_signal(&parallel->done);
+        }
+    }
+
+    pthread_mutex_unlock(&parallel->lock);
+
+    return NULL;
+}
+
+/* The nodes of the previous reduction are gone by the time the next one
+   starts, so the arenas of the workers are reset rather than recreated,
+   and their threads are woken up rather than started. */
+void lclex_parallel_reduce_expression(lclex_parallel_t *parallel,
+                                      lclex_node_t **pexpr) {
+    for (size_t i = 0; i < parallel->n_workers; i++) {
+        lclex_worker_t *worker = &parallel->workers[i];
+
+        if (i > 0) {
+            lclex_reset_arena(&worker->arena);
+        }
+
+        worker->depth = 0;
+        memset(&worker->stats, 0, sizeof(lclex_worker_stats_t));
+    }
+
+    lclex_parallel_spawn(parallel->workers, pexpr);
+
+    pthread_mutex_lock(&parallel->lock);
+    parallel->round++;
+    parallel->running = parallel->n_workers - 1;
+    pthread_cond_broadcast(&parallel->start);
+    pthread_mutex_unlock(&parallel->lock);
+
+    lclex_run_worker(parallel->workers);
+
+    pthread_mutex_lock(&parallel->lock);
+    while (parallel->running > 0) {
+        pthread_cond_wait(&parallel->done, &parallel->lock);
+    }
+    pthread_mutex_unlock(&parallel->lock);
+
+    for (size_t i = 1; i < parallel->n_workers; i++) {
+        lclex_worker_t *worker = &parallel->workers[i];
+
+        lclex_tree_counters.visited += worker->counters.visited;
+        lclex_tree_counters.copied += worker->counters.copied;
+        lclex_tree_counters.shifted += worker->counters.shifted;
+        lclex_tree_counters.substituted += worker->counters.substituted;
+    }
+}
+
+void lclex_write_parallel_stats(lclex_parallel_t *parallel, FILE *stream) {
+    lclex_worker_stats_t total = { 0 };
+
+    for (size_t i = 0; i < parallel->n_workers; i++) {
+        lclex_worker_stats_t *stats = &parallel->workers[i].stats;
+
+        total.steps += stats->steps;
+        total.tasks += stats->tasks;
+        total.steals += stats->steals;
+        if (stats->span > total.span) {
+            total.span = stats->span;
+        }
+    }
+
+    fprintf(stream, "> parallel: %ld workers, %ld steps, %ld span, "
+            "%ld tasks, %ld steals\n",
+            parallel->n_workers, total.steps, total.span, total.tasks,
+            total.steals);
+
+    for (size_t i = 0; i < parallel->n_workers; i++) {
+        fprintf(stream, "> worker %ld: %ld steps, %ld tasks\n", i,
+                parallel->workers[i].stats.steps,
+                parallel->workers[i].stats.tasks);
+    }
+}
@@ -5,83 +5,130 @@
 #include <stdlib.h>
 #include <sys/types.h>
 
+#define S LCLEX_CHAR_SPACE
+#define I LCLEX_CHAR_ID_START
+#define D LCLEX_CHAR_DIGIT
+
+/* Classes of the ASCII characters, the bytes above have none. Newlines
+   are spaces, as a statement goes on over the lines that are indented. */
+static const unsigned char lclex_char_classes[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, 0, 0, S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, 0, 0, I, 0, I, I, 0, 0, 0, I, I, 0, I, 0, I,
+    D, D, D, D, D, D, D, D, D, D, 0, 0, I, 0, I, I,
+    0, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    I, I, I, I, I, I, I, I, I, I, I, 0, 0, 0, I, I,
+    0, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    I, I, I, I, I, I, I, I, I, I, I, 0, I, 0, I, 0
+};
+
+#undef S
+#undef I
+#undef D
+
 bool lclex_is_idchar_start(char c) {
-    return isalpha(c) || c == '_' || c == '+' || c == '-' || c == '*' 
-           || c == '/' || c == '%' || c == '^' || c == '&' || c == '#'
-           || c == '|' || c == '~' || c == '?' || c == '<' || c == '>';
+    return lclex_char_classes[(unsigned char)c] & LCLEX_CHAR_ID_START;
 }
 
 bool lclex_is_idchar_continue(char c) {
-    return isdigit(c) || lclex_is_idchar_start(c);
+    return lclex_char_classes[(unsigned char)c] 
+           & (LCLEX_CHAR_ID_START | LCLEX_CHAR_DIGIT);
 }
 
-char *lclex_next_token(lclex_token_t *token, char **text) {
-    static char replaced = '\0';
-
-    char *p = *text;
+void lclex_init_lexer(lclex_lexer_t *lexer, char *text, size_t len) {
+    lexer->pos = text;
+    lexer->end = text + len;
+    lexer->token.data = text;
+    lexer->token.len = 0;
+    lexer->token.type = LCLEX_TOKEN_NULL;
+}
 
-    if (*p == '\0') {
-        *p = replaced;
-        replaced = '\0';
-    }
+/* Reads the token at pos into token and moves pos past it. A character
+   that starts no token gives a null token and is not moved past. Nothing
+   at or after end is read. */
+lclex_tokentype_t lclex_next_token(lclex_lexer_t *lexer) {
+    lclex_token_t *token = &lexer->token;
+    unsigned char *p = (unsigned char *)lexer->pos;
+    unsigned char *end = (unsigned char *)lexer->end;
 
-    while (*p == ' ') {
+    while (p < end && (lclex_char_classes[*p] & LCLEX_CHAR_SPACE)) {
         p++;
     }
 
-    token->data = p;
+    token->data = (char *)p;
 
-    if (lclex_is_idchar_start(*p)) {
+    if (p == end) {
+        token->type = LCLEX_TOKEN_EOF;
+    } else if (lclex_char_classes[*p] & LCLEX_CHAR_ID_START) {
         token->type = LCLEX_TOKEN_IDENTIFIER;
         do {
             p++;
-        } while (lclex_is_idchar_continue(*p));
-    }
-    else if (isdigit(*p)) {
+        } while (p < end && (lclex_char_classes[*p] 
+                             & (LCLEX_CHAR_ID_START | LCLEX_CHAR_DIGIT)));
+    } else if (lclex_char_classes[*p] & LCLEX_CHAR_DIGIT) {
         token->type = LCLEX_TOKEN_INTLIT;
         do {
             p++;
-        } while (isdigit(*p));
-    }
-    else if (*p == '\\' || *p == '(' || *p == ')' || *p == '.' || *p == '=') {
+        } while (p < end && (lclex_char_classes[*p] & LCLEX_CHAR_DIGIT));
+    } else {
         switch (*p) {
             case '\\':
                 token->type = LCLEX_TOKEN_LAMBDA;
+                p++;
                 break;
             
             case '(':
                 token->type = LCLEX_TOKEN_BROPEN;
+                p++;
                 break;
             
             case ')':
                 token->type = LCLEX_TOKEN_BRCLOSE;
+                p++;
                 break;
             
             case '.':
                 token->type = LCLEX_TOKEN_DOT;
+                p++;
                 break;
 
             case '=':
                 token->type = LCLEX_TOKEN_EQUALS;
+                p++;
                 break;
-            
+
             default:
+                token->type = LCLEX_TOKEN_NULL;
                 break;
         }
-        p++;
     }
-    else if (*p == '\0') {
-        token->type = LCLEX_TOKEN_EOF;
-    } else {
-        token->type = LCLEX_TOKEN_NULL;
-        token->data = NULL;
+
+    token->len = (char *)p - token->data;
+    lexer->pos = (char *)p;
+
+    return token->type;
+}
+
+/* The value of an intlit token, saturated like strtoull. The token is
+   not followed by a NUL, so the digits are read up to its length. */
+static uint64_t lclex_token_number(lclex_token_t *token) {
+    uint64_t n = 0;
+
+    for (size_t i = 0; i < token->len; i++) {
+        uint64_t digit = token->data[i] - '0';
+
+        if (n > (UINT64_MAX - digit) / 10) {
+            return UINT64_MAX;
+        }
+        n = n * 10 + digit;
     }
 
-    replaced = *p;
-    *p = '\0';
-    *text = p;
+    return n;
+}
 
-    return token->data;
+bool lclex_token_is(lclex_token_t *token, char *str) {
+    return strncmp(token->data, str, token->len) == 0 
+           && str[token->len] == '\0';
 }
 
 char *lclex_type_string(lclex_tokentype_t type) {
@@ -100,9 +147,15 @@ char *lclex_type_string(lclex_tokentype_t type) {
     return strings[type];
 }
 
+FILE *lclex_parser_errors = NULL;
+
+static FILE *lclex_error_stream(void) {
+    return lclex_parser_errors != NULL ? lclex_parser_errors : stderr;
+}
+
 bool lclex_expect_token(lclex_token_t *token, lclex_tokentype_t expected) {
     if (token->type != expected) {
-        fprintf(stderr, "Error: expected '%s', but got '%s'\n", 
+        fprintf(lclex_error_stream(), "Error: expected '%s', but got '%s'\n", 
                 lclex_type_string(expected), 
                 lclex_type_string(token->type));
         return false;
@@ -117,129 +170,288 @@ lclex_node_t *lclex_new_binary_node(lclex_node_t *func, lclex_node_t *left,
     return lclex_new_application(node2, right);
 }
 
-void lclex_init_operator_levels(lclex_operator_level_t *opdefs) {
+static void lclex_free_operator_def(void *data) {
+    lclex_operator_def_t *def = data;
+
+    free(def->operator);
+    lclex_free_node(def->node);
+    free(def);
+}
+
+void lclex_init_operator_table(lclex_operator_table_t *opdefs) {
+    lclex_init_pointer_hashmap(&opdefs->defs, lclex_free_operator_def);
+
     for (size_t i = 0; i < LCLEX_N_OPERATOR_LEVELS; i++) {
-        opdefs[i].n = 0;
         switch (i + 1) {
             case 0: 
-                opdefs[i].type = LCLEX_OPERATOR_SUFFIX;
+                opdefs->types[i] = LCLEX_OPERATOR_SUFFIX;
                 break;
 
             case 1:
-                opdefs[i].type = LCLEX_OPERATOR_PREFIX;
+                opdefs->types[i] = LCLEX_OPERATOR_PREFIX;
                 break;
 
             case 3:
-                opdefs[i].type = LCLEX_OPERATOR_INFIXR;
+                opdefs->types[i] = LCLEX_OPERATOR_INFIXR;
                 break;
             
             default:
-                opdefs[i].type = LCLEX_OPERATOR_INFIXL;
+                opdefs->types[i] = LCLEX_OPERATOR_INFIXL;
                 break;
         }
     }
 }
 
-void lclex_destruct_operator_levels(lclex_operator_level_t *opdefs) {
-    for (size_t i = 0; i < LCLEX_N_OPERATOR_LEVELS; i++) {
-        lclex_operator_level_t *level_def = &opdefs[i];
-        for (size_t j = 0; j < level_def->n; j++) {
-            free(level_def->defs[j].operator);
-            lclex_free_node(level_def->defs[j].node);
+void lclex_destruct_operator_table(lclex_operator_table_t *opdefs) {
+    lclex_destruct_hashmap(&opdefs->defs);
+}
+
+/* Takes operator and node, and replaces an operator of the same name. */
+void lclex_define_operator(lclex_operator_table_t *opdefs, char *operator,
+                           size_t level, lclex_node_t *node) {
+    lclex_operator_def_t *def = malloc(sizeof(lclex_operator_def_t));
+
+    def->operator = operator;
+    def->level = level;
+    def->node = node;
+
+    lclex_insert_hashmap(&opdefs->defs, 
+                         (void *)(uintptr_t)lclex_intern(operator), def);
+}
+
+lclex_operator_def_t *lclex_lookup_operator(lclex_operator_table_t *opdefs,
+                                            lclex_symbol_t symbol) {
+    return lclex_lookup_hashmap(&opdefs->defs, (void *)(uintptr_t)symbol);
+}
+
+void lclex_init_binder_map(lclex_binder_map_t *binders) {
+    binders->symbols = malloc(LCLEX_BINDERS_INIT_SIZE 
+                              * sizeof(lclex_symbol_t));
+    binders->depths = malloc(LCLEX_BINDERS_INIT_SIZE * sizeof(size_t));
+    binders->size = 0;
+    binders->cap = LCLEX_BINDERS_INIT_SIZE;
+    binders->depth = 0;
+    lclex_init_stack(&binders->shadowed);
+
+    for (size_t i = 0; i < binders->cap; i++) {
+        binders->symbols[i] = LCLEX_NO_SYMBOL;
+    }
+}
+
+void lclex_destruct_binder_map(lclex_binder_map_t *binders) {
+    free(binders->symbols);
+    free(binders->depths);
+    lclex_destruct_stack(&binders->shadowed);
+}
+
+/* The slot of symbol, or the empty slot where it would go. */
+static size_t lclex_binder_slot(lclex_binder_map_t *binders, 
+                                lclex_symbol_t symbol) {
+    size_t mask = binders->cap - 1;
+    size_t idx = lclex_hash_pointer((void *)(uintptr_t)symbol) & mask;
+
+    while (binders->symbols[idx] != LCLEX_NO_SYMBOL 
+           && binders->symbols[idx] != symbol) {
+        idx = (idx + 1) & mask;
+    }
+
+    return idx;
+}
+
+static void lclex_resize_binder_map(lclex_binder_map_t *binders) {
+    lclex_symbol_t *symbols = binders->symbols;
+    size_t *depths = binders->depths;
+    size_t cap = binders->cap;
+
+    binders->cap *= 2;
+    binders->symbols = malloc(binders->cap * sizeof(lclex_symbol_t));
+    binders->depths = malloc(binders->cap * sizeof(size_t));
+
+    for (size_t i = 0; i < binders->cap; i++) {
+        binders->symbols[i] = LCLEX_NO_SYMBOL;
+    }
+
+    for (size_t i = 0; i < cap; i++) {
+        if (symbols[i] != LCLEX_NO_SYMBOL) {
+            size_t idx = lclex_binder_slot(binders, symbols[i]);
+
+            binders->symbols[idx] = symbols[i];
+            binders->depths[idx] = depths[i];
         }
     }
+
+    free(symbols);
+    free(depths);
 }
 
-bool lclex_parse_definition(lclex_token_t *token, char **text, char **key) {
+void lclex_bind(lclex_binder_map_t *binders, lclex_symbol_t symbol) {
+    size_t idx = lclex_binder_slot(binders, symbol);
+
+    if (binders->symbols[idx] == LCLEX_NO_SYMBOL) {
+        binders->symbols[idx] = symbol;
+        binders->depths[idx] = 0;
+        binders->size++;
+    }
+
+    binders->depth++;
+    lclex_push_stack(&binders->shadowed, 
+                     (void *)(uintptr_t)binders->depths[idx]);
+    binders->depths[idx] = binders->depth;
+
+    if (binders->size > LCLEX_HASHMAP_LOAD_FACTOR * binders->cap) {
+        lclex_resize_binder_map(binders);
+    }
+}
+
+/* Closes the innermost binder, which must be of symbol. */
+void lclex_unbind(lclex_binder_map_t *binders, lclex_symbol_t symbol) {
+    size_t idx = lclex_binder_slot(binders, symbol);
+
+    binders->depths[idx] = (uintptr_t)lclex_pop_stack(&binders->shadowed);
+    binders->depth--;
+}
+
+bool lclex_lookup_binder(lclex_binder_map_t *binders, lclex_symbol_t symbol,
+                         size_t *index) {
+    size_t idx = lclex_binder_slot(binders, symbol);
+
+    if (binders->symbols[idx] == LCLEX_NO_SYMBOL 
+        || binders->depths[idx] == 0) {
+        return false;
+    }
+
+    *index = binders->depth - binders->depths[idx];
+
+    return true;
+}
+
+/* The symbol of the current token, which must be an identifier. */
+static lclex_symbol_t lclex_token_symbol(lclex_parser_data_t *parser) {
+    lclex_token_t *token = &parser->lexer.token;
+
+    if (parser->symbol_data != token->data) {
+        parser->symbol = lclex_intern_n(token->data, token->len);
+        parser->symbol_data = token->data;
+    }
+
+    return parser->symbol;
+}
+
+/* Replaces the definitions named after primitives by primitive nodes, 
+   keeping the definitions for them to expand to. Meant to run while the
+   standard definitions are loaded, so that later definitions build on 
+   the primitives while redefinitions by the user replace them. */
+void lclex_bind_primitives(lclex_hashmap_t *defs) {
+    for (size_t i = 0; i < LCLEX_N_PRIMITIVES; i++) {
+        char *name = lclex_primitive_name(i);
+        lclex_node_t *node = lclex_lookup_hashmap(defs, name);
+
+        if (node == NULL || node->type == LCLEX_PRIMITIVE) {
+            continue;
+        }
+
+        /* Keeps the definition alive when its entry is replaced. */
+        node->refs++;
+        lclex_primitive_defs[i] = node;
+
+        lclex_insert_hashmap(defs, lclex_strdup(name), 
+                             lclex_new_primitive(i));
+    }
+}
+
+bool lclex_parse_definition(lclex_lexer_t *lexer, char **key) {
+    lclex_token_t *token = &lexer->token;
+
     if (!lclex_expect_token(token, LCLEX_TOKEN_IDENTIFIER)) {
         return false;
     }
-    *key = lclex_strdup(token->data);
+    *key = lclex_strndup(token->data, token->len);
 
-    lclex_next_token(token, text);
+    lclex_next_token(lexer);
     if (!lclex_expect_token(token, LCLEX_TOKEN_EQUALS)) {
         return false;
     }
 
-    lclex_next_token(token, text);
+    lclex_next_token(lexer);
 
     return true;
 }
 
-bool lclex_parse_operator_definition(lclex_token_t *token, char **text, 
-                                     char **key, size_t *level,
-                                     lclex_operator_level_t opdefs[]) {
+bool lclex_parse_operator_definition(lclex_lexer_t *lexer, char **key, 
+                                     size_t *level) {
+    lclex_token_t *token = &lexer->token;
+
     if (!lclex_expect_token(token, LCLEX_TOKEN_IDENTIFIER)) {
         return false;
     }
-    *key = lclex_strdup(token->data);
+    *key = lclex_strndup(token->data, token->len);
 
-    lclex_next_token(token, text);
+    lclex_next_token(lexer);
     if (!lclex_expect_token(token, LCLEX_TOKEN_INTLIT)) {
         return false;
     }
-    *level = strtoul(token->data, NULL, 10);
+    *level = lclex_token_number(token);
     if (*level < 1 || *level > LCLEX_N_OPERATOR_LEVELS) {
-        fprintf(stderr, "Error: operator level not in range\n");
-        return false;
-    }
-    if (opdefs[*level].n == LCLEX_MAX_OPERATORS_PER_LEVEL) {
-        fprintf(stderr, "Error: operator level is full\n");
+        fprintf(lclex_error_stream(), 
+                "Error: operator level not in range\n");
         return false;
     }
 
-    lclex_next_token(token, text);
+    lclex_next_token(lexer);
     if (!lclex_expect_token(token, LCLEX_TOKEN_EQUALS)) {
         return false;
     }
 
-    lclex_next_token(token, text);
+    lclex_next_token(lexer);
 
     return true;
 }
 
 
-lclex_parser_signal_t lclex_parse_statement(char **text, lclex_hashmap_t *defs, 
-                                            lclex_operator_level_t opdefs[],
+lclex_parser_signal_t lclex_parse_statement(char **text, size_t len,
+                                            lclex_hashmap_t *defs, 
+                                            lclex_operator_table_t *opdefs,
+                                            lclex_arena_t *def_arena,
+                                            lclex_cache_t *cache,
                                             lclex_node_t **pnode) {
     lclex_parser_signal_t sig = LCLEX_PARSER_SUCCESS;
+    lclex_arena_t *prev_arena = NULL;
 
-    lclex_token_t token;
+    lclex_parser_data_t parser = {
+        .symbol_data = NULL,
+        .defs = defs,
+        .opdefs = opdefs
+    };
+    lclex_token_t *token = &parser.lexer.token;
 
-    lclex_next_token(&token, text);
+    lclex_init_lexer(&parser.lexer, *text, len);
+    lclex_next_token(&parser.lexer);
 
     char *key = NULL;
     size_t level = 0;
 
-    if (strcmp(token.data, "def") == 0) {
-        lclex_next_token(&token, text);
-        if (!lclex_parse_definition(&token, text, &key)) {
+    if (lclex_token_is(token, "def")) {
+        prev_arena = lclex_use_arena(def_arena);
+        lclex_next_token(&parser.lexer);
+        if (!lclex_parse_definition(&parser.lexer, &key)) {
             sig = LCLEX_PARSER_FAILURE;
         }
-    } else if (strcmp(token.data, "opdef") == 0) {
-        lclex_next_token(&token, text);
-        if (!lclex_parse_operator_definition(&token, text, &key, 
-                                             &level, opdefs)) {
+    } else if (lclex_token_is(token, "opdef")) {
+        prev_arena = lclex_use_arena(def_arena);
+        lclex_next_token(&parser.lexer);
+        if (!lclex_parse_operator_definition(&parser.lexer, &key, 
+                                             &level)) {
             sig = LCLEX_PARSER_FAILURE;
         }
-    } else if (strcmp(token.data, "exit") == 0) {
-        lclex_next_token(&token, text);
+    } else if (lclex_token_is(token, "exit")) {
+        lclex_next_token(&parser.lexer);
         sig = LCLEX_PARSER_EXIT;
     }
 
     lclex_node_t *node = NULL;
     
     if (sig == LCLEX_PARSER_SUCCESS) {
-        lclex_stack_t stack;
-        lclex_init_stack(&stack);
-
-        lclex_parser_data_t parser = {
-            .stack = &stack,
-            .text = text,
-            .token = &token,
-            .defs = defs,
-            .opdefs = opdefs
-        };
+        lclex_init_binder_map(&parser.binders);
 
         node = lclex_parse_application(&parser);
 
@@ -247,11 +459,13 @@ lclex_parser_signal_t lclex_parse_statement(char **text, lclex_hashmap_t *defs,
             sig = LCLEX_PARSER_FAILURE;
         }
 
-        lclex_destruct_stack(parser.stack);
+        lclex_destruct_binder_map(&parser.binders);
     }
 
+    *text = parser.lexer.pos;
+
     if (sig != LCLEX_PARSER_FAILURE 
-        && !lclex_expect_token(&token, LCLEX_TOKEN_EOF)) {
+        && !lclex_expect_token(token, LCLEX_TOKEN_EOF)) {
         sig = LCLEX_PARSER_FAILURE;
     }
 
@@ -270,24 +484,27 @@ lclex_parser_signal_t lclex_parse_statement(char **text, lclex_hashmap_t *defs,
         } else {
             *pnode = NULL;
             if (level == 0) {
+                if (cache != NULL) {
+                    lclex_cache_define(cache, defs, key, &node);
+                }
                 lclex_insert_hashmap(defs, key, node);
             } else {
-                lclex_operator_level_t *level_def = &opdefs[level - 1];
-
-                level_def->defs[level_def->n].operator = key;
-                level_def->defs[level_def->n].node = node;
-                level_def->n++;
+                lclex_define_operator(opdefs, key, level, node);
             }
         }
     }
+
+    if (prev_arena != NULL) {
+        lclex_use_arena(prev_arena);
+    }
     return sig;
 }
 
 lclex_node_t *lclex_parse_application(lclex_parser_data_t *parser) {
     lclex_node_t *node = NULL; 
     
-    while (parser->token->type != LCLEX_TOKEN_EOF 
-           && parser->token->type != LCLEX_TOKEN_BRCLOSE) {
+    while (parser->lexer.token.type != LCLEX_TOKEN_EOF 
+           && parser->lexer.token.type != LCLEX_TOKEN_BRCLOSE) {
         lclex_node_t *sub = lclex_parse_abstraction(parser);
 
         if (sub == NULL) {
@@ -301,101 +518,84 @@ lclex_node_t *lclex_parse_application(lclex_parser_data_t *parser) {
         if (node == NULL) {
             node = sub;
         } else {
-            node = lclex_new_node(LCLEX_APPLICATION, NULL, node, sub);
+            node = lclex_new_application(node, sub);
         }
     }
 
     if (node == NULL) {
-        printf("Error: expected value\n");
+        fprintf(lclex_error_stream(), "Error: expected value\n");
     }
 
     return node;
 }
 
 lclex_node_t *lclex_parse_abstraction(lclex_parser_data_t *parser) {    
-    if (parser->token->type != LCLEX_TOKEN_LAMBDA) {
+    if (parser->lexer.token.type != LCLEX_TOKEN_LAMBDA) {
         return lclex_parse_body(parser, LCLEX_N_OPERATOR_LEVELS);
     }
 
-    lclex_next_token(parser->token, parser->text);
+    lclex_next_token(&parser->lexer);
 
-    if (!lclex_expect_token(parser->token, LCLEX_TOKEN_IDENTIFIER)) {
+    if (!lclex_expect_token(&parser->lexer.token, LCLEX_TOKEN_IDENTIFIER)) {
         return NULL;
     }
 
-    char *str = lclex_strdup(parser->token->data);
+    lclex_symbol_t symbol = lclex_token_symbol(parser);
 
     lclex_node_t *body;
 
-    lclex_next_token(parser->token, parser->text);
-    lclex_push_stack(parser->stack, str);
+    lclex_next_token(&parser->lexer);
+    lclex_bind(&parser->binders, symbol);
 
-    if (parser->token->type == LCLEX_TOKEN_DOT) {
-        lclex_next_token(parser->token, parser->text);
+    if (parser->lexer.token.type == LCLEX_TOKEN_DOT) {
+        lclex_next_token(&parser->lexer);
         body = lclex_parse_application(parser);
     } else {
         body = lclex_parse_abstraction(parser);
     }
 
-    lclex_pop_stack(parser->stack);
+    lclex_unbind(&parser->binders, symbol);
 
     if (body == NULL) {
         return NULL;
     }
     
-    return lclex_new_node(LCLEX_ABSTRACTION, str, body, NULL);
+    return lclex_new_abstraction(symbol, body);
 }
 
+/* Parses operators of at most level by precedence climbing: the right
+   operand of an operator takes the operators that bind tighter, and for
+   right associative levels those of the same level too. */
 lclex_node_t *lclex_parse_body(lclex_parser_data_t *parser, size_t level) {
-    if (level == 0) {
-        return lclex_parse_value(parser);
-    }
+    lclex_node_t *node = lclex_parse_value(parser);
+    lclex_token_t *token = &parser->lexer.token;
 
-    lclex_operator_level_t *level_def = &parser->opdefs[level - 1];
+    while (node != NULL && token->type == LCLEX_TOKEN_IDENTIFIER) {
+        lclex_operator_def_t *def = lclex_lookup_operator(
+            parser->opdefs, lclex_token_symbol(parser));
 
-    lclex_node_t *node = lclex_parse_body(parser, level - 1);
-    if (node == NULL) {
-        return NULL;
-    }
+        if (def == NULL || def->level > level) {
+            break;
+        }
 
-    lclex_node_t *other = NULL;
-    bool found = true;
-
-    while (found) {
-        found = false;
-
-        for (size_t i = 0; i < level_def->n && !found; i++) {
-            if (strcmp(level_def->defs[i].operator, 
-                       parser->token->data) == 0) {
-                found = true;
-                lclex_next_token(parser->token, parser->text);
-
-                switch (level_def->type) {
-                    case LCLEX_OPERATOR_PREFIX:
-                        break;
-
-                    case LCLEX_OPERATOR_INFIXR:
-                        other = lclex_parse_body(parser, level);
-                        if (other == NULL) {
-                            lclex_free_node(node);
-                        }
-                        return lclex_new_binary_node(level_def->defs[i].node, 
-                                                     node, other);
-
-                    case LCLEX_OPERATOR_INFIXL:
-                        other = lclex_parse_body(parser, level - 1);
-                        if (other == NULL) {
-                            lclex_free_node(node);
-                        }
-                        node = lclex_new_binary_node(level_def->defs[i].node, 
-                                                     node, other);
-                        break;
-                    
-                    case LCLEX_OPERATOR_SUFFIX:
-                        break;
-                }
-            }
+        lclex_operator_type_t type = parser->opdefs->types[def->level - 1];
+        lclex_node_t *other;
+
+        lclex_next_token(&parser->lexer);
+
+        /* Only infix operators are applied, others are skipped. */
+        if (type != LCLEX_OPERATOR_INFIXL && type != LCLEX_OPERATOR_INFIXR) {
+            continue;
         }
+
+        other = lclex_parse_body(parser, type == LCLEX_OPERATOR_INFIXR 
+                                         ? def->level : def->level - 1);
+        if (other == NULL) {
+            lclex_free_node(node);
+            return NULL;
+        }
+
+        node = lclex_new_binary_node(def->node, node, other);
     }
 
     return node;
@@ -404,8 +604,8 @@ lclex_node_t *lclex_parse_body(lclex_parser_data_t *parser, size_t level) {
 lclex_node_t *lclex_parse_value(lclex_parser_data_t *parser) {
     lclex_node_t *node, *def_node;
     
-    if (parser->token->type == LCLEX_TOKEN_BROPEN) {
-        lclex_next_token(parser->token, parser->text);
+    if (parser->lexer.token.type == LCLEX_TOKEN_BROPEN) {
+        lclex_next_token(&parser->lexer);
 
         node = lclex_parse_application(parser);
         
@@ -413,46 +613,45 @@ lclex_node_t *lclex_parse_value(lclex_parser_data_t *parser) {
             return NULL;
         }
 
-        if (!lclex_expect_token(parser->token, LCLEX_TOKEN_BRCLOSE)) {
+        if (!lclex_expect_token(&parser->lexer.token, LCLEX_TOKEN_BRCLOSE)) {
             return NULL;
         }
 
-        lclex_next_token(parser->token, parser->text);
+        lclex_next_token(&parser->lexer);
 
         return node;
     }
     
-    if (parser->token->type == LCLEX_TOKEN_INTLIT) {
-        uint64_t n = strtoull(parser->token->data, NULL, 10);
+    if (parser->lexer.token.type == LCLEX_TOKEN_INTLIT) {
+        uint64_t n = lclex_token_number(&parser->lexer.token);
         
-        lclex_next_token(parser->token, parser->text);
+        lclex_next_token(&parser->lexer);
 
-        return lclex_church_encode(n);
+        return lclex_new_numeral(n);
     }
 
-    if (!lclex_expect_token(parser->token, LCLEX_TOKEN_IDENTIFIER)) {
+    if (!lclex_expect_token(&parser->lexer.token, LCLEX_TOKEN_IDENTIFIER)) {
         return NULL;
     }
 
-    for (size_t i = 0; i < parser->stack->size; i++) {
-        char *bound_str = parser->stack->data[parser->stack->size - i - 1];
+    lclex_symbol_t symbol = lclex_token_symbol(parser);
+    size_t index;
 
-        if (strcmp(parser->token->data, bound_str) == 0) {
-            lclex_next_token(parser->token, parser->text);
+    if (lclex_lookup_binder(&parser->binders, symbol, &index)) {
+        lclex_next_token(&parser->lexer);
 
-            return lclex_new_bound_variable(i);
-        }
+        return lclex_new_bound_variable(index);
     }
 
-    def_node = lclex_lookup_hashmap(parser->defs, parser->token->data);
+    def_node = lclex_lookup_hashmap(parser->defs, lclex_symbol_name(symbol));
 
     if (def_node == NULL) {
-        node = lclex_new_free_variable(lclex_strdup(parser->token->data));
+        node = lclex_new_free_variable(symbol);
     } else {
         node = lclex_copy_node(def_node);
     }
 
-    lclex_next_token(parser->token, parser->text);
+    lclex_next_token(&parser->lexer);
 
     return node;
 }
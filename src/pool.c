@@ -0,0 +1,926 @@
+#include "pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+void lclex_init_pool(lclex_pool_t *pool) {
+    pool->types = malloc(LCLEX_POOL_INIT_SIZE * sizeof(uint8_t));
+    pool->refs = malloc(LCLEX_POOL_INIT_SIZE * sizeof(uint32_t));
+    pool->data = malloc(LCLEX_POOL_INIT_SIZE * sizeof(uint32_t));
+    pool->left = malloc(LCLEX_POOL_INIT_SIZE * sizeof(lclex_handle_t));
+    pool->right = malloc(LCLEX_POOL_INIT_SIZE * sizeof(lclex_handle_t));
+    pool->size = 0;
+    pool->cap = LCLEX_POOL_INIT_SIZE;
+    pool->free_list = LCLEX_POOL_NONE;
+    pool->root = LCLEX_POOL_NONE;
+
+    for (size_t i = 0; i < LCLEX_N_PRIMITIVES; i++) {
+        pool->primitives[i] = LCLEX_POOL_NONE;
+    }
+
+    memset(&pool->stats, 0, sizeof(lclex_pool_stats_t));
+}
+
+void lclex_destruct_pool(lclex_pool_t *pool) {
+    free(pool->types);
+    free(pool->refs);
+    free(pool->data);
+    free(pool->left);
+    free(pool->right);
+}
+
+static void lclex_grow_pool(lclex_pool_t *pool) {
+    pool->cap *= 2;
+    pool->types = realloc(pool->types, pool->cap * sizeof(uint8_t));
+    pool->refs = realloc(pool->refs, pool->cap * sizeof(uint32_t));
+    pool->data = realloc(pool->data, pool->cap * sizeof(uint32_t));
+    pool->left = realloc(pool->left, pool->cap * sizeof(lclex_handle_t));
+    pool->right = realloc(pool->right, pool->cap * sizeof(lclex_handle_t));
+}
+
+/* Only valid until the next allocation, which may move the arrays. */
+static lclex_handle_t *lclex_pool_slot(lclex_pool_t *pool, lclex_slot_t slot) {
+    if (slot == LCLEX_POOL_ROOT) {
+        return &pool->root;
+    }
+
+    if (LCLEX_SLOT_RIGHT(slot)) {
+        return &pool->right[LCLEX_SLOT_HANDLE(slot)];
+    }
+    return &pool->left[LCLEX_SLOT_HANDLE(slot)];
+}
+
+lclex_handle_t lclex_pool_new(lclex_pool_t *pool, lclex_type_t type,
+                              uint32_t data, lclex_handle_t left,
+                              lclex_handle_t right) {
+    lclex_handle_t node;
+
+    if (pool->free_list != LCLEX_POOL_NONE) {
+        node = pool->free_list;
+        pool->free_list = pool->left[node];
+    } else {
+        if (pool->size == pool->cap) {
+            lclex_grow_pool(pool);
+        }
+        node = pool->size;
+        pool->size++;
+    }
+
+    pool->types[node] = type;
+    pool->refs[node] = 1;
+    pool->data[node] = data;
+    pool->left[node] = left;
+    pool->right[node] = right;
+
+    pool->stats.allocated++;
+    pool->stats.live++;
+    if (pool->stats.live > pool->stats.peak) {
+        pool->stats.peak = pool->stats.live;
+    }
+
+    return node;
+}
+
+lclex_handle_t lclex_pool_new_numeral(lclex_pool_t *pool, uint64_t n) {
+    return lclex_pool_new(pool, LCLEX_NUMERAL, (uint32_t)n,
+                          (lclex_handle_t)(n >> 32), LCLEX_POOL_NONE);
+}
+
+static uint64_t lclex_pool_number(lclex_pool_t *pool, lclex_handle_t node) {
+    return ((uint64_t)pool->left[node] << 32) | pool->data[node];
+}
+
+static void lclex_pool_release(lclex_pool_t *pool, lclex_handle_t node) {
+    pool->left[node] = pool->free_list;
+    pool->free_list = node;
+
+    pool->stats.freed++;
+    pool->stats.live--;
+}
+
+/* The traversals below keep the nodes left to visit on a pending stack of
+   handles rather than recursing, so that the depth of a term is only 
+   bounded by memory. They visit the nodes in the order the recursion 
+   did, which keeps the free list, and so the layout, as it was. */
+static inline void lclex_pool_push(lclex_stack_t *pending, 
+                                   lclex_handle_t node) {
+    lclex_push_pending(pending, (void *)(uintptr_t)node);
+}
+
+static inline lclex_handle_t lclex_pool_pop(lclex_stack_t *pending) {
+    return (uintptr_t)lclex_pop_pending(pending);
+}
+
+/* A node is released after its children, right then left, and waits 
+   behind LCLEX_POOL_NONE on the stack until they are freed. */
+void lclex_pool_free(lclex_pool_t *pool, lclex_handle_t node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_pool_push(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pool_pop(&pending);
+        if (node == LCLEX_POOL_NONE) {
+            lclex_pool_release(pool, lclex_pool_pop(&pending));
+            continue;
+        }
+
+        pool->refs[node]--;
+        if (pool->refs[node] > 0) {
+            continue;
+        }
+
+        switch ((lclex_type_t)pool->types[node]) {
+            case LCLEX_APPLICATION:
+            case LCLEX_ABSTRACTION:
+                lclex_pool_push(&pending, node);
+                lclex_pool_push(&pending, LCLEX_POOL_NONE);
+                lclex_pool_push(&pending, pool->left[node]);
+                if (pool->types[node] == LCLEX_APPLICATION) {
+                    lclex_pool_push(&pending, pool->right[node]);
+                }
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                lclex_pool_release(pool, node);
+                break;
+        }
+    }
+
+    lclex_destruct_pending(&pending);
+}
+
+/* Frees a node some of whose children were taken, left then right. */
+static void lclex_pool_free_partial(lclex_pool_t *pool, lclex_handle_t node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_pool_push(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pool_pop(&pending);
+        if (node == LCLEX_POOL_NONE) {
+            lclex_pool_release(pool, lclex_pool_pop(&pending));
+            continue;
+        }
+
+        pool->refs[node]--;
+        if (pool->refs[node] > 0) {
+            continue;
+        }
+
+        lclex_pool_push(&pending, node);
+        lclex_pool_push(&pending, LCLEX_POOL_NONE);
+        if (pool->types[node] == LCLEX_APPLICATION
+            && pool->right[node] != LCLEX_POOL_NONE) {
+            lclex_pool_push(&pending, pool->right[node]);
+        }
+        if ((pool->types[node] == LCLEX_APPLICATION
+             || pool->types[node] == LCLEX_ABSTRACTION)
+            && pool->left[node] != LCLEX_POOL_NONE) {
+            lclex_pool_push(&pending, pool->left[node]);
+        }
+    }
+
+    lclex_destruct_pending(&pending);
+}
+
+/* Shared nodes are closed and shared rather than copied. A node is 
+   copied after its children, right then left, and waits behind 
+   LCLEX_POOL_NONE until their copies are on copies. */
+lclex_handle_t lclex_pool_copy(lclex_pool_t *pool, lclex_handle_t node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    void *copies_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending, copies;
+    lclex_handle_t left, right, copy;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_init_pending(&copies, copies_data);
+    lclex_pool_push(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pool_pop(&pending);
+        left = LCLEX_POOL_NONE;
+        right = LCLEX_POOL_NONE;
+
+        if (node == LCLEX_POOL_NONE) {
+            node = lclex_pool_pop(&pending);
+            left = lclex_pool_pop(&copies);
+            if (pool->types[node] == LCLEX_APPLICATION) {
+                right = lclex_pool_pop(&copies);
+            }
+        } else if (pool->refs[node] > 1) {
+            pool->refs[node]++;
+            lclex_pool_push(&copies, node);
+            continue;
+        } else if (pool->types[node] == LCLEX_APPLICATION
+                   || pool->types[node] == LCLEX_ABSTRACTION) {
+            lclex_pool_push(&pending, node);
+            lclex_pool_push(&pending, LCLEX_POOL_NONE);
+            lclex_pool_push(&pending, pool->left[node]);
+            if (pool->types[node] == LCLEX_APPLICATION) {
+                lclex_pool_push(&pending, pool->right[node]);
+            }
+            continue;
+        } else {
+            left = pool->left[node];
+            right = pool->right[node];
+        }
+
+        copy = lclex_pool_new(pool, pool->types[node], pool->data[node],
+                              left, right);
+        lclex_pool_push(&copies, copy);
+    }
+
+    copy = lclex_pool_pop(&copies);
+    lclex_destruct_pending(&pending);
+    lclex_destruct_pending(&copies);
+
+    return copy;
+}
+
+void lclex_pool_unshare(lclex_pool_t *pool, lclex_slot_t slot) {
+    lclex_handle_t node = *lclex_pool_slot(pool, slot);
+    lclex_handle_t left = pool->left[node], right = pool->right[node];
+    lclex_handle_t copy;
+
+    switch ((lclex_type_t)pool->types[node]) {
+        case LCLEX_APPLICATION:
+            right = lclex_pool_copy(pool, right);
+
+            __attribute__((fallthrough));
+        case LCLEX_ABSTRACTION:
+            left = lclex_pool_copy(pool, left);
+            break;
+
+        case LCLEX_FREE_VARIABLE:
+        case LCLEX_BOUND_VARIABLE:
+        case LCLEX_NUMERAL:
+        case LCLEX_PRIMITIVE:
+            break;
+    }
+
+    pool->refs[node]--;
+    copy = lclex_pool_new(pool, pool->types[node], pool->data[node],
+                          left, right);
+    *lclex_pool_slot(pool, slot) = copy;
+}
+
+/* Shared nodes are closed, so is_closed, shift and find_bound_and_shift
+   never enter them. These go down the left child of each node in the 
+   loop and only keep the right children pending, each with its index 
+   next to it on the stack. */
+bool lclex_pool_is_closed(lclex_pool_t *pool, lclex_handle_t node,
+                          lclex_bruijn_index_t index) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    bool closed = true;
+
+    lclex_init_pending(&pending, pending_data);
+
+    while (closed) {
+        if (pool->refs[node] <= 1) {
+            switch ((lclex_type_t)pool->types[node]) {
+                case LCLEX_APPLICATION:
+                    lclex_pool_push(&pending, pool->right[node]);
+                    lclex_push_pending(&pending, (void *)(index));
+                    node = pool->left[node];
+                    continue;
+
+                case LCLEX_ABSTRACTION:
+                    node = pool->left[node];
+                    index++;
+                    continue;
+
+                case LCLEX_FREE_VARIABLE:
+                case LCLEX_NUMERAL:
+                case LCLEX_PRIMITIVE:
+                    break;
+
+                case LCLEX_BOUND_VARIABLE:
+                    closed = pool->data[node] < index;
+                    break;
+            }
+        }
+
+        if (pending.size == 0) {
+            break;
+        }
+        index = (lclex_bruijn_index_t)(lclex_pop_pending(&pending));
+        node = lclex_pool_pop(&pending);
+    }
+
+    lclex_destruct_pending(&pending);
+    return closed;
+}
+
+void lclex_pool_shift(lclex_pool_t *pool, lclex_handle_t node,
+                      uint64_t shift, lclex_bruijn_index_t index) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+
+    lclex_init_pending(&pending, pending_data);
+
+    while (true) {
+        if (pool->refs[node] <= 1) {
+            switch ((lclex_type_t)pool->types[node]) {
+                case LCLEX_APPLICATION:
+                    lclex_pool_push(&pending, pool->right[node]);
+                    lclex_push_pending(&pending, (void *)(index));
+                    node = pool->left[node];
+                    continue;
+
+                case LCLEX_ABSTRACTION:
+                    node = pool->left[node];
+                    index++;
+                    continue;
+
+                case LCLEX_FREE_VARIABLE:
+                case LCLEX_NUMERAL:
+                case LCLEX_PRIMITIVE:
+                    break;
+
+                case LCLEX_BOUND_VARIABLE:
+                    if (pool->data[node] >= index) {
+                        pool->data[node] += shift;
+                    }
+                    break;
+            }
+        }
+
+        if (pending.size == 0) {
+            break;
+        }
+        index = (lclex_bruijn_index_t)(lclex_pop_pending(&pending));
+        node = lclex_pool_pop(&pending);
+    }
+
+    lclex_destruct_pending(&pending);
+}
+
+/* Occurrences are pushed onto stack in the order of the text, left
+   before right. */
+void lclex_pool_find_bound_and_shift(lclex_pool_t *pool, lclex_slot_t slot,
+                                     lclex_bruijn_index_t index,
+                                     lclex_stack_t *stack) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    lclex_handle_t node;
+
+    lclex_init_pending(&pending, pending_data);
+
+    while (true) {
+        node = *lclex_pool_slot(pool, slot);
+
+        if (pool->refs[node] <= 1) {
+            switch ((lclex_type_t)pool->types[node]) {
+                case LCLEX_APPLICATION:
+                    lclex_push_pending(&pending, 
+                                       (void *)(uintptr_t)LCLEX_SLOT(node, 1));
+                    lclex_push_pending(&pending, (void *)(index));
+                    slot = LCLEX_SLOT(node, 0);
+                    continue;
+
+                case LCLEX_ABSTRACTION:
+                    slot = LCLEX_SLOT(node, 0);
+                    index++;
+                    continue;
+
+                case LCLEX_FREE_VARIABLE:
+                case LCLEX_NUMERAL:
+                case LCLEX_PRIMITIVE:
+                    break;
+
+                case LCLEX_BOUND_VARIABLE:
+                    if (pool->data[node] == index) {
+                        lclex_push_stack(stack, (void *)(uintptr_t)slot);
+                        lclex_push_stack(stack, (void *)(index));
+                    } else if (pool->data[node] > index) {
+                        pool->data[node]--;
+                    }
+                    break;
+            }
+        }
+
+        if (pending.size == 0) {
+            break;
+        }
+        index = (lclex_bruijn_index_t)(lclex_pop_pending(&pending));
+        slot = (uintptr_t)lclex_pop_pending(&pending);
+    }
+
+    lclex_destruct_pending(&pending);
+}
+
+/* Same as lclex_fold_numeral with no environment. */
+bool lclex_pool_fold_numeral(lclex_pool_t *pool, lclex_handle_t node,
+                             uint64_t *pn) {
+    lclex_handle_t spine[LCLEX_MAX_PRIMITIVE_ARITY];
+    uint64_t args[LCLEX_MAX_PRIMITIVE_ARITY] = { 0 };
+    size_t n = 0;
+
+    while (true) {
+        switch ((lclex_type_t)pool->types[node]) {
+            case LCLEX_APPLICATION:
+                if (n == LCLEX_MAX_PRIMITIVE_ARITY) {
+                    return false;
+                }
+                spine[n] = pool->right[node];
+                n++;
+                node = pool->left[node];
+                break;
+
+            case LCLEX_NUMERAL:
+                *pn = lclex_pool_number(pool, node);
+                return n == 0;
+
+            case LCLEX_PRIMITIVE:
+                if (n != lclex_primitive_arity(pool->data[node])) {
+                    return false;
+                }
+
+                for (size_t i = 0; i < n; i++) {
+                    if (!lclex_pool_fold_numeral(pool, spine[n - i - 1],
+                                                 &args[i])) {
+                        return false;
+                    }
+                }
+                return lclex_apply_primitive(pool->data[node], args, pn);
+
+            case LCLEX_ABSTRACTION:
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+                return false;
+        }
+    }
+}
+
+/* Definitions of primitives are closed, so they are imported once and
+   shared by every expansion. */
+lclex_handle_t lclex_pool_expand(lclex_pool_t *pool, lclex_handle_t node) {
+    lclex_primitive_t primitive = pool->data[node];
+    lclex_handle_t expr;
+
+    if (pool->types[node] == LCLEX_NUMERAL) {
+        uint64_t n = lclex_pool_number(pool, node);
+
+        expr = lclex_pool_new(pool, LCLEX_BOUND_VARIABLE, 0,
+                              LCLEX_POOL_NONE, LCLEX_POOL_NONE);
+        for (uint64_t i = n; i > 0; i--) {
+            lclex_handle_t f = lclex_pool_new(pool, LCLEX_BOUND_VARIABLE, 1,
+                                              LCLEX_POOL_NONE,
+                                              LCLEX_POOL_NONE);
+            expr = lclex_pool_new(pool, LCLEX_APPLICATION, 0, f, expr);
+        }
+
+        expr = lclex_pool_new(pool, LCLEX_ABSTRACTION, LCLEX_SYMBOL_X,
+                              expr, LCLEX_POOL_NONE);
+        return lclex_pool_new(pool, LCLEX_ABSTRACTION, LCLEX_SYMBOL_F,
+                              expr, LCLEX_POOL_NONE);
+    }
+
+    if (pool->primitives[primitive] == LCLEX_POOL_NONE) {
+        expr = lclex_pool_import(pool, lclex_primitive_defs[primitive]);
+        pool->primitives[primitive] = expr;
+    }
+
+    expr = pool->primitives[primitive];
+    pool->refs[expr]++;
+
+    return expr;
+}
+
+void lclex_pool_reduce_redex(lclex_pool_t *pool, lclex_slot_t redex,
+                             lclex_stack_t *stack) {
+    lclex_handle_t node = *lclex_pool_slot(pool, redex);
+    lclex_handle_t abstr = pool->left[node];
+    lclex_handle_t arg = pool->right[node];
+    lclex_handle_t body, target;
+    uint64_t n;
+
+    if (lclex_pool_fold_numeral(pool, node, &n)) {
+        lclex_pool_free(pool, node);
+        target = lclex_pool_new_numeral(pool, n);
+        *lclex_pool_slot(pool, redex) = target;
+        return;
+    }
+
+    if (pool->types[abstr] != LCLEX_ABSTRACTION) {
+        lclex_handle_t expr = lclex_pool_expand(pool, abstr);
+        pool->left[node] = expr;
+        lclex_pool_free(pool, abstr);
+        abstr = expr;
+    }
+
+    if (pool->refs[abstr] > 1) {
+        body = lclex_pool_copy(pool, pool->left[abstr]);
+    } else {
+        body = pool->left[abstr];
+        pool->left[abstr] = LCLEX_POOL_NONE;
+    }
+    pool->right[node] = LCLEX_POOL_NONE;
+    lclex_pool_free_partial(pool, node);
+
+    /* The body takes the place of the redex before the occurrences are
+       searched, so that every occurrence has a slot to be written to. */
+    *lclex_pool_slot(pool, redex) = body;
+
+    lclex_clear_stack(stack);
+    lclex_pool_find_bound_and_shift(pool, redex, 0, stack);
+
+    bool share = stack->size > 2 && lclex_pool_is_closed(pool, arg, 0);
+
+    for (size_t i = 0; i < stack->size; i += 2) {
+        lclex_slot_t slot = (uintptr_t)(stack->data[i]);
+        lclex_bruijn_index_t index = (lclex_bruijn_index_t)(stack->data[i + 1]);
+        lclex_pool_free(pool, *lclex_pool_slot(pool, slot));
+
+        if (i == stack->size - 2) {
+            target = arg;
+            arg = LCLEX_POOL_NONE;
+        } else if (share) {
+            target = arg;
+            pool->refs[arg]++;
+        } else {
+            target = lclex_pool_copy(pool, arg);
+        }
+        *lclex_pool_slot(pool, slot) = target;
+
+        if (index != 0 && !share) {
+            lclex_pool_shift(pool, target, index, 0);
+        }
+    }
+
+    if (arg != LCLEX_POOL_NONE) {
+        lclex_pool_free(pool, arg);
+    }
+}
+
+/* Imports the children of a node before it, right then left, with the
+   node waiting behind NULL until their handles are on handles. */
+lclex_handle_t lclex_pool_import(lclex_pool_t *pool, lclex_node_t *node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    void *handles_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending, handles;
+    lclex_handle_t left, right, handle;
+    uint32_t data;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_init_pending(&handles, handles_data);
+    lclex_push_pending(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pop_pending(&pending);
+        left = LCLEX_POOL_NONE;
+        right = LCLEX_POOL_NONE;
+        data = 0;
+
+        if (node == NULL) {
+            node = lclex_pop_pending(&pending);
+            left = lclex_pool_pop(&handles);
+            if (node->type == LCLEX_APPLICATION) {
+                right = lclex_pool_pop(&handles);
+            } else {
+                data = node->data.symbol;
+            }
+        } else {
+            switch (node->type) {
+                case LCLEX_APPLICATION:
+                case LCLEX_ABSTRACTION:
+                    lclex_push_pending(&pending, node);
+                    lclex_push_pending(&pending, NULL);
+                    lclex_push_pending(&pending, node->left);
+                    if (node->type == LCLEX_APPLICATION) {
+                        lclex_push_pending(&pending, node->right);
+                    }
+                    continue;
+
+                case LCLEX_FREE_VARIABLE:
+                    data = node->data.symbol;
+                    break;
+
+                case LCLEX_BOUND_VARIABLE:
+                    data = node->data.index;
+                    break;
+
+                case LCLEX_NUMERAL:
+                    handle = lclex_pool_new_numeral(pool, node->data.number);
+                    lclex_pool_push(&handles, handle);
+                    continue;
+
+                case LCLEX_PRIMITIVE:
+                    data = node->data.primitive;
+                    break;
+            }
+        }
+
+        handle = lclex_pool_new(pool, node->type, data, left, right);
+        lclex_pool_push(&handles, handle);
+    }
+
+    handle = lclex_pool_pop(&handles);
+    lclex_destruct_pending(&pending);
+    lclex_destruct_pending(&handles);
+
+    return handle;
+}
+
+/* Exports the children of a node before it, as lclex_pool_import. */
+lclex_node_t *lclex_pool_export(lclex_pool_t *pool, lclex_handle_t node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    void *exports_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending, exports;
+    lclex_node_t *left, *right, *export = NULL;
+    uint32_t data;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_init_pending(&exports, exports_data);
+    lclex_pool_push(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pool_pop(&pending);
+
+        if (node == LCLEX_POOL_NONE) {
+            node = lclex_pool_pop(&pending);
+            left = lclex_pop_pending(&exports);
+            if (pool->types[node] == LCLEX_APPLICATION) {
+                right = lclex_pop_pending(&exports);
+                export = lclex_new_application(left, right);
+            } else {
+                export = lclex_new_abstraction(pool->data[node], left);
+            }
+            lclex_push_pending(&exports, export);
+            continue;
+        }
+
+        data = pool->data[node];
+
+        switch ((lclex_type_t)pool->types[node]) {
+            case LCLEX_APPLICATION:
+            case LCLEX_ABSTRACTION:
+                lclex_pool_push(&pending, node);
+                lclex_pool_push(&pending, LCLEX_POOL_NONE);
+                lclex_pool_push(&pending, pool->left[node]);
+                if (pool->types[node] == LCLEX_APPLICATION) {
+                    lclex_pool_push(&pending, pool->right[node]);
+                }
+                continue;
+
+            case LCLEX_FREE_VARIABLE:
+                export = lclex_new_free_variable(data);
+                break;
+
+            case LCLEX_BOUND_VARIABLE:
+                export = lclex_new_bound_variable(data);
+                break;
+
+            case LCLEX_NUMERAL:
+                export = lclex_new_numeral(lclex_pool_number(pool, node));
+                break;
+
+            case LCLEX_PRIMITIVE:
+                export = lclex_new_primitive(data);
+                break;
+        }
+
+        lclex_push_pending(&exports, export);
+    }
+
+    export = lclex_pop_pending(&exports);
+    lclex_destruct_pending(&pending);
+    lclex_destruct_pending(&exports);
+
+    return export;
+}
+
+/* Position of the normal-order search, as in lclex_cursor_t, with slots
+   in place of pointers to the children of nodes. */
+typedef struct {
+    lclex_stack_t path;
+    lclex_stack_t shared;
+} lclex_pool_cursor_t;
+
+static lclex_slot_t lclex_pool_path(lclex_pool_cursor_t *cursor, size_t i) {
+    return (uintptr_t)(cursor->path.data[i]);
+}
+
+static lclex_handle_t lclex_pool_path_node(lclex_pool_t *pool,
+                                           lclex_pool_cursor_t *cursor,
+                                           size_t i) {
+    return *lclex_pool_slot(pool, lclex_pool_path(cursor, i));
+}
+
+static void lclex_pool_push_cursor(lclex_pool_t *pool,
+                                   lclex_pool_cursor_t *cursor,
+                                   lclex_slot_t slot) {
+    if (pool->refs[*lclex_pool_slot(pool, slot)] > 1) {
+        lclex_push_stack(&cursor->shared, (void *)(cursor->path.size));
+    }
+    lclex_push_stack(&cursor->path, (void *)(uintptr_t)slot);
+}
+
+static lclex_slot_t lclex_pool_pop_cursor(lclex_pool_cursor_t *cursor) {
+    lclex_slot_t slot = (uintptr_t)lclex_pop_stack(&cursor->path);
+
+    if (cursor->shared.size > 0
+        && (size_t)(cursor->shared.data[cursor->shared.size - 1])
+           == cursor->path.size) {
+        lclex_pop_stack(&cursor->shared);
+    }
+
+    return slot;
+}
+
+static lclex_slot_t lclex_pool_cursor_primitive(lclex_pool_t *pool,
+                                                lclex_pool_cursor_t *cursor) {
+    lclex_stack_t *path = &cursor->path;
+    lclex_slot_t slot = lclex_pool_path(cursor, path->size - 1);
+    lclex_handle_t node = *lclex_pool_slot(pool, slot);
+    size_t arity = lclex_primitive_arity(pool->data[pool->left[node]]);
+    size_t i = path->size - 1;
+    uint64_t n;
+
+    for (size_t k = 1; k < arity; k++) {
+        if (i == 0) {
+            return slot;
+        }
+
+        lclex_handle_t parent = lclex_pool_path_node(pool, cursor, i - 1);
+        if (pool->types[parent] != LCLEX_APPLICATION
+            || lclex_pool_path(cursor, i) != LCLEX_SLOT(parent, 0)) {
+            return slot;
+        }
+        i--;
+    }
+
+    if (!lclex_pool_fold_numeral(pool, lclex_pool_path_node(pool, cursor, i),
+                                 &n)) {
+        return slot;
+    }
+
+    while (path->size > i + 1) {
+        lclex_pool_pop_cursor(cursor);
+    }
+
+    return lclex_pool_path(cursor, i);
+}
+
+static lclex_slot_t lclex_pool_next_redex(lclex_pool_t *pool,
+                                          lclex_pool_cursor_t *cursor) {
+    lclex_stack_t *path = &cursor->path;
+
+    while (path->size > 0) {
+        lclex_slot_t slot = lclex_pool_path(cursor, path->size - 1);
+        lclex_handle_t node = *lclex_pool_slot(pool, slot);
+        lclex_type_t left;
+
+        switch ((lclex_type_t)pool->types[node]) {
+            case LCLEX_APPLICATION:
+                left = pool->types[pool->left[node]];
+                if (left == LCLEX_ABSTRACTION || left == LCLEX_NUMERAL) {
+                    return slot;
+                }
+
+                if (left == LCLEX_PRIMITIVE) {
+                    return lclex_pool_cursor_primitive(pool, cursor);
+                }
+
+                lclex_pool_push_cursor(pool, cursor, LCLEX_SLOT(node, 0));
+                continue;
+
+            case LCLEX_ABSTRACTION:
+                lclex_pool_push_cursor(pool, cursor, LCLEX_SLOT(node, 0));
+                continue;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                break;
+        }
+
+        bool resumed = false;
+
+        while (!resumed && path->size > 1) {
+            lclex_slot_t child = lclex_pool_pop_cursor(cursor);
+            lclex_handle_t parent = lclex_pool_path_node(pool, cursor,
+                                                         path->size - 1);
+
+            if (pool->types[parent] == LCLEX_APPLICATION
+                && child == LCLEX_SLOT(parent, 0)) {
+                lclex_pool_push_cursor(pool, cursor, LCLEX_SLOT(parent, 1));
+                resumed = true;
+            }
+        }
+
+        if (!resumed) {
+            lclex_pool_pop_cursor(cursor);
+        }
+    }
+
+    return LCLEX_POOL_NONE;
+}
+
+/* Slots below an unshared node are moved over to its copy, which only
+   needs the new parent since the side stays the same. */
+static void lclex_pool_unshare_cursor(lclex_pool_t *pool,
+                                      lclex_pool_cursor_t *cursor) {
+    lclex_stack_t *path = &cursor->path;
+    lclex_handle_t parent = LCLEX_POOL_NONE;
+
+    if (cursor->shared.size == 0) {
+        return;
+    }
+
+    for (size_t i = (size_t)(cursor->shared.data[0]); i < path->size; i++) {
+        lclex_slot_t slot = lclex_pool_path(cursor, i);
+
+        if (parent != LCLEX_POOL_NONE) {
+            slot = LCLEX_SLOT(parent, LCLEX_SLOT_RIGHT(slot));
+            path->data[i] = (void *)(uintptr_t)slot;
+        }
+
+        if (pool->refs[*lclex_pool_slot(pool, slot)] > 1) {
+            lclex_pool_unshare(pool, slot);
+        }
+
+        parent = *lclex_pool_slot(pool, slot);
+    }
+
+    lclex_clear_stack(&cursor->shared);
+}
+
+static void lclex_pool_contracted(lclex_pool_t *pool,
+                                  lclex_pool_cursor_t *cursor) {
+    lclex_stack_t *path = &cursor->path;
+    lclex_slot_t slot = lclex_pool_pop_cursor(cursor);
+
+    if (path->size > 0) {
+        lclex_handle_t parent = lclex_pool_path_node(pool, cursor,
+                                                     path->size - 1);
+
+        if (pool->types[parent] == LCLEX_APPLICATION
+            && slot == LCLEX_SLOT(parent, 0)
+            && (pool->types[pool->left[parent]] == LCLEX_ABSTRACTION
+                || pool->types[pool->left[parent]] == LCLEX_NUMERAL
+                || pool->types[pool->left[parent]] == LCLEX_PRIMITIVE)) {
+            return;
+        }
+    }
+
+    lclex_pool_push_cursor(pool, cursor, slot);
+}
+
+void lclex_pool_reduce_expression(lclex_pool_t *pool, lclex_node_t **pexpr,
+                                  uint64_t max, bool show_reductions) {
+    lclex_slot_t redex;
+    lclex_node_t *expr;
+
+    pool->root = lclex_pool_import(pool, *pexpr);
+    lclex_free_node(*pexpr);
+
+    lclex_stack_t stack;
+    lclex_init_stack(&stack);
+
+    lclex_pool_cursor_t cursor;
+    lclex_init_stack(&cursor.path);
+    lclex_init_stack(&cursor.shared);
+    lclex_pool_push_cursor(pool, &cursor, LCLEX_POOL_ROOT);
+
+    while (pool->stats.steps < max
+           && (redex = lclex_pool_next_redex(pool, &cursor))
+              != LCLEX_POOL_NONE) {
+        lclex_pool_unshare_cursor(pool, &cursor);
+        redex = lclex_pool_path(&cursor, cursor.path.size - 1);
+
+        lclex_pool_reduce_redex(pool, redex, &stack);
+        lclex_pool_contracted(pool, &cursor);
+        pool->stats.steps++;
+
+        if (show_reductions) {
+            expr = lclex_pool_export(pool, pool->root);
+            printf("%ld: ", pool->stats.steps);
+            lclex_write_node(expr, stdout);
+            lclex_free_node(expr);
+        }
+    }
+
+    lclex_destruct_stack(&cursor.path);
+    lclex_destruct_stack(&cursor.shared);
+    lclex_destruct_stack(&stack);
+
+    *pexpr = lclex_pool_export(pool, pool->root);
+}
+
+void lclex_write_pool_stats(lclex_pool_t *pool, FILE *stream) {
+    fprintf(stream, "> pool: %ld steps, %ld allocated, %ld freed, %ld peak, "
+            "%ld bytes per node, %ld bytes reserved\n",
+            pool->stats.steps, pool->stats.allocated, pool->stats.freed,
+            pool->stats.peak, LCLEX_POOL_NODE_BYTES,
+            pool->cap * LCLEX_POOL_NODE_BYTES);
+}
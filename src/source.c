@@ -0,0 +1,85 @@
+#define _GNU_SOURCE
+
+#include "source.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+bool lclex_open_source(lclex_source_t *source, char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "Error: could not open '%s'\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+
+    source->data = NULL;
+    source->size = st.st_size;
+    source->line = 0;
+    source->next_line = 1;
+
+    if (source->size > 0) {
+        source->data = mmap(NULL, source->size, PROT_READ, MAP_PRIVATE, 
+                            fd, 0);
+    }
+    close(fd);
+
+    if (source->data == MAP_FAILED) {
+        fprintf(stderr, "Error: could not map '%s'\n", path);
+        return false;
+    }
+
+    /* The file is read once from start to end. */
+    if (source->size > 0) {
+        madvise(source->data, source->size, MADV_SEQUENTIAL);
+    }
+    source->pos = source->data;
+
+    return true;
+}
+
+void lclex_close_source(lclex_source_t *source) {
+    if (source->data != NULL) {
+        munmap(source->data, source->size);
+    }
+}
+
+/* Returns the next statement and sets len to its length, or returns 
+   NULL at the end of the file. The statement is not terminated, and stays
+   valid until the source is closed. Line is set to the line the statement
+   starts on. */
+char *lclex_next_statement(lclex_source_t *source, size_t *len) {
+    char *end = source->data + source->size;
+    char *start = source->pos;
+    char *p = start;
+
+    if (source->data == NULL || start == end) {
+        return NULL;
+    }
+
+    source->line = source->next_line;
+
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        source->next_line++;
+        p++;
+
+        if (p == end || (*p != ' ' && *p != '\t')) {
+            source->pos = p;
+            *len = p - 1 - start;
+
+            return start;
+        }
+    }
+
+    source->pos = end;
+    *len = end - start;
+
+    return start;
+}
@@ -0,0 +1,98 @@
+#define _GNU_SOURCE
+
+#include "stats.h"
+#include <time.h>
+#include <sys/resource.h>
+
+char *lclex_phase_name(lclex_phase_t phase) {
+    static char *names[] = {
+        "parse",
+        "reduce",
+        "print",
+        "decode"
+    };
+
+    return names[phase];
+}
+
+uint64_t lclex_clock(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/* Sets counters to the work done by this thread since start was taken. */
+void lclex_tree_counters_since(lclex_tree_counters_t *counters,
+                               lclex_tree_counters_t *start) {
+    counters->visited = lclex_tree_counters.visited - start->visited;
+    counters->copied = lclex_tree_counters.copied - start->copied;
+    counters->shifted = lclex_tree_counters.shifted - start->shifted;
+    counters->substituted = lclex_tree_counters.substituted 
+                            - start->substituted;
+}
+
+void lclex_finish_statement_stats(lclex_statement_stats_t *stats,
+                                  lclex_arena_t *arena) {
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    stats->arena = arena->stats;
+    stats->peak_rss = usage.ru_maxrss;
+}
+
+void lclex_write_statement_stats(lclex_statement_stats_t *stats,
+                                 FILE *stream) {
+    fprintf(stream, "> time:");
+    for (size_t i = 0; i < LCLEX_N_PHASES; i++) {
+        fprintf(stream, "%s %.3f ms %s", i == 0 ? "" : ",",
+                stats->time[i] / 1e6, lclex_phase_name(i));
+    }
+    fprintf(stream, "\n");
+
+    fprintf(stream, "> tree: %ld visited, %ld copied, %ld shifted, "
+            "%ld substituted\n",
+            stats->counters.visited, stats->counters.copied,
+            stats->counters.shifted, stats->counters.substituted);
+    fprintf(stream, "> memory: %ld KiB peak resident\n", stats->peak_rss);
+
+    if (stats->use_cache) {
+        fprintf(stream, "> cache: %ld hits, %ld misses, %ld entries, "
+                "%ld evicted, %ld normalized\n", stats->cache.hits,
+                stats->cache.misses, stats->cache.entries,
+                stats->cache.evicted, stats->cache.normalized);
+    }
+}
+
+/* One object per line, so that the output of a session can be read
+   statement by statement. */
+void lclex_write_statement_json(lclex_statement_stats_t *stats,
+                                FILE *stream) {
+    fprintf(stream, "{\"statement\": %ld, \"engine\": \"%s\", ",
+            stats->index, stats->engine);
+
+    for (size_t i = 0; i < LCLEX_N_PHASES; i++) {
+        fprintf(stream, "\"%s_ns\": %ld, ", lclex_phase_name(i),
+                stats->time[i]);
+    }
+
+    fprintf(stream, "\"steps\": %ld, \"visited\": %ld, \"copied\": %ld, "
+            "\"shifted\": %ld, \"substituted\": %ld, ", stats->steps,
+            stats->counters.visited, stats->counters.copied,
+            stats->counters.shifted, stats->counters.substituted);
+    fprintf(stream, "\"allocated\": %ld, \"reused\": %ld, \"freed\": %ld, "
+            "\"peak\": %ld, \"slabs\": %ld, ", stats->arena.allocated,
+            stats->arena.reused, stats->arena.freed, stats->arena.peak,
+            stats->arena.slabs);
+
+    if (stats->use_cache) {
+        fprintf(stream, "\"cache_hits\": %ld, \"cache_misses\": %ld, "
+                "\"cache_entries\": %ld, \"cache_evicted\": %ld, "
+                "\"cache_normalized\": %ld, ", stats->cache.hits,
+                stats->cache.misses, stats->cache.entries,
+                stats->cache.evicted, stats->cache.normalized);
+    }
+    fprintf(stream, "\"peak_rss_kib\": %ld}\n", stats->peak_rss);
+}
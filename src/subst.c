@@ -0,0 +1,374 @@
+#include "subst.h"
+#include <stdlib.h>
+#include <string.h>
+
+void lclex_init_subst(lclex_subst_t *machine) {
+    machine->stack = malloc(LCLEX_SUBST_STACK_INIT_SIZE
+                            * sizeof(lclex_subst_term_t));
+    machine->size = 0;
+    machine->cap = LCLEX_SUBST_STACK_INIT_SIZE;
+    machine->blocks = NULL;
+
+    memset(&machine->stats, 0, sizeof(lclex_subst_stats_t));
+}
+
+void lclex_destruct_subst(lclex_subst_t *machine) {
+    lclex_subst_block_t *next, *block = machine->blocks;
+
+    while (block != NULL) {
+        next = block->next;
+        free(block->substs);
+        free(block);
+        block = next;
+    }
+
+    free(machine->stack);
+}
+
+lclex_substitution_t *lclex_new_substitution(lclex_subst_t *machine,
+                                             lclex_subst_kind_t kind,
+                                             lclex_substitution_t *next) {
+    lclex_subst_block_t *block = machine->blocks;
+
+    if (block == NULL || block->used == LCLEX_SUBST_BLOCK_SIZE) {
+        block = malloc(sizeof(lclex_subst_block_t));
+        block->next = machine->blocks;
+        block->substs = malloc(LCLEX_SUBST_BLOCK_SIZE
+                               * sizeof(lclex_substitution_t));
+        block->used = 0;
+        machine->blocks = block;
+    }
+
+    lclex_substitution_t *subst = &block->substs[block->used];
+    block->used++;
+    machine->stats.substs++;
+
+    subst->kind = kind;
+    subst->shift = 0;
+    subst->head.term = NULL;
+    subst->head.subst = NULL;
+    subst->next = next;
+
+    return subst;
+}
+
+/* Composes subst with a shift, merging it into a shift on top. */
+lclex_substitution_t *lclex_shift_substitution(lclex_subst_t *machine,
+                                               lclex_substitution_t *subst,
+                                               uint64_t shift) {
+    lclex_substitution_t *shifted;
+
+    if (shift == 0) {
+        return subst;
+    }
+
+    if (subst != NULL && subst->kind == LCLEX_SUBST_SHIFT) {
+        shift += subst->shift;
+        subst = subst->next;
+    }
+
+    shifted = lclex_new_substitution(machine, LCLEX_SUBST_SHIFT, subst);
+    shifted->shift = shift;
+
+    return shifted;
+}
+
+static void lclex_push_suspension(lclex_subst_t *machine,
+                                  lclex_subst_term_t suspension) {
+    if (machine->size == machine->cap) {
+        machine->cap *= 2;
+        machine->stack = realloc(machine->stack,
+                                 machine->cap * sizeof(lclex_subst_term_t));
+    }
+
+    machine->stack[machine->size] = suspension;
+    machine->size++;
+
+    if (machine->size > machine->stats.max_stack) {
+        machine->stats.max_stack = machine->size;
+    }
+}
+
+/* Applies subst to the variable index, gathering the shifts passed on the
+   way so that they are only applied to what is found. */
+void lclex_subst_lookup(lclex_subst_t *machine, lclex_substitution_t *subst,
+                        lclex_bruijn_index_t index,
+                        lclex_subst_term_t *suspension) {
+    uint64_t shift = 0;
+
+    while (subst != NULL) {
+        machine->stats.lookups++;
+
+        switch (subst->kind) {
+            case LCLEX_SUBST_CONS:
+                if (index > 0) {
+                    index--;
+                    break;
+                }
+
+                if (subst->head.term == NULL) {
+                    index = (uintptr_t)(subst->head.subst);
+                } else {
+                    suspension->term = subst->head.term;
+                    suspension->subst = lclex_shift_substitution(
+                        machine, subst->head.subst, shift);
+                    return;
+                }
+
+                suspension->term = NULL;
+                suspension->subst = (lclex_substitution_t *)
+                                    (uintptr_t)(index + shift);
+                return;
+
+            case LCLEX_SUBST_LIFT:
+                if (index == 0) {
+                    suspension->term = NULL;
+                    suspension->subst = (lclex_substitution_t *)
+                                        (uintptr_t)(shift);
+                    return;
+                }
+                index--;
+                shift++;
+                break;
+
+            case LCLEX_SUBST_SHIFT:
+                shift += subst->shift;
+                break;
+        }
+
+        subst = subst->next;
+    }
+
+    suspension->term = NULL;
+    suspension->subst = (lclex_substitution_t *)(uintptr_t)(index + shift);
+}
+
+/* Lookup for folding, which needs no shifts: they only change variables
+   bound during read back, and those never fold. */
+static lclex_node_t *lclex_subst_fold_lookup(void **penv,
+                                             lclex_bruijn_index_t index) {
+    lclex_substitution_t *subst = *penv;
+
+    while (subst != NULL) {
+        switch (subst->kind) {
+            case LCLEX_SUBST_CONS:
+                if (index == 0) {
+                    *penv = subst->head.subst;
+                    return subst->head.term;
+                }
+                index--;
+                break;
+
+            case LCLEX_SUBST_LIFT:
+                if (index == 0) {
+                    return NULL;
+                }
+                index--;
+                break;
+
+            case LCLEX_SUBST_SHIFT:
+                break;
+        }
+
+        subst = subst->next;
+    }
+
+    return NULL;
+}
+
+/* Computes primitive natively if the suspensions on top of the stack
+   supply all of its arguments and they fold to numerals. */
+static bool lclex_subst_primitive(lclex_subst_t *machine,
+                                  lclex_primitive_t primitive,
+                                  size_t base, uint64_t *pn) {
+    uint64_t args[LCLEX_MAX_PRIMITIVE_ARITY] = { 0 };
+    size_t arity = lclex_primitive_arity(primitive);
+
+    if (machine->size - base < arity) {
+        return false;
+    }
+
+    for (size_t i = 0; i < arity; i++) {
+        lclex_subst_term_t *arg = &machine->stack[machine->size - i - 1];
+
+        if (arg->term == NULL
+            || !lclex_fold_numeral(arg->term, arg->subst,
+                                   lclex_subst_fold_lookup, &args[i])) {
+            return false;
+        }
+    }
+
+    if (!lclex_apply_primitive(primitive, args, pn)) {
+        return false;
+    }
+
+    machine->size -= arity;
+    return true;
+}
+
+/* Reduces the head of suspension until it is an abstraction with no
+   arguments above base on the stack, or a variable or numeral that
+   cannot be applied. */
+void lclex_subst_whnf(lclex_subst_t *machine, lclex_subst_term_t *suspension,
+                      size_t base) {
+    lclex_node_t *term = suspension->term;
+    lclex_substitution_t *subst = suspension->subst;
+    lclex_substitution_t *cons;
+    lclex_subst_term_t arg;
+    uint64_t n;
+
+    while (term != NULL) {
+        switch (term->type) {
+            case LCLEX_APPLICATION:
+                /* Pushing what a variable stands for, rather than the
+                   variable, keeps chains of indirections from forming. */
+                if (term->right->type == LCLEX_BOUND_VARIABLE) {
+                    lclex_subst_lookup(machine, subst,
+                                       term->right->data.index, &arg);
+                } else {
+                    arg.term = term->right;
+                    arg.subst = subst;
+                }
+
+                lclex_push_suspension(machine, arg);
+                term = term->left;
+                machine->stats.pushes++;
+                break;
+
+            case LCLEX_ABSTRACTION:
+                if (machine->size == base) {
+                    suspension->term = term;
+                    suspension->subst = subst;
+                    return;
+                }
+
+                machine->size--;
+                cons = lclex_new_substitution(machine, LCLEX_SUBST_CONS,
+                                              subst);
+                cons->head = machine->stack[machine->size];
+                subst = cons;
+                term = term->left;
+                machine->stats.steps++;
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+                suspension->term = term;
+                suspension->subst = NULL;
+                return;
+
+            case LCLEX_BOUND_VARIABLE:
+                lclex_subst_lookup(machine, subst, term->data.index, &arg);
+                term = arg.term;
+                subst = arg.subst;
+                break;
+
+            case LCLEX_NUMERAL:
+                if (machine->size == base) {
+                    suspension->term = term;
+                    suspension->subst = NULL;
+                    return;
+                }
+
+                term = lclex_church_encode(term->data.number);
+                subst = NULL;
+                break;
+
+            /* Definitions are never written to, so they are used as is. */
+            case LCLEX_PRIMITIVE:
+                if (lclex_subst_primitive(machine, term->data.primitive,
+                                          base, &n)) {
+                    term = lclex_new_numeral(n);
+                    machine->stats.steps++;
+                } else {
+                    term = lclex_primitive_defs[term->data.primitive];
+                }
+                subst = NULL;
+                break;
+        }
+    }
+
+    /* A variable bound during read back, its index is kept in subst. */
+    suspension->term = NULL;
+    suspension->subst = subst;
+}
+
+lclex_node_t *lclex_subst_read_back(lclex_subst_t *machine,
+                                    lclex_subst_term_t suspension) {
+    lclex_node_t *root = NULL;
+    lclex_node_t **slot = &root;
+
+    /* Bodies of abstractions and last arguments are read back in place
+       through slot, so only the other arguments recurse. */
+    while (slot != NULL) {
+        size_t base = machine->size;
+        lclex_node_t *term;
+        lclex_node_t *node;
+
+        lclex_subst_whnf(machine, &suspension, base);
+        term = suspension.term;
+
+        if (term != NULL && term->type == LCLEX_ABSTRACTION) {
+            node = lclex_new_abstraction(term->data.symbol, NULL);
+            *slot = node;
+            slot = &node->left;
+
+            if (suspension.subst != NULL) {
+                suspension.subst = lclex_new_substitution(machine,
+                                                          LCLEX_SUBST_LIFT,
+                                                          suspension.subst);
+            }
+            suspension.term = term->left;
+            machine->stats.pushes++;
+            continue;
+        }
+
+        if (term == NULL) {
+            node = lclex_new_bound_variable((uintptr_t)(suspension.subst));
+        } else if (term->type == LCLEX_NUMERAL) {
+            node = lclex_new_numeral(term->data.number);
+        } else {
+            node = lclex_new_free_variable(term->data.symbol);
+        }
+
+        /* The arguments of a neutral term lie on the stack above base,
+           with the first argument on top. */
+        for (size_t i = machine->size; i > base + 1; i--) {
+            lclex_node_t *right = lclex_subst_read_back(machine,
+                                                        machine->stack[i - 1]);
+            node = lclex_new_application(node, right);
+        }
+
+        if (machine->size > base) {
+            suspension = machine->stack[base];
+            node = lclex_new_application(node, NULL);
+            *slot = node;
+            slot = &node->right;
+        } else {
+            *slot = node;
+            slot = NULL;
+        }
+        machine->size = base;
+    }
+
+    return root;
+}
+
+void lclex_subst_reduce_expression(lclex_subst_t *machine,
+                                   lclex_node_t **pexpr) {
+    lclex_node_t *expr = *pexpr;
+    lclex_subst_term_t suspension = {
+        .term = expr,
+        .subst = NULL
+    };
+
+    *pexpr = lclex_subst_read_back(machine, suspension);
+    lclex_free_node(expr);
+}
+
+void lclex_write_subst_stats(lclex_subst_t *machine, FILE *stream) {
+    fprintf(stream, "> subst: %ld steps, %ld pushes, %ld lookups, "
+            "%ld substitutions, %ld max stack\n",
+            machine->stats.steps, machine->stats.pushes,
+            machine->stats.lookups, machine->stats.substs,
+            machine->stats.max_stack);
+}
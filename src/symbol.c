@@ -0,0 +1,100 @@
+#include "symbol.h"
+#include "hashmap.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+lclex_symbol_table_t lclex_symbols = { 0 };
+
+void lclex_init_symbols(void) {
+    lclex_symbols.names = malloc(LCLEX_SYMBOLS_INIT_SIZE * sizeof(char *));
+    lclex_symbols.n_names = 0;
+    lclex_symbols.names_cap = LCLEX_SYMBOLS_INIT_SIZE;
+    lclex_symbols.slots = malloc(LCLEX_SYMBOLS_INIT_SIZE
+                                 * sizeof(lclex_symbol_t));
+    lclex_symbols.cap = LCLEX_SYMBOLS_INIT_SIZE;
+
+    memset(lclex_symbols.slots, 0xFF,
+           LCLEX_SYMBOLS_INIT_SIZE * sizeof(lclex_symbol_t));
+
+    lclex_intern("f");
+    lclex_intern("x");
+}
+
+void lclex_destruct_symbols(void) {
+    for (size_t i = 0; i < lclex_symbols.n_names; i++) {
+        free(lclex_symbols.names[i]);
+    }
+
+    free(lclex_symbols.names);
+    free(lclex_symbols.slots);
+}
+
+static void lclex_place_symbol(lclex_symbol_t *slots, size_t cap,
+                               lclex_symbol_t symbol) {
+    size_t mask = cap - 1;
+    size_t idx = lclex_hash_string(lclex_symbols.names[symbol]) & mask;
+
+    while (slots[idx] != LCLEX_NO_SYMBOL) {
+        idx = (idx + 1) & mask;
+    }
+    slots[idx] = symbol;
+}
+
+static void lclex_resize_symbols(size_t cap) {
+    lclex_symbol_t *slots = malloc(cap * sizeof(lclex_symbol_t));
+
+    memset(slots, 0xFF, cap * sizeof(lclex_symbol_t));
+
+    for (size_t i = 0; i < lclex_symbols.cap; i++) {
+        if (lclex_symbols.slots[i] != LCLEX_NO_SYMBOL) {
+            lclex_place_symbol(slots, cap, lclex_symbols.slots[i]);
+        }
+    }
+
+    free(lclex_symbols.slots);
+    lclex_symbols.slots = slots;
+    lclex_symbols.cap = cap;
+}
+
+lclex_symbol_t lclex_intern(char *name) {
+    return lclex_intern_n(name, strlen(name));
+}
+
+/* Interns the len characters at name, which need not end there. */
+lclex_symbol_t lclex_intern_n(char *name, size_t len) {
+    size_t mask = lclex_symbols.cap - 1;
+    size_t idx = lclex_hash_bytes(name, len) & mask;
+    lclex_symbol_t symbol;
+
+    while (lclex_symbols.slots[idx] != LCLEX_NO_SYMBOL) {
+        symbol = lclex_symbols.slots[idx];
+        if (strncmp(lclex_symbols.names[symbol], name, len) == 0
+            && lclex_symbols.names[symbol][len] == '\0') {
+            return symbol;
+        }
+        idx = (idx + 1) & mask;
+    }
+
+    if (lclex_symbols.n_names == lclex_symbols.names_cap) {
+        lclex_symbols.names_cap *= 2;
+        lclex_symbols.names = realloc(lclex_symbols.names,
+                                      lclex_symbols.names_cap
+                                      * sizeof(char *));
+    }
+
+    symbol = lclex_symbols.n_names;
+    lclex_symbols.names[symbol] = lclex_strndup(name, len);
+    lclex_symbols.n_names++;
+    lclex_symbols.slots[idx] = symbol;
+
+    if (lclex_symbols.n_names > LCLEX_HASHMAP_LOAD_FACTOR * lclex_symbols.cap) {
+        lclex_resize_symbols(2 * lclex_symbols.cap);
+    }
+
+    return symbol;
+}
+
+char *lclex_symbol_name(lclex_symbol_t symbol) {
+    return lclex_symbols.names[symbol];
+}
@@ -7,157 +7,833 @@
 
 lclex_node_t *NULL_NODE = NULL;
 
-lclex_node_t *lclex_new_node(lclex_type_t type, char *data,
+lclex_node_t *lclex_primitive_defs[LCLEX_N_PRIMITIVES] = { NULL };
+
+__thread lclex_tree_counters_t lclex_tree_counters = { 0 };
+
+uint32_t lclex_node_refs(lclex_node_t *node) {
+    return __atomic_load_n(&node->refs, __ATOMIC_ACQUIRE);
+}
+
+void lclex_retain_node(lclex_node_t *node) {
+    __atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+}
+
+/* Drops a reference and returns how many are left. Once a node is no 
+   longer shared, its last owner may write to it, which must not overtake
+   reads by the owners that let go of it. */
+static uint32_t lclex_release_node(lclex_node_t *node) {
+    return __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL);
+}
+
+static uint32_t lclex_scope_of_index(lclex_bruijn_index_t index) {
+    return index < LCLEX_SCOPE_UNKNOWN - 1 ? index + 1 : LCLEX_SCOPE_UNKNOWN;
+}
+
+/* The scope of a node whose free indices are raised by shift. */
+static uint32_t lclex_shift_scope(uint32_t scope, uint64_t shift) {
+    if (scope == 0 || scope == LCLEX_SCOPE_UNKNOWN) {
+        return scope;
+    }
+    return lclex_scope_of_index(scope - 1 + shift);
+}
+
+/* Sets the scope of node from its children, or from its index. */
+void lclex_update_scope(lclex_node_t *node) {
+    uint32_t scope = 0;
+
+    switch (node->type) {
+        case LCLEX_APPLICATION:
+            if (node->left == NULL || node->right == NULL) {
+                scope = LCLEX_SCOPE_UNKNOWN;
+            } else if (node->left->scope > node->right->scope) {
+                scope = node->left->scope;
+            } else {
+                scope = node->right->scope;
+            }
+            break;
+
+        case LCLEX_ABSTRACTION:
+            if (node->left == NULL) {
+                scope = LCLEX_SCOPE_UNKNOWN;
+            } else if (node->left->scope == LCLEX_SCOPE_UNKNOWN) {
+                scope = LCLEX_SCOPE_UNKNOWN;
+            } else if (node->left->scope > 0) {
+                scope = node->left->scope - 1;
+            }
+            break;
+
+        case LCLEX_BOUND_VARIABLE:
+            scope = lclex_scope_of_index(node->data.index);
+            break;
+
+        case LCLEX_FREE_VARIABLE:
+        case LCLEX_NUMERAL:
+        case LCLEX_PRIMITIVE:
+            break;
+    }
+
+    node->scope = scope;
+}
+
+lclex_node_t *lclex_new_node(lclex_type_t type, lclex_symbol_t symbol,
                              lclex_node_t *left, lclex_node_t *right) {
-    lclex_node_t *node = malloc(sizeof(lclex_node_t));
+    lclex_node_t *node = lclex_arena_alloc_node(lclex_current_arena);
 
     node->type = type;
-    node->data.str = data;
+    node->refs = 1;
+    node->data.symbol = symbol;
     node->left = left;
     node->right = right;
 
+    /* The index of a bound variable is only set by the caller. */
+    if (type == LCLEX_BOUND_VARIABLE) {
+        node->scope = LCLEX_SCOPE_UNKNOWN;
+    } else {
+        lclex_update_scope(node);
+    }
+
     return node;
 }
 
 lclex_node_t *lclex_new_application(lclex_node_t *left, lclex_node_t *right) {
-    return lclex_new_node(LCLEX_APPLICATION, NULL, left, right);
+    return lclex_new_node(LCLEX_APPLICATION, LCLEX_NO_SYMBOL, left, right);
 }
 
-lclex_node_t *lclex_new_abstraction(char *data, lclex_node_t *left) {
-    return lclex_new_node(LCLEX_ABSTRACTION, data, left, NULL);
+lclex_node_t *lclex_new_abstraction(lclex_symbol_t symbol,
+                                    lclex_node_t *left) {
+    return lclex_new_node(LCLEX_ABSTRACTION, symbol, left, NULL);
 }
 
-lclex_node_t *lclex_new_free_variable(char *data) {
-    return lclex_new_node(LCLEX_FREE_VARIABLE, data, NULL, NULL);
+lclex_node_t *lclex_new_free_variable(lclex_symbol_t symbol) {
+    return lclex_new_node(LCLEX_FREE_VARIABLE, symbol, NULL, NULL);
 }
 
 lclex_node_t *lclex_new_bound_variable(lclex_bruijn_index_t index) {
-    return lclex_new_node(LCLEX_BOUND_VARIABLE, (char *)index, NULL, NULL);
+    lclex_node_t *node = lclex_new_node(LCLEX_BOUND_VARIABLE, LCLEX_NO_SYMBOL,
+                                        NULL, NULL);
+    node->data.index = index;
+    node->scope = lclex_scope_of_index(index);
+
+    return node;
 }
 
-lclex_node_t *lclex_copy_node(lclex_node_t *node) {
-    lclex_node_t *left = NULL, *right = NULL;
-    char *str = NULL;
+lclex_node_t *lclex_new_numeral(uint64_t n) {
+    lclex_node_t *node = lclex_new_node(LCLEX_NUMERAL, LCLEX_NO_SYMBOL,
+                                        NULL, NULL);
+    node->data.number = n;
 
-    switch (node->type) {
-        case LCLEX_APPLICATION:
-            right = lclex_copy_node(node->right);
+    return node;
+}
 
-            __attribute__((fallthrough));
-        case LCLEX_ABSTRACTION:
-            left = lclex_copy_node(node->left);
-        
-            __attribute__((fallthrough));
-        case LCLEX_FREE_VARIABLE:
-            if (node->data.str != NULL) {
-                str = lclex_strdup(node->data.str);
+lclex_node_t *lclex_new_primitive(lclex_primitive_t primitive) {
+    lclex_node_t *node = lclex_new_node(LCLEX_PRIMITIVE, LCLEX_NO_SYMBOL,
+                                        NULL, NULL);
+    node->data.primitive = primitive;
+
+    return node;
+}
+
+char *lclex_primitive_name(lclex_primitive_t primitive) {
+    static char *names[] = {
+        "add",
+        "mul",
+        "exp",
+        "pred",
+        "sub"
+    };
+
+    return names[primitive];
+}
+
+size_t lclex_primitive_arity(lclex_primitive_t primitive) {
+    return primitive == LCLEX_PRIMITIVE_PRED ? 1 : 2;
+}
+
+/* Computes a primitive on native integers. Fails when the result does not
+   fit, and for exp m 0, whose normal form \x.x is not a numeral. */
+bool lclex_apply_primitive(lclex_primitive_t primitive, uint64_t *args, 
+                           uint64_t *pn) {
+    uint64_t m = args[0], n = args[1], result = 1;
+
+    switch (primitive) {
+        case LCLEX_PRIMITIVE_ADD:
+            if (m >= UINT64_MAX - n) {
+                return false;
             }
+            *pn = m + n;
+            return true;
+
+        case LCLEX_PRIMITIVE_MUL:
+            if (m != 0 && n >= UINT64_MAX / m) {
+                return false;
+            }
+            *pn = m * n;
+            return true;
+
+        case LCLEX_PRIMITIVE_EXP:
+            if (n == 0) {
+                return false;
+            }
+            if (m < 2) {
+                *pn = m;
+                return true;
+            }
+            while (n > 0) {
+                if (result >= UINT64_MAX / m) {
+                    return false;
+                }
+                result *= m;
+                n--;
+            }
+            *pn = result;
+            return true;
+
+        case LCLEX_PRIMITIVE_PRED:
+            *pn = m == 0 ? 0 : m - 1;
+            return true;
+
+        case LCLEX_PRIMITIVE_SUB:
+            *pn = m > n ? m - n : 0;
+            return true;
+
+        case LCLEX_N_PRIMITIVES:
             break;
-            
-        case LCLEX_BOUND_VARIABLE:
-            str = (char *)(node->data.index);
+    }
+
+    return false;
+}
+
+/* Whether node is a numeral, or a primitive applied to exactly as many 
+   arguments as it takes that all fold to numerals. Bound variables are 
+   resolved through lookup, or make the fold fail when it is NULL. */
+bool lclex_fold_numeral(lclex_node_t *node, void *env, 
+                        lclex_lookup_function_t lookup, uint64_t *pn) {
+    lclex_node_t *spine[LCLEX_MAX_PRIMITIVE_ARITY];
+    void *envs[LCLEX_MAX_PRIMITIVE_ARITY];
+    uint64_t args[LCLEX_MAX_PRIMITIVE_ARITY] = { 0 };
+    size_t n = 0;
+
+    while (true) {
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                if (n == LCLEX_MAX_PRIMITIVE_ARITY) {
+                    return false;
+                }
+                spine[n] = node->right;
+                envs[n] = env;
+                n++;
+                node = node->left;
+                break;
+
+            case LCLEX_BOUND_VARIABLE:
+                if (lookup == NULL) {
+                    return false;
+                }
+                node = lookup(&env, node->data.index);
+                if (node == NULL) {
+                    return false;
+                }
+                break;
+
+            case LCLEX_NUMERAL:
+                *pn = node->data.number;
+                return n == 0;
+
+            case LCLEX_PRIMITIVE:
+                if (n != lclex_primitive_arity(node->data.primitive)) {
+                    return false;
+                }
+
+                /* The spine holds the last argument first. */
+                for (size_t i = 0; i < n; i++) {
+                    if (!lclex_fold_numeral(spine[n - i - 1], envs[n - i - 1],
+                                            lookup, &args[i])) {
+                        return false;
+                    }
+                }
+                return lclex_apply_primitive(node->data.primitive, args, pn);
+
+            case LCLEX_ABSTRACTION:
+            case LCLEX_FREE_VARIABLE:
+                return false;
+        }
+    }
+}
+
+/* A fresh tree for a numeral or primitive that is about to be applied. */
+lclex_node_t *lclex_expand_node(lclex_node_t *node) {
+    if (node->type == LCLEX_NUMERAL) {
+        return lclex_church_encode(node->data.number);
+    }
+
+    return lclex_copy_node(lclex_primitive_defs[node->data.primitive]);
+}
+
+/* The traversals below keep the subterms left to visit on a pending
+   stack rather than recursing, as terms can be deeper than the call
+   stack allows. Most calls are done with the node they are given, and
+   only otherwise call a walk, kept out of line so that they do not pay
+   for its frame. */
+/* Whether a traversal of free indices from index on must enter node. 
+   Traversals that write to the nodes they enter unshare them first. */
+static inline bool lclex_reaches_index(lclex_node_t *node, 
+                                       lclex_bruijn_index_t index) {
+    return node->scope > index;
+}
+
+static inline bool lclex_is_leaf(lclex_node_t *node) {
+    return node->type != LCLEX_APPLICATION 
+           && node->type != LCLEX_ABSTRACTION;
+}
+
+/* Copies a node without children to copy, or returns NULL. Closed nodes
+   are shared rather than copied, like shared nodes. */
+static inline lclex_node_t *lclex_copy_leaf(lclex_node_t *node) {
+    lclex_node_t *copy;
+
+    if (node->scope == 0 || lclex_node_refs(node) > 1) {
+        lclex_retain_node(node);
+        return node;
+    }
+
+    if (node->type == LCLEX_APPLICATION || node->type == LCLEX_ABSTRACTION) {
+        return NULL;
+    }
+
+    copy = lclex_new_node(node->type, LCLEX_NO_SYMBOL, NULL, NULL);
+    copy->data = node->data;
+    copy->scope = node->scope;
+    lclex_tree_counters.copied++;
+
+    return copy;
+}
+
+/* A node is copied after its children, right then left, in the order it
+   was when recursing, which is the order the copy is laid out in. Until
+   its children are on copies, a node is pushed again behind a NULL. */
+static __attribute__((noinline)) 
+lclex_node_t *lclex_copy_walk(lclex_node_t *node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    void *copies_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending, copies;
+    lclex_node_t *left, *right, *copy;
+
+    lclex_init_pending(&pending, pending_data);
+    lclex_init_pending(&copies, copies_data);
+    lclex_push_pending(&pending, node);
+
+    while (pending.size > 0) {
+        node = lclex_pop_pending(&pending);
+        right = NULL;
+
+        if (node == NULL) {
+            node = lclex_pop_pending(&pending);
+            left = lclex_pop_pending(&copies);
+            if (node->type == LCLEX_APPLICATION) {
+                right = lclex_pop_pending(&copies);
+            }
+        } else if ((copy = lclex_copy_leaf(node)) != NULL) {
+            lclex_push_pending(&copies, copy);
+            continue;
+        } else {
+            if (node->type == LCLEX_APPLICATION
+                && (right = lclex_copy_leaf(node->right)) == NULL) {
+                lclex_push_pending(&pending, node);
+                lclex_push_pending(&pending, NULL);
+                lclex_push_pending(&pending, node->left);
+                lclex_push_pending(&pending, node->right);
+                continue;
+            }
+
+            if ((left = lclex_copy_leaf(node->left)) == NULL) {
+                if (right != NULL) {
+                    lclex_push_pending(&copies, right);
+                }
+                lclex_push_pending(&pending, node);
+                lclex_push_pending(&pending, NULL);
+                lclex_push_pending(&pending, node->left);
+                continue;
+            }
+        }
+
+        copy = lclex_new_node(node->type, LCLEX_NO_SYMBOL, left, right);
+        copy->data = node->data;
+        copy->scope = node->scope;
+        lclex_tree_counters.copied++;
+        lclex_push_pending(&copies, copy);
+    }
+
+    copy = lclex_pop_pending(&copies);
+    lclex_destruct_pending(&pending);
+    lclex_destruct_pending(&copies);
+
+    return copy;
+}
+
+lclex_node_t *lclex_copy_node(lclex_node_t *node) {
+    lclex_node_t *copy = lclex_copy_leaf(node);
+
+    return copy != NULL ? copy : lclex_copy_walk(node);
+}
+
+/* Replaces a shared node by a copy of it that shares its children, which
+   are unshared in turn if they are written to. Freeing rather than 
+   releasing the node frees it if the other owners let go meanwhile. */
+void lclex_unshare_node(lclex_node_t **pnode) {
+    lclex_node_t *node = *pnode;
+
+    if (node->left != NULL) {
+        lclex_retain_node(node->left);
+    }
+    if (node->right != NULL) {
+        lclex_retain_node(node->right);
+    }
+
+    *pnode = lclex_new_node(node->type, LCLEX_NO_SYMBOL, node->left, 
+                            node->right);
+    (*pnode)->data = node->data;
+    (*pnode)->scope = node->scope;
+    lclex_tree_counters.copied++;
+    lclex_free_node(node);
+}
+
+static __attribute__((noinline)) 
+bool lclex_is_closed_walk(lclex_node_t *node, lclex_bruijn_index_t index) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    bool closed = true;
+
+    lclex_init_pending(&pending, pending_data);
+    for (;;) {
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                if (lclex_reaches_index(node->left, index)) {
+                    if (lclex_reaches_index(node->right, index)) {
+                        lclex_push_pending(&pending, node->right);
+                        lclex_push_pending(&pending, (void *)(index));
+                    }
+                    node = node->left;
+                    continue;
+                }
+                if (lclex_reaches_index(node->right, index)) {
+                    node = node->right;
+                    continue;
+                }
+                break;
+
+            case LCLEX_ABSTRACTION:
+                if (lclex_reaches_index(node->left, index + 1)) {
+                    node = node->left;
+                    index++;
+                    continue;
+                }
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                break;
+
+            case LCLEX_BOUND_VARIABLE:
+                closed = node->data.index < index;
+                break;
+        }
+
+        if (!closed || pending.size == 0) {
+            break;
+        }
+        index = (lclex_bruijn_index_t)(lclex_pop_pending(&pending));
+        node = lclex_pop_pending(&pending);
+    }
+
+    lclex_destruct_pending(&pending);
+    return closed;
+}
+
+bool lclex_is_closed(lclex_node_t *node, lclex_bruijn_index_t index) {
+    return !lclex_reaches_index(node, index) 
+           || lclex_is_closed_walk(node, index);
+}
+
+/* Children are freed before their parent, right then left, in the order
+   they were when recursing, which is the order their slots are reused in.
+   A parent waits behind a NULL on the stack until its children are freed,
+   and children without children of their own are freed in place. */
+static __attribute__((noinline)) void lclex_free_walk(lclex_node_t *node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    lclex_node_t *left, *right;
+
+    lclex_init_pending(&pending, pending_data);
+    for (;;) {
+        left = NULL;
+        right = NULL;
+
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                if (lclex_release_node(node->right) == 0) {
+                    right = node->right;
+                }
+
+                __attribute__((fallthrough));
+            case LCLEX_ABSTRACTION:
+                if (lclex_release_node(node->left) == 0) {
+                    left = node->left;
+                }
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                break;
+        }
+
+        if (right != NULL && right->type != LCLEX_APPLICATION
+            && right->type != LCLEX_ABSTRACTION) {
+            lclex_arena_free_node(lclex_current_arena, right);
+            right = NULL;
+        }
+        if (right == NULL && left != NULL && left->type != LCLEX_APPLICATION
+            && left->type != LCLEX_ABSTRACTION) {
+            lclex_arena_free_node(lclex_current_arena, left);
+            left = NULL;
+        }
+
+        if (left != NULL || right != NULL) {
+            lclex_push_pending(&pending, node);
+            lclex_push_pending(&pending, NULL);
+            if (left != NULL && right != NULL) {
+                lclex_push_pending(&pending, left);
+            }
+            node = right != NULL ? right : left;
+            continue;
+        }
+
+        lclex_arena_free_node(lclex_current_arena, node);
+        node = NULL;
+        while (pending.size > 0 
+               && (node = lclex_pop_pending(&pending)) == NULL) {
+            lclex_arena_free_node(lclex_current_arena, 
+                                  lclex_pop_pending(&pending));
+        }
+        if (node == NULL) {
             break;
+        }
     }
 
-    return lclex_new_node(node->type, str, left, right);
+    lclex_destruct_pending(&pending);
 }
 
 void lclex_free_node(void *data) {
     lclex_node_t *node = data;
-    
-    switch (node->type) {
-        case LCLEX_APPLICATION:
-            lclex_free_node(node->right);
 
-            __attribute__((fallthrough));
-        case LCLEX_ABSTRACTION:
-            lclex_free_node(node->left);
+    if (lclex_release_node(node) > 0) {
+        return;
+    }
 
-            __attribute__((fallthrough));
-        case LCLEX_FREE_VARIABLE:
-            if (node->data.str != NULL) {
-                free(node->data.str);
+    if (lclex_is_leaf(node)) {
+        lclex_arena_free_node(lclex_current_arena, node);
+    } else {
+        lclex_free_walk(node);
+    }
+}
+
+/* As lclex_free_node, but children may be missing, and the left one is
+   freed first. */
+static __attribute__((noinline)) 
+void lclex_free_partial_walk(lclex_node_t *node) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    lclex_node_t *left, *right;
+
+    lclex_init_pending(&pending, pending_data);
+    for (;;) {
+        left = NULL;
+        right = NULL;
+
+        if (node->left != NULL && lclex_release_node(node->left) == 0) {
+            left = node->left;
+        }
+        if (node->right != NULL && lclex_release_node(node->right) == 0) {
+            right = node->right;
+        }
+
+        if (left != NULL && left->left == NULL && left->right == NULL) {
+            lclex_arena_free_node(lclex_current_arena, left);
+            left = NULL;
+        }
+        if (left == NULL && right != NULL 
+            && right->left == NULL && right->right == NULL) {
+            lclex_arena_free_node(lclex_current_arena, right);
+            right = NULL;
+        }
+
+        if (left != NULL || right != NULL) {
+            lclex_push_pending(&pending, node);
+            lclex_push_pending(&pending, NULL);
+            if (left != NULL && right != NULL) {
+                lclex_push_pending(&pending, right);
             }
-            break;
+            node = left != NULL ? left : right;
+            continue;
+        }
 
-        case LCLEX_BOUND_VARIABLE:
+        lclex_arena_free_node(lclex_current_arena, node);
+        node = NULL;
+        while (pending.size > 0 
+               && (node = lclex_pop_pending(&pending)) == NULL) {
+            lclex_arena_free_node(lclex_current_arena, 
+                                  lclex_pop_pending(&pending));
+        }
+        if (node == NULL) {
             break;
+        }
     }
 
-    free(node);
+    lclex_destruct_pending(&pending);
 }
 
 void lclex_free_partial_node(void *data) {
     lclex_node_t *node = data;
-    
-    if (node->left != NULL) {
-        lclex_free_partial_node(node->left);
+
+    if (lclex_release_node(node) > 0) {
+        return;
     }
 
-    if (node->right != NULL) {
-        lclex_free_partial_node(node->right);
+    if (node->left == NULL && node->right == NULL) {
+        lclex_arena_free_node(lclex_current_arena, node);
+    } else {
+        lclex_free_partial_walk(node);
+    }
+}
+
+typedef enum {
+    LCLEX_PRINT_NODE,
+    LCLEX_PRINT_SPACE,
+    LCLEX_PRINT_CLOSE,
+    LCLEX_PRINT_UNBIND
+} lclex_print_step_t;
+
+/* Where a node is written, for minimal brackets: as the function or the
+   argument of an application, and whether it is last up to the end of
+   the text or its enclosing bracket, which lets an abstraction go
+   without one. */
+#define LCLEX_PRINT_FUNCTION 1
+#define LCLEX_PRINT_ARGUMENT 2
+#define LCLEX_PRINT_LAST 4
+
+typedef struct {
+    lclex_print_step_t step;
+    uint32_t context;
+    lclex_node_t *node;
+} lclex_print_frame_t;
+
+typedef struct {
+    lclex_print_frame_t *data;
+    size_t size;
+    size_t cap;
+} lclex_print_stack_t;
+
+bool lclex_print_minimal = false;
+
+static void lclex_push_print_frame(lclex_print_stack_t *frames, 
+                                   lclex_print_step_t step, uint32_t context,
+                                   lclex_node_t *node) {
+    if (frames->size == frames->cap) {
+        frames->cap *= 2;
+        frames->data = realloc(frames->data, 
+                               frames->cap * sizeof(lclex_print_frame_t));
     }
 
-    if (node->data.str != NULL && node->type != LCLEX_BOUND_VARIABLE) {
-        free(node->data.str);
+    frames->data[frames->size].step = step;
+    frames->data[frames->size].context = context;
+    frames->data[frames->size].node = node;
+    frames->size++;
+}
+
+/* Most of the output is single characters, which mostly fit. */
+static void lclex_print_char(lclex_string_buf_t *buf, char c) {
+    if (buf->len + 1 < buf->cap) {
+        buf->str[buf->len++] = c;
+        buf->str[buf->len] = '\0';
+    } else {
+        lclex_append_string_buf(buf, &c, 1);
     }
+}
 
-    free(node);
+static void lclex_format_numeral(uint64_t number, bool minimal, 
+                                 bool wrapped, lclex_string_buf_t *buf) {
+    if (!minimal) {
+        lclex_append_string_buf(buf, "(\\f.(\\x.", 8);
+        for (uint64_t n = 0; n < number; n++) {
+            lclex_append_string_buf(buf, "(f ", 3);
+        }
+        lclex_print_char(buf, 'x');
+        for (uint64_t n = 0; n < number; n++) {
+            lclex_print_char(buf, ')');
+        }
+        lclex_append_string_buf(buf, "))", 2);
+        return;
+    }
+
+    if (wrapped) {
+        lclex_print_char(buf, '(');
+    }
+    lclex_append_string_buf(buf, "\\f.\\x.", 6);
+    if (number > 0) {
+        lclex_append_string_buf(buf, "f ", 2);
+    }
+    for (uint64_t n = 1; n < number; n++) {
+        lclex_append_string_buf(buf, "(f ", 3);
+    }
+    lclex_print_char(buf, 'x');
+    for (uint64_t n = 1; n < number; n++) {
+        lclex_print_char(buf, ')');
+    }
+    if (wrapped) {
+        lclex_print_char(buf, ')');
+    }
 }
 
-void lclex_write_node_wrapped(lclex_node_t *node, FILE *stream, 
-                              lclex_stack_t *stack) {
+/* Appends node to buf, with every application and abstraction bracketed
+   unless lclex_print_minimal is set, in which case only the brackets
+   needed to read it back are. The nodes still to write are kept on an
+   explicit stack, so the depth of node is only bounded by memory. */
+void lclex_format_node(lclex_node_t *node, lclex_string_buf_t *buf) {
+    bool minimal = lclex_print_minimal;
+    bool wrapped, last;
+    char index[32];
+    char *name;
     size_t i;
-    char *str;
 
-    switch (node->type) {
-        case LCLEX_APPLICATION:
-            fprintf(stream, "(");
-            lclex_write_node_wrapped(node->left, stream, stack);
-            fprintf(stream, " ");
-            lclex_write_node_wrapped(node->right, stream, stack);
-            fprintf(stream, ")");
-            break;
+    lclex_stack_t binders;
+    lclex_init_stack(&binders);
 
-        case LCLEX_ABSTRACTION:
-            lclex_push_stack(stack, node->data.str);
+    lclex_print_stack_t frames = {
+        .data = malloc(LCLEX_STACK_INIT_SIZE * sizeof(lclex_print_frame_t)),
+        .size = 0,
+        .cap = LCLEX_STACK_INIT_SIZE
+    };
 
-            fprintf(stream, "(\\");
-            if (node->data.str != NULL) {
-                fputs(node->data.str, stream);
-            }
-            fprintf(stream, ".");
-            lclex_write_node_wrapped(node->left, stream, stack);
-            fprintf(stream, ")");
+    lclex_push_print_frame(&frames, LCLEX_PRINT_NODE, LCLEX_PRINT_LAST, 
+                           node);
 
-            lclex_pop_stack(stack);
-            break;
+    while (frames.size > 0) {
+        lclex_print_frame_t frame = frames.data[--frames.size];
 
-        case LCLEX_FREE_VARIABLE:
-            fputs(node->data.str, stream);
-            break;
+        switch (frame.step) {
+            case LCLEX_PRINT_SPACE:
+                lclex_print_char(buf, ' ');
+                continue;
 
-        case LCLEX_BOUND_VARIABLE:
-            i = stack->size - node->data.index - 1;
-            str = stack->data[i];
+            case LCLEX_PRINT_CLOSE:
+                lclex_print_char(buf, ')');
+                continue;
 
-            if (str == NULL) {
-                fprintf(stream, "<%ld>", node->data.index);
-            } else {
-                fputs(str, stream);
-            }
-            break;
+            case LCLEX_PRINT_UNBIND:
+                lclex_pop_stack(&binders);
+                continue;
+
+            case LCLEX_PRINT_NODE:
+                break;
+        }
+
+        node = frame.node;
+
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                wrapped = !minimal || (frame.context & LCLEX_PRINT_ARGUMENT);
+                last = wrapped || (frame.context & LCLEX_PRINT_LAST);
+
+                if (wrapped) {
+                    lclex_print_char(buf, '(');
+                    lclex_push_print_frame(&frames, LCLEX_PRINT_CLOSE, 0, 
+                                           NULL);
+                }
+                lclex_push_print_frame(&frames, LCLEX_PRINT_NODE, 
+                                       LCLEX_PRINT_ARGUMENT 
+                                       | (last ? LCLEX_PRINT_LAST : 0),
+                                       node->right);
+                lclex_push_print_frame(&frames, LCLEX_PRINT_SPACE, 0, NULL);
+                lclex_push_print_frame(&frames, LCLEX_PRINT_NODE, 
+                                       LCLEX_PRINT_FUNCTION, node->left);
+                break;
+
+            case LCLEX_ABSTRACTION:
+                wrapped = !minimal || !(frame.context & LCLEX_PRINT_LAST);
+
+                lclex_push_stack(&binders, 
+                                 (void *)(uintptr_t)node->data.symbol);
+
+                if (wrapped) {
+                    lclex_append_string_buf(buf, "(\\", 2);
+                } else {
+                    lclex_print_char(buf, '\\');
+                }
+                if (node->data.symbol != LCLEX_NO_SYMBOL) {
+                    name = lclex_symbol_name(node->data.symbol);
+                    lclex_append_string_buf(buf, name, strlen(name));
+                }
+                lclex_print_char(buf, '.');
+
+                if (wrapped) {
+                    lclex_push_print_frame(&frames, LCLEX_PRINT_CLOSE, 0, 
+                                           NULL);
+                }
+                lclex_push_print_frame(&frames, LCLEX_PRINT_UNBIND, 0, NULL);
+                lclex_push_print_frame(&frames, LCLEX_PRINT_NODE, 
+                                       LCLEX_PRINT_LAST, node->left);
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+                name = lclex_symbol_name(node->data.symbol);
+                lclex_append_string_buf(buf, name, strlen(name));
+                break;
+
+            case LCLEX_BOUND_VARIABLE:
+                i = binders.size - node->data.index - 1;
+
+                if ((uintptr_t)binders.data[i] == LCLEX_NO_SYMBOL) {
+                    snprintf(index, sizeof(index), "<%ld>", node->data.index);
+                    lclex_append_string_buf(buf, index, strlen(index));
+                } else {
+                    name = lclex_symbol_name((uintptr_t)binders.data[i]);
+                    lclex_append_string_buf(buf, name, strlen(name));
+                }
+                break;
+
+            /* Written as what they stand for, so output does not depend on
+               whether a term was expanded. */
+            case LCLEX_NUMERAL:
+                lclex_format_numeral(node->data.number, minimal, 
+                                     !(frame.context & LCLEX_PRINT_LAST),
+                                     buf);
+                break;
+
+            case LCLEX_PRIMITIVE:
+                lclex_push_print_frame(&frames, LCLEX_PRINT_NODE, 
+                    frame.context, 
+                    lclex_primitive_defs[node->data.primitive]);
+                break;
+        }
     }
+
+    free(frames.data);
+    lclex_destruct_stack(&binders);
 }
 
+/* Formats node and writes it with its newline at once. */
 void lclex_write_node(lclex_node_t *node, FILE *stream) {
-    lclex_stack_t stack;
-    lclex_init_stack(&stack);
+    lclex_string_buf_t buf;
+    lclex_init_string_buf(&buf);
 
-    lclex_write_node_wrapped(node, stream, &stack);
-    printf("\n");
+    lclex_format_node(node, &buf);
+    lclex_append_string_buf(&buf, "\n", 1);
+    fwrite(buf.str, 1, buf.len, stream);
 
-    lclex_destruct_stack(&stack);
+    lclex_destruct_string_buf(&buf);
 }
 
 lclex_node_t *lclex_church_encode(uint64_t n) {
@@ -168,14 +844,18 @@ lclex_node_t *lclex_church_encode(uint64_t n) {
         node = lclex_new_application(f, node);
     }
 
-    lclex_node_t *abstr_x = lclex_new_abstraction(lclex_strdup("x"), node);
-    lclex_node_t *abstr_f = lclex_new_abstraction(lclex_strdup("f"), abstr_x);
+    lclex_node_t *abstr_x = lclex_new_abstraction(LCLEX_SYMBOL_X, node);
+    lclex_node_t *abstr_f = lclex_new_abstraction(LCLEX_SYMBOL_F, abstr_x);
     
     return abstr_f;
 }
 
 uint64_t lclex_church_decode(lclex_node_t *node) {
     lclex_node_t *temp = node;
+    if (temp->type == LCLEX_NUMERAL) {
+        return temp->data.number;
+    }
+
     if (temp->type != LCLEX_ABSTRACTION) {
         return UINT64_MAX;
     }
@@ -209,145 +889,614 @@ uint64_t lclex_church_decode(lclex_node_t *node) {
 }
 
 void lclex_remove_bound_names(lclex_node_t *node) {
-    switch (node->type) {
-        case LCLEX_APPLICATION:
-            lclex_remove_bound_names(node->right);
-
-            __attribute__((fallthrough));
-        case LCLEX_ABSTRACTION:
-            lclex_remove_bound_names(node->left);
-            
-            if (node->data.str != NULL) {
-                free(node->data.str);
-                node->data.str = NULL;
-            }
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+
+    lclex_init_pending(&pending, pending_data);
+    for (;;) {
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                lclex_push_pending(&pending, node->right);
+
+                __attribute__((fallthrough));
+            case LCLEX_ABSTRACTION:
+                node->data.symbol = LCLEX_NO_SYMBOL;
+                node = node->left;
+                continue;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                break;
+        }
 
+        if (pending.size == 0) {
             break;
+        }
+        node = lclex_pop_pending(&pending);
+    }
 
-        case LCLEX_FREE_VARIABLE:
-        case LCLEX_BOUND_VARIABLE:
+    lclex_destruct_pending(&pending);
+}
+
+lclex_node_t **lclex_find_redex(lclex_node_t **pnode, 
+                                lclex_node_t ***pshared) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    lclex_node_t **redex = &NULL_NODE;
+    lclex_node_t *node;
+    size_t shared_size = SIZE_MAX;
+
+    lclex_init_pending(&pending, pending_data);
+    for (;;) {
+        node = *pnode;
+
+        /* Records the outermost shared node on the path to the redex, which
+           must be copied before the redex can be contracted in place. It
+           is dropped once the search leaves it, when the stack shrinks
+           below the size it had on entering. */
+        if (lclex_node_refs(node) > 1 && *pshared == NULL) {
+            *pshared = pnode;
+            shared_size = pending.size;
+        }
+
+        lclex_tree_counters.visited++;
+
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                if (node->left->type == LCLEX_ABSTRACTION
+                    || node->left->type == LCLEX_NUMERAL
+                    || node->left->type == LCLEX_PRIMITIVE) {
+                    redex = pnode;
+                    break;
+                }
+
+                lclex_push_pending(&pending, &node->right);
+                pnode = &node->left;
+                continue;
+
+            case LCLEX_ABSTRACTION:
+                pnode = &node->left;
+                continue;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                break;
+        }
+
+        if (redex != &NULL_NODE || pending.size == 0) {
             break;
+        }
+        pnode = lclex_pop_pending(&pending);
+
+        if (pending.size < shared_size && shared_size != SIZE_MAX) {
+            *pshared = NULL;
+            shared_size = SIZE_MAX;
+        }
     }
+
+    if (redex == &NULL_NODE && shared_size != SIZE_MAX) {
+        *pshared = NULL;
+    }
+
+    lclex_destruct_pending(&pending);
+    return redex;
 }
 
-lclex_node_t **lclex_find_redex(lclex_node_t **pnode) {
-    lclex_node_t **redex;
-    lclex_node_t *node = *pnode;
+/* Lowers the scope of a node entered by lclex_find_bound_and_shift, and
+   collects or lowers it if it is a bound variable. Scopes are lowered on
+   the way down, and raised to that of new shifted by the depth of an
+   occurrence, which keeps them an upper bound without having to revisit
+   the node afterwards. */
+static inline void lclex_find_bound_in_node(lclex_node_t **pnode, 
+                                            lclex_node_t *new,
+                                            lclex_bruijn_index_t index, 
+                                            lclex_stack_t *stack) {
+    lclex_node_t *node;
+    uint32_t scope;
+
+    if (lclex_node_refs(*pnode) > 1) {
+        lclex_unshare_node(pnode);
+    }
+    node = *pnode;
 
-    switch (node->type) {
-        case LCLEX_APPLICATION:
-            if (node->left->type == LCLEX_ABSTRACTION) {
-                return pnode;
-            }
+    lclex_tree_counters.substituted++;
 
-            redex = lclex_find_redex(&node->left);
-            if (*redex != NULL_NODE) {
-                return redex;
-            }
-            return lclex_find_redex(&node->right);
+    scope = lclex_shift_scope(new->scope, index);
+    if (node->scope != LCLEX_SCOPE_UNKNOWN && node->scope - 1 > scope) {
+        scope = node->scope - 1;
+    }
+    node->scope = scope;
 
-        case LCLEX_ABSTRACTION:
-            return lclex_find_redex(&node->left);
-        
-        case LCLEX_FREE_VARIABLE:
-        case LCLEX_BOUND_VARIABLE:
-            return &NULL_NODE;
+    if (node->type != LCLEX_BOUND_VARIABLE) {
+        return;
+    }
+
+    if (node->data.index == index) {
+        lclex_push_stack(stack, pnode);
+        lclex_push_stack(stack, (void *)(index));
+    } else if (node->data.index > index) {
+        node->data.index--;
+        node->scope = lclex_scope_of_index(node->data.index);
+    }
+}
+
+/* Collects the occurrences of index, to be replaced by new, and lowers
+   the indices above it. Nodes are only entered once they are known to 
+   reach index, and a variable applied to something is visited in place, 
+   as it is wherever there is an application of a variable. */
+static __attribute__((noinline)) 
+void lclex_find_bound_walk(lclex_node_t **pnode, lclex_node_t *new, 
+                           lclex_bruijn_index_t index, lclex_stack_t *stack) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    lclex_node_t *node = *pnode;
+
+    lclex_init_pending(&pending, pending_data);
+    for (;;) {
+        lclex_find_bound_in_node(pnode, new, index, stack);
+        node = *pnode;
+
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                if (lclex_reaches_index(node->left, index)) {
+                    if (lclex_is_leaf(node->left)) {
+                        lclex_find_bound_in_node(&node->left, new, index, 
+                                                 stack);
+                    } else {
+                        if (lclex_reaches_index(node->right, index)) {
+                            lclex_push_pending(&pending, &node->right);
+                            lclex_push_pending(&pending, (void *)(index));
+                        }
+                        pnode = &node->left;
+                        node = *pnode;
+                        continue;
+                    }
+                }
+                if (lclex_reaches_index(node->right, index)) {
+                    pnode = &node->right;
+                    node = *pnode;
+                    continue;
+                }
+                break;
+
+            case LCLEX_ABSTRACTION:
+                if (lclex_reaches_index(node->left, index + 1)) {
+                    pnode = &node->left;
+                    node = *pnode;
+                    index++;
+                    continue;
+                }
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                break;
+        }
+
+        if (pending.size == 0) {
+            break;
+        }
+        index = (lclex_bruijn_index_t)(lclex_pop_pending(&pending));
+        pnode = lclex_pop_pending(&pending);
+        node = *pnode;
     }
 
-    return &NULL_NODE;
+    lclex_destruct_pending(&pending);
 }
 
 void lclex_find_bound_and_shift(lclex_node_t **pnode, lclex_node_t *new, 
                                 lclex_bruijn_index_t index, 
                                 lclex_stack_t *stack) {
-    lclex_node_t *node = *pnode;
+    if (!lclex_reaches_index(*pnode, index)) {
+        return;
+    }
 
-    switch (node->type) {
-        case LCLEX_APPLICATION:
-            lclex_find_bound_and_shift(&node->left, new, index, stack);
-            lclex_find_bound_and_shift(&node->right, new, index, stack);
-            break;
+    if (lclex_is_leaf(*pnode)) {
+        lclex_find_bound_in_node(pnode, new, index, stack);
+    } else {
+        lclex_find_bound_walk(pnode, new, index, stack);
+    }
+}
 
-        case LCLEX_ABSTRACTION:
-            lclex_find_bound_and_shift(&node->left, new, index + 1, stack);
-            break;
-        
-        case LCLEX_FREE_VARIABLE:
-            break;
-        
-        case LCLEX_BOUND_VARIABLE:
-            if (node->data.index == index) {
-                lclex_push_stack(stack, pnode);
-                lclex_push_stack(stack, (void *)(index));
-            } else if (node->data.index > index) {
-                node->data.index--;
-            }
-            break;
+static inline void lclex_shift_node(lclex_node_t **pnode, uint64_t shift, 
+                                    lclex_bruijn_index_t index) {
+    lclex_node_t *node;
+
+    if (lclex_node_refs(*pnode) > 1) {
+        lclex_unshare_node(pnode);
+    }
+    node = *pnode;
+
+    lclex_tree_counters.shifted++;
+    node->scope = lclex_shift_scope(node->scope, shift);
+
+    if (node->type == LCLEX_BOUND_VARIABLE && node->data.index >= index) {
+        node->data.index += shift;
     }
 }
 
-void lclex_shift(lclex_node_t *node, uint64_t shift, 
-                 lclex_bruijn_index_t index) {
-    switch (node->type) {
-        case LCLEX_APPLICATION:
-            lclex_shift(node->left, shift, index);
-            lclex_shift(node->right, shift, index);
-            break;        
+/* Walks the nodes as lclex_find_bound_and_shift does. */
+static __attribute__((noinline)) 
+void lclex_shift_walk(lclex_node_t **pnode, uint64_t shift, 
+                      lclex_bruijn_index_t index) {
+    void *pending_data[LCLEX_STACK_INIT_SIZE];
+    lclex_stack_t pending;
+    lclex_node_t *node;
+
+    lclex_init_pending(&pending, pending_data);
+    for (;;) {
+        lclex_shift_node(pnode, shift, index);
+        node = *pnode;
+
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                if (lclex_reaches_index(node->left, index)) {
+                    if (lclex_is_leaf(node->left)) {
+                        lclex_shift_node(&node->left, shift, index);
+                    } else {
+                        if (lclex_reaches_index(node->right, index)) {
+                            lclex_push_pending(&pending, &node->right);
+                            lclex_push_pending(&pending, (void *)(index));
+                        }
+                        pnode = &node->left;
+                        continue;
+                    }
+                }
+                if (lclex_reaches_index(node->right, index)) {
+                    pnode = &node->right;
+                    continue;
+                }
+                break;
+
+            case LCLEX_ABSTRACTION:
+                if (lclex_reaches_index(node->left, index + 1)) {
+                    pnode = &node->left;
+                    index++;
+                    continue;
+                }
+                break;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                break;
+        }
 
-        case LCLEX_ABSTRACTION:
-            lclex_shift(node->left, shift, index + 1);
+        if (pending.size == 0) {
             break;
+        }
+        index = (lclex_bruijn_index_t)(lclex_pop_pending(&pending));
+        pnode = lclex_pop_pending(&pending);
+    }
 
-        case LCLEX_FREE_VARIABLE:
-            break;
+    lclex_destruct_pending(&pending);
+}
 
-        case LCLEX_BOUND_VARIABLE:
-            if (node->data.index >= index) {
-                node->data.index += shift;
-            }
-            break;
+void lclex_shift(lclex_node_t **pnode, uint64_t shift, 
+                 lclex_bruijn_index_t index) {
+    if (!lclex_reaches_index(*pnode, index)) {
+        return;
+    }
+
+    if (lclex_is_leaf(*pnode)) {
+        lclex_shift_node(pnode, shift, index);
+    } else {
+        lclex_shift_walk(pnode, shift, index);
     }
 }
 
 void lclex_reduce_redex(lclex_node_t **redex, lclex_stack_t *stack) {
     lclex_node_t *node = *redex;
     lclex_node_t *abstr = node->left;
+    lclex_node_t *arg = node->right;
+    lclex_node_t *body, *version = NULL;
+    lclex_bruijn_index_t version_index = 0;
+    uint64_t n;
+
+    if (lclex_fold_numeral(node, NULL, NULL, &n)) {
+        lclex_free_node(node);
+        *redex = lclex_new_numeral(n);
+        return;
+    }
+
+    /* A numeral or primitive applied to something it cannot be computed
+       with is replaced by what it stands for, which is then applied. */
+    if (abstr->type != LCLEX_ABSTRACTION) {
+        node->left = lclex_expand_node(abstr);
+        lclex_free_node(abstr);
+        abstr = node->left;
+    }
+
+    body = abstr->left;
+    if (lclex_node_refs(abstr) > 1) {
+        lclex_retain_node(body);
+    } else {
+        abstr->left = NULL;
+    }
+    node->right = NULL;
+    lclex_free_partial_node(node);
 
     lclex_clear_stack(stack);
-    lclex_find_bound_and_shift(&abstr->left, node->right, 0, stack);
+    lclex_find_bound_and_shift(&body, arg, 0, stack);
+
+    /* Occurrences at the same depth share one version of the argument,
+       shifted by that depth. Shifting unshares only the nodes on the way
+       to its free indices, so the rest of the argument, and all of it if
+       it is closed, is shared between every occurrence. The version for
+       the occurrences from last on takes over the argument, and is 
+       shifted in place where it can be. */
+    size_t last = stack->size < 2 ? 0 : stack->size - 2;
+    while (last >= 2 && stack->data[last + 1] == stack->data[last - 1]) {
+        last -= 2;
+    }
 
     for (size_t i = 0; i < stack->size; i += 2) {
         lclex_node_t **ptarget = stack->data[i];
         lclex_bruijn_index_t index = (lclex_bruijn_index_t)(stack->data[i + 1]);
         lclex_free_node(*ptarget);
 
-        if (i == stack->size - 2) {
-            *ptarget = node->right;
-            node->right = NULL;
-        } else {
-            *ptarget = lclex_copy_node(node->right);
+        if (version == NULL || index != version_index) {
+            if (version != NULL) {
+                lclex_free_node(version);
+            }
+            version = arg;
+            version_index = index;
+            if (i == last) {
+                arg = NULL;
+            } else {
+                lclex_retain_node(arg);
+            }
+            if (index != 0) {
+                lclex_shift(&version, index, 0);
+            }
         }
 
-        if (index != 0) {
-            lclex_shift(*ptarget, index, 0);
+        *ptarget = version;
+        lclex_retain_node(version);
+    }
+
+    if (version != NULL) {
+        lclex_free_node(version);
+    }
+    if (arg != NULL) {
+        lclex_free_node(arg);
+    }
+    *redex = body;
+}
+
+void lclex_init_cursor(lclex_cursor_t *cursor, lclex_node_t **pexpr) {
+    lclex_init_stack(&cursor->path);
+    lclex_init_stack(&cursor->shared);
+    cursor->spawn = NULL;
+    cursor->spawn_data = NULL;
+
+    lclex_push_cursor(cursor, pexpr);
+}
+
+void lclex_destruct_cursor(lclex_cursor_t *cursor) {
+    lclex_destruct_stack(&cursor->path);
+    lclex_destruct_stack(&cursor->shared);
+}
+
+void lclex_push_cursor(lclex_cursor_t *cursor, lclex_node_t **pnode) {
+    lclex_tree_counters.visited++;
+
+    if (lclex_node_refs(*pnode) > 1) {
+        lclex_push_stack(&cursor->shared, (void *)(cursor->path.size));
+    }
+    lclex_push_stack(&cursor->path, pnode);
+}
+
+lclex_node_t **lclex_pop_cursor(lclex_cursor_t *cursor) {
+    lclex_node_t **pnode = lclex_pop_stack(&cursor->path);
+
+    if (cursor->shared.size > 0 
+        && (size_t)(cursor->shared.data[cursor->shared.size - 1]) 
+           == cursor->path.size) {
+        lclex_pop_stack(&cursor->shared);
+    }
+
+    return pnode;
+}
+
+/* The cursor is at the innermost application of a primitive. If the 
+   applications above it supply the remaining arguments and everything 
+   folds to a numeral, the outermost one is the redex and is computed. 
+   Otherwise the primitive is expanded where it is, which is what normal
+   order would contract first. */
+static lclex_node_t **lclex_cursor_primitive(lclex_cursor_t *cursor) {
+    lclex_stack_t *path = &cursor->path;
+    lclex_node_t **pnode = path->data[path->size - 1];
+    size_t arity = lclex_primitive_arity((*pnode)->left->data.primitive);
+    size_t i = path->size - 1;
+    uint64_t n;
+
+    for (size_t k = 1; k < arity; k++) {
+        if (i == 0) {
+            return pnode;
+        }
+
+        lclex_node_t *parent = *(lclex_node_t **)(path->data[i - 1]);
+        if (parent->type != LCLEX_APPLICATION 
+            || path->data[i] != &parent->left) {
+            return pnode;
         }
+        i--;
     }
-    *redex = abstr->left;
 
-    abstr->left = NULL;
-    lclex_free_partial_node(node);
+    if (!lclex_fold_numeral(*(lclex_node_t **)(path->data[i]), 
+                            NULL, NULL, &n)) {
+        return pnode;
+    }
+
+    while (path->size > i + 1) {
+        lclex_pop_cursor(cursor);
+    }
+
+    return path->data[i];
 }
 
-void lclex_reduce_expression(lclex_node_t **pexpr, uint64_t max, 
-                             bool show_reductions) {
+/* Hands the right child of the application on top of the path to spawn.
+   Inside a shared node, the path is copied first so that the slot is 
+   owned, unless there is nothing to reduce in the child. */
+static void lclex_cursor_spawn(lclex_cursor_t *cursor) {
+    lclex_stack_t *path = &cursor->path;
+    lclex_node_t *parent = *(lclex_node_t **)(path->data[path->size - 1]);
+    lclex_node_t **shared = NULL;
+
+    if (parent->right->type != LCLEX_APPLICATION
+        && parent->right->type != LCLEX_ABSTRACTION) {
+        return;
+    }
+
+    if (cursor->shared.size > 0) {
+        if (*lclex_find_redex(&parent->right, &shared) == NULL_NODE) {
+            return;
+        }
+
+        lclex_unshare_cursor(cursor);
+        parent = *(lclex_node_t **)(path->data[path->size - 1]);
+    }
+
+    cursor->spawn(cursor->spawn_data, &parent->right);
+}
+
+lclex_node_t **lclex_cursor_next_redex(lclex_cursor_t *cursor) {
+    lclex_stack_t *path = &cursor->path;
+
+    while (path->size > 0) {
+        lclex_node_t **pnode = path->data[path->size - 1];
+        lclex_node_t *node = *pnode;
+
+        switch (node->type) {
+            case LCLEX_APPLICATION:
+                if (node->left->type == LCLEX_ABSTRACTION
+                    || node->left->type == LCLEX_NUMERAL) {
+                    return pnode;
+                }
+
+                if (node->left->type == LCLEX_PRIMITIVE) {
+                    return lclex_cursor_primitive(cursor);
+                }
+
+                lclex_push_cursor(cursor, &node->left);
+                continue;
+
+            case LCLEX_ABSTRACTION:
+                lclex_push_cursor(cursor, &node->left);
+                continue;
+
+            case LCLEX_FREE_VARIABLE:
+            case LCLEX_BOUND_VARIABLE:
+            case LCLEX_NUMERAL:
+            case LCLEX_PRIMITIVE:
+                break;
+        }
+
+        /* Everything up to here is in normal form: move on to the right 
+           child of the nearest application entered through its left. */
+        bool resumed = false;
+
+        while (!resumed && path->size > 1) {
+            lclex_node_t **pchild = lclex_pop_cursor(cursor);
+            lclex_node_t *parent = *(lclex_node_t **)
+                                   (path->data[path->size - 1]);
+
+            if (parent->type == LCLEX_APPLICATION 
+                && pchild == &parent->left) {
+                if (cursor->spawn != NULL) {
+                    lclex_cursor_spawn(cursor);
+                } else {
+                    lclex_push_cursor(cursor, &parent->right);
+                    resumed = true;
+                }
+            }
+        }
+
+        if (!resumed) {
+            lclex_pop_cursor(cursor);
+        }
+    }
+
+    return NULL;
+}
+
+void lclex_unshare_cursor(lclex_cursor_t *cursor) {
+    lclex_stack_t *path = &cursor->path;
+    lclex_node_t *old_parent = NULL, *new_parent = NULL;
+
+    if (cursor->shared.size == 0) {
+        return;
+    }
+
+    /* Copying the outermost shared node copies everything below it on the
+       path, so the remaining slots are moved over to the copies. */
+    for (size_t i = (size_t)(cursor->shared.data[0]); i < path->size; i++) {
+        lclex_node_t **pnode = path->data[i];
+        lclex_node_t *old = *pnode;
+
+        if (old_parent != NULL) {
+            pnode = pnode == &old_parent->left 
+                    ? &new_parent->left : &new_parent->right;
+            path->data[i] = pnode;
+        }
+
+        if (lclex_node_refs(*pnode) > 1) {
+            lclex_unshare_node(pnode);
+        }
+
+        old_parent = old;
+        new_parent = *pnode;
+    }
+
+    lclex_clear_stack(&cursor->shared);
+}
+
+void lclex_cursor_contracted(lclex_cursor_t *cursor) {
+    lclex_stack_t *path = &cursor->path;
+    lclex_node_t **pnode = lclex_pop_cursor(cursor);
+
+    /* Only the parent of the contracted redex can have become a redex, 
+       everything else before it in normal order is unchanged. */
+    if (path->size > 0) {
+        lclex_node_t *parent = *(lclex_node_t **)(path->data[path->size - 1]);
+
+        if (parent->type == LCLEX_APPLICATION && pnode == &parent->left
+            && (parent->left->type == LCLEX_ABSTRACTION
+                || parent->left->type == LCLEX_NUMERAL
+                || parent->left->type == LCLEX_PRIMITIVE)) {
+            return;
+        }
+    }
+
+    lclex_push_cursor(cursor, pnode);
+}
+
+uint64_t lclex_reduce_expression(lclex_node_t **pexpr, uint64_t max, 
+                                 bool show_reductions) {
     lclex_node_t **redex;
     uint64_t count = 0;
 
     lclex_stack_t stack;
     lclex_init_stack(&stack);
 
-    while (count < max && *(redex = lclex_find_redex(pexpr)) != NULL_NODE) {
+    lclex_cursor_t cursor;
+    lclex_init_cursor(&cursor, pexpr);
+
+    while (count < max 
+           && (redex = lclex_cursor_next_redex(&cursor)) != NULL) {
+        lclex_unshare_cursor(&cursor);
+        redex = cursor.path.data[cursor.path.size - 1];
+
         lclex_reduce_redex(redex, &stack);
+        lclex_cursor_contracted(&cursor);
         count++;
 
         if (show_reductions) {
@@ -356,5 +1505,8 @@ void lclex_reduce_expression(lclex_node_t **pexpr, uint64_t max,
         }
     }
 
+    lclex_destruct_cursor(&cursor);
     lclex_destruct_stack(&stack);
+
+    return count;
 }
@@ -17,6 +17,22 @@ void lclex_clear_string_buf(lclex_string_buf_t *buf) {
     buf->len = 0;
 }
 
+/* Appends the len characters at str, keeping the buffer terminated. */
+void lclex_append_string_buf(lclex_string_buf_t *buf, char *str, size_t len) {
+    if (buf->len + len + 1 > buf->cap) {
+        while (buf->len + len + 1 > buf->cap) {
+            buf->cap *= 2;
+        }
+        buf->str = realloc(buf->str, buf->cap);
+    }
+
+    memcpy(buf->str + buf->len, str, len);
+    buf->len += len;
+    buf->str[buf->len] = '\0';
+}
+
+/* Only the part read by the last fgets is searched, so long lines are
+   read in linear time. */
 void lclex_readline(lclex_string_buf_t *buf, FILE *stream) {
     char *newline = NULL;
     
@@ -24,15 +40,19 @@ void lclex_readline(lclex_string_buf_t *buf, FILE *stream) {
 
     while (newline == NULL &&
            fgets(buf->str + buf->len, buf->cap - buf->len, stream) != NULL) {
-        newline = strchr(buf->str, '\n');
+        char *chunk = buf->str + buf->len;
+        size_t len = strlen(chunk);
+
+        newline = memchr(chunk, '\n', len);
 
         if (newline == NULL) {
+            buf->len += len;
             buf->str = realloc(buf->str, 2 * buf->cap);
             buf->cap *= 2;
         } else {
             *newline = '\0';
+            buf->len = newline - buf->str;
         }
-        buf->len = strlen(buf->str);
     }
 }
 
@@ -44,6 +64,14 @@ char *lclex_strdup(char *str) {
     return dup;
 }
 
+char *lclex_strndup(char *str, size_t len) {
+    char *dup = malloc(len + 1);
+    memcpy(dup, str, len);
+    dup[len] = '\0';
+
+    return dup;
+}
+
 void lclex_init_stack(lclex_stack_t *stack) {
     stack->data = malloc(LCLEX_STACK_INIT_SIZE * sizeof(void *));
     stack->size = 0;
@@ -74,3 +102,15 @@ void *lclex_pop_stack(lclex_stack_t *stack) {
     stack->size--;
     return stack->data[stack->size];
 }
+
+void **lclex_grow_pending(void **data, size_t cap) {
+    void **heap;
+
+    if (cap != LCLEX_STACK_INIT_SIZE) {
+        return realloc(data, 2 * cap * sizeof(void *));
+    }
+
+    heap = malloc(2 * cap * sizeof(void *));
+    memcpy(heap, data, cap * sizeof(void *));
+    return heap;
+}